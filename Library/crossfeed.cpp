@@ -0,0 +1,166 @@
+/*
+  ==============================================================================
+
+    libcrossfeed: the C API over CrossfeedEngine.
+
+  ==============================================================================
+*/
+
+#include "crossfeed.h"
+#include "CrossfeedEngine.h"
+#include <new>
+
+//==============================================================================
+struct crossfeed
+{
+    CrossfeedEngine<float> engine;
+    CrossfeedParameterSnapshot parameters;
+    double sampleRate = 0.0;
+    bool parametersChanged = true;
+};
+
+namespace
+{
+    bool isInRange (float value, float start, float end) noexcept
+    {
+        // Also false for NaN.
+        return value >= start && value <= end;
+    }
+
+    /** Hands the latest parameters to the engine, once per block like the plugin does. */
+    void applyParameters (crossfeed& cf) noexcept
+    {
+        if (cf.parametersChanged)
+        {
+            cf.engine.setParameters (cf.parameters);
+            cf.parametersChanged = false;
+        }
+    }
+
+    /** sampleRate is 0 before the first prepare, when only the fixed ranges apply. */
+    bool isValid (const crossfeed_params& params, double sampleRate) noexcept
+    {
+        return isInRange (params.amplitude_low, 0.f, 1.f)
+            && isInRange (params.amplitude_high, 0.f, 1.f)
+            && isInRange (params.delay_low_us, 0.f, CrossfeedEngine<float>::defaultMaxDelayMicroseconds)
+            && isInRange (params.delay_high_us, 0.f, CrossfeedEngine<float>::defaultMaxDelayMicroseconds)
+            && isInRange (params.crossover_hz, 20.f, 20000.f)
+            && (sampleRate <= 0.0 || params.crossover_hz < sampleRate / 2.0);
+    }
+}
+
+//==============================================================================
+int crossfeed_get_api_version (void)
+{
+    return CROSSFEED_API_VERSION;
+}
+
+void crossfeed_default_params (crossfeed_params* params)
+{
+    if (params == nullptr)
+        return;
+
+    const CrossfeedParameterSnapshot defaults;
+
+    params->amplitude_low = defaults.amplitudeLow;
+    params->amplitude_high = defaults.amplitudeHigh;
+    params->delay_low_us = defaults.delayLow;
+    params->delay_high_us = defaults.delayHigh;
+    params->crossover_hz = defaults.crossoverFrequency;
+}
+
+crossfeed* crossfeed_create (void)
+{
+    return new (std::nothrow) crossfeed();
+}
+
+void crossfeed_destroy (crossfeed* cf)
+{
+    delete cf;
+}
+
+crossfeed_result crossfeed_prepare (crossfeed* cf, double sampleRate)
+{
+    if (cf == nullptr || ! (sampleRate >= 8000.0 && sampleRate <= 768000.0))
+        return CROSSFEED_ERROR_INVALID_ARGUMENT;
+
+    try
+    {
+        cf->engine.prepare (sampleRate);
+    }
+    catch (const std::bad_alloc&)
+    {
+        // The delay ring may be gone with it.
+        cf->sampleRate = 0.0;
+        return CROSSFEED_ERROR_OUT_OF_MEMORY;
+    }
+
+    cf->sampleRate = sampleRate;
+    cf->parametersChanged = true;
+    return CROSSFEED_OK;
+}
+
+crossfeed_result crossfeed_set_params (crossfeed* cf, const crossfeed_params* params)
+{
+    if (cf == nullptr || params == nullptr || ! isValid (*params, cf->sampleRate))
+        return CROSSFEED_ERROR_INVALID_ARGUMENT;
+
+    cf->parameters.amplitudeLow = params->amplitude_low;
+    cf->parameters.amplitudeHigh = params->amplitude_high;
+    cf->parameters.delayLow = params->delay_low_us;
+    cf->parameters.delayHigh = params->delay_high_us;
+    cf->parameters.crossoverFrequency = params->crossover_hz;
+    cf->parametersChanged = true;
+
+    return CROSSFEED_OK;
+}
+
+crossfeed_result crossfeed_process_interleaved (crossfeed* cf, float* frames, int numFrames)
+{
+    if (cf == nullptr || numFrames < 0 || (frames == nullptr && numFrames > 0))
+        return CROSSFEED_ERROR_INVALID_ARGUMENT;
+
+    if (cf->sampleRate <= 0.0)
+        return CROSSFEED_ERROR_NOT_PREPARED;
+
+    applyParameters (*cf);
+    cf->engine.processInterleaved (frames, numFrames);
+    return CROSSFEED_OK;
+}
+
+crossfeed_result crossfeed_process_planar (crossfeed* cf, float* left, float* right, int numFrames)
+{
+    if (cf == nullptr || numFrames < 0 || ((left == nullptr || right == nullptr) && numFrames > 0))
+        return CROSSFEED_ERROR_INVALID_ARGUMENT;
+
+    if (cf->sampleRate <= 0.0)
+        return CROSSFEED_ERROR_NOT_PREPARED;
+
+    applyParameters (*cf);
+
+    if (numFrames > 0)
+        cf->engine.process (left, right, numFrames);
+
+    return CROSSFEED_OK;
+}
+
+crossfeed_result crossfeed_reset (crossfeed* cf)
+{
+    if (cf == nullptr)
+        return CROSSFEED_ERROR_INVALID_ARGUMENT;
+
+    if (cf->sampleRate <= 0.0)
+        return CROSSFEED_ERROR_NOT_PREPARED;
+
+    cf->engine.reset();
+    return CROSSFEED_OK;
+}
+
+int crossfeed_get_tail_frames (const crossfeed* cf)
+{
+    if (cf == nullptr || cf->sampleRate <= 0.0)
+        return 0;
+
+    // -120 dB, as the plugin reports its tail.
+    return cf->engine.getTailSamples (cf->parameters.crossoverFrequency, 1.0e-6);
+}
@@ -0,0 +1,112 @@
+/*
+  ==============================================================================
+
+    libcrossfeed: the Crossfeed plugin's DSP as a C library.
+
+    The library runs the same engine as the plugin and, for the same sample
+    rate and settings, produces the same float output. It has no JUCE
+    dependency and no global state.
+
+    A crossfeed handle is created and prepared off the audio thread;
+    prepare allocates. After that, crossfeed_set_params, the process
+    functions and crossfeed_reset neither allocate nor lock, so they can be
+    called from a real-time thread. A handle must not be used from two
+    threads at once.
+
+    Typical use:
+
+        crossfeed* cf = crossfeed_create();
+        crossfeed_params params;
+        crossfeed_default_params (&params);
+        params.crossover_hz = 700.0f;
+
+        crossfeed_prepare (cf, 48000.0);
+        crossfeed_set_params (cf, &params);
+
+        // per block, on the audio thread
+        crossfeed_process_interleaved (cf, frames, num_frames);
+
+        crossfeed_destroy (cf);
+
+  ==============================================================================
+*/
+
+#ifndef CROSSFEED_H_INCLUDED
+#define CROSSFEED_H_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Bumped whenever a declaration here changes incompatibly. */
+#define CROSSFEED_API_VERSION 1
+
+/** Results. Errors leave the handle as it was, except that a prepare running
+    out of memory leaves it unprepared.
+*/
+typedef enum crossfeed_result
+{
+    CROSSFEED_OK = 0,
+    CROSSFEED_ERROR_INVALID_ARGUMENT = -1,   /* null pointer, negative count or value out of range */
+    CROSSFEED_ERROR_NOT_PREPARED = -2,       /* processing or resetting before crossfeed_prepare */
+    CROSSFEED_ERROR_OUT_OF_MEMORY = -3
+} crossfeed_result;
+
+/** The plugin's parameters, in its units and ranges. */
+typedef struct crossfeed_params
+{
+    float amplitude_low;     /* 0..1, crossfeed amount below the crossover */
+    float amplitude_high;    /* 0..1, crossfeed amount above the crossover */
+    float delay_low_us;      /* 0..1000 microseconds, cross delay below the crossover */
+    float delay_high_us;     /* 0..1000 microseconds, cross delay above the crossover */
+    float crossover_hz;      /* 20..20000 Hz, and below half the sample rate */
+} crossfeed_params;
+
+typedef struct crossfeed crossfeed;
+
+/** The library's CROSSFEED_API_VERSION, to check against the header in use. */
+int crossfeed_get_api_version (void);
+
+/** Fills params with the plugin's defaults. */
+void crossfeed_default_params (crossfeed_params* params);
+
+/** Returns a new handle with default parameters, or NULL if out of memory. */
+crossfeed* crossfeed_create (void);
+
+/** Frees a handle; NULL is ignored. */
+void crossfeed_destroy (crossfeed* cf);
+
+/** Allocates for a sample rate (8000..768000 Hz) and clears all state.
+    May be called again to change the rate. The parameters set when the
+    first block after this is processed apply at once, without a ramp.
+
+    The filters use crossovers of up to 0.49 times the rate and anything
+    higher is held there, including a crossover_hz set earlier that is too
+    high for the new rate; crossfeed_get_tail_frames does the same.
+*/
+crossfeed_result crossfeed_prepare (crossfeed* cf, double sample_rate);
+
+/** Sets new parameters, taken up by the next process call. Once processing
+    has started they are ramped in over about 20 ms. Out-of-range values
+    are rejected, and once prepared so is a crossover_hz at or above half
+    the sample rate. May be called before crossfeed_prepare.
+*/
+crossfeed_result crossfeed_set_params (crossfeed* cf, const crossfeed_params* params);
+
+/** Processes num_frames interleaved stereo frames (left, right, left, ...) in place. */
+crossfeed_result crossfeed_process_interleaved (crossfeed* cf, float* frames, int num_frames);
+
+/** Processes separate left and right channels in place. */
+crossfeed_result crossfeed_process_planar (crossfeed* cf, float* left, float* right, int num_frames);
+
+/** Clears the filter and delay state, e.g. between unrelated streams. */
+crossfeed_result crossfeed_reset (crossfeed* cf);
+
+/** Frames the output keeps ringing after the input stops, at the current crossover. */
+int crossfeed_get_tail_frames (const crossfeed* cf);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
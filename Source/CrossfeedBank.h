@@ -0,0 +1,97 @@
+/*
+  ==============================================================================
+
+    A convenience wrapper for running many independent stereo streams.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <memory>
+#include "CrossfeedParameters.h"
+
+//==============================================================================
+/**
+    N crossfeed streams, each with its own parameters, behind one call.
+
+    This is a loop over engines, not a structure-of-arrays bank: every stream
+    is a CrossfeedEngine fed from its own CrossfeedParameterStore, and process()
+    runs them one after another, each vectorised only across its own four
+    lanes. A stream therefore sounds exactly like the plugin with the same
+    settings: the same ramps, paths, interpolation and silence handling, in
+    float or double. It saves the caller the bookkeeping, not cache or SIMD
+    width; an earlier layout with the streams across the register cost about
+    four times as much per stream-frame, mostly in gathering each stream's
+    own delay taps.
+
+    setParameters() may be called from any thread while process() runs on the
+    audio thread, which picks up each stream's latest complete snapshot at the
+    start of a block. prepare() allocates; nothing else does.
+*/
+template <typename SampleType = float>
+class CrossfeedBank
+{
+public:
+    //==============================================================================
+    void prepare (double sampleRate, int numStreamsToUse,
+                  float maxDelayMicroseconds = CrossfeedEngine<SampleType>::defaultMaxDelayMicroseconds)
+    {
+        numStreams = std::max (0, numStreamsToUse);
+        streams.reset (new Stream[static_cast<size_t> (numStreams)]);
+
+        for (int stream = 0; stream < numStreams; stream++)
+            streams[static_cast<size_t> (stream)].engine.prepare (sampleRate, maxDelayMicroseconds);
+    }
+
+    /** Clears every stream's filter and delay state; parameters are kept. */
+    void reset() noexcept
+    {
+        for (int stream = 0; stream < numStreams; stream++)
+            streams[static_cast<size_t> (stream)].engine.reset();
+    }
+
+    int getNumStreams() const noexcept     { return numStreams; }
+
+    //==============================================================================
+    /** Sets one stream's parameters. Lock-free; the first set after prepare()
+        takes effect at once, later ones are ramped in.
+    */
+    void setParameters (int stream, const CrossfeedParameterSnapshot& parameters) noexcept
+    {
+        assert (stream >= 0 && stream < numStreams);
+        streams[static_cast<size_t> (stream)].parameters.publish (parameters);
+    }
+
+    //==============================================================================
+    /** Processes numStreams planar stereo blocks in place. */
+    void process (SampleType* const* left, SampleType* const* right, int numSamples) noexcept
+    {
+        if (numSamples <= 0)
+            return;
+
+        for (int stream = 0; stream < numStreams; stream++)
+        {
+            auto& s = streams[static_cast<size_t> (stream)];
+            s.engine.setParameters (s.parameters.read());
+            s.engine.process (left[stream], right[stream], numSamples);
+        }
+    }
+
+    /** True while the stream's input has been silent for longer than its tail. */
+    bool isIdle (int stream) const noexcept
+    {
+        return streams[static_cast<size_t> (stream)].engine.isIdle();
+    }
+
+private:
+    //==============================================================================
+    struct Stream
+    {
+        CrossfeedParameterStore parameters;
+        CrossfeedEngine<SampleType> engine;
+    };
+
+    std::unique_ptr<Stream[]> streams;
+    int numStreams = 0;
+};
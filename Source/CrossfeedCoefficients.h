@@ -0,0 +1,375 @@
+/*
+  ==============================================================================
+
+    Coefficient engine for the crossfeed kernel.
+
+    Parameter changes are smoothed instead of being applied as steps. The
+    engine hands out one CrossfeedSegment per sub-block: the filter
+    coefficients for that sub-block (recomputed only while the crossover
+    frequency is actually moving) plus start values and per-sample increments
+    for the band gains and delays. Nothing in here allocates after prepare().
+
+    Each segment also names the cheapest kernel path that renders it exactly,
+    so settings that switch part of the crossfeed off cost less.
+
+    Nothing here depends on JUCE; the ramps follow juce::SmoothedValue step
+    for step, see CrossfeedSmoothedValue.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <iterator>
+
+//==============================================================================
+/** The specialised kernel paths, from cheapest to most general. */
+enum class CrossfeedPath
+{
+    idle,               // silent input, nothing processed
+    bypass,             // no crossfeed in either band: the band split sums back to the input
+    noDelay,            // both delays zero: the cross signal is the other channel as is
+    noHighCrossfeed,    // high band passes dry, only the low band is delayed and mixed
+    general,
+    convolution,        // HRTF mode, see CrossfeedConvolution
+    numPaths
+};
+
+inline const char* getCrossfeedPathName (CrossfeedPath path) noexcept
+{
+    switch (path)
+    {
+        case CrossfeedPath::idle:               return "idle";
+        case CrossfeedPath::bypass:             return "bypass";
+        case CrossfeedPath::noDelay:            return "no delay";
+        case CrossfeedPath::noHighCrossfeed:    return "no high crossfeed";
+        case CrossfeedPath::convolution:        return "hrtf";
+        case CrossfeedPath::general:
+        case CrossfeedPath::numPaths:           break;
+    }
+
+    return "general";
+}
+
+//==============================================================================
+/** Everything the kernel needs to render one sub-block, laid out per lane.
+
+    The lane arrays are aligned for loading four lanes into one register.
+*/
+template <typename SampleType>
+struct CrossfeedSegment
+{
+    static constexpr size_t alignment = 4 * sizeof (SampleType);
+
+    // First-order filter coefficients, lanes as in CrossfeedKernel::Lane.
+    alignas (alignment) SampleType b0[4] {};
+    alignas (alignment) SampleType b1[4] {};
+    alignas (alignment) SampleType a1[4] {};
+
+    // Cross-feed gain per lane at the start of the sub-block and its per-sample increment.
+    alignas (alignment) SampleType wet[4] {};
+    alignas (alignment) SampleType wetStep[4] {};
+
+    // Cross delay in samples for the low and high band, and its per-sample increment.
+    SampleType delayLow {}, delayHigh {};
+    SampleType delayLowStep {}, delayHighStep {};
+
+    bool ramping = false;
+    CrossfeedPath path = CrossfeedPath::general;
+
+    /** Moves the ramps on by numSamples, for rendering the rest of the segment later.
+        The steps are added one sample at a time, as the renderers do, so that a
+        segment split across host blocks comes out bit-identical to a whole one.
+    */
+    void skip (int numSamples) noexcept
+    {
+        for (int i = 0; i < numSamples; i++)
+        {
+            for (int lane = 0; lane < 4; lane++)
+                wet[lane] += wetStep[lane];
+
+            delayLow += delayLowStep;
+            delayHigh += delayHighStep;
+        }
+    }
+};
+
+//==============================================================================
+/**
+    A value ramped towards its target over a fixed number of samples, linearly
+    or (for frequencies) exponentially. The arithmetic is that of
+    juce::SmoothedValue, so ramps come out the same as they did with it.
+*/
+template <typename SampleType, bool multiplicative = false>
+class CrossfeedSmoothedValue
+{
+public:
+    CrossfeedSmoothedValue() = default;
+
+    explicit CrossfeedSmoothedValue (SampleType initialValue) noexcept
+        : currentValue (initialValue), target (initialValue)
+    {
+    }
+
+    /** Sets the ramp length and jumps to the target. */
+    void reset (double sampleRate, double rampLengthSeconds) noexcept
+    {
+        stepsToTarget = static_cast<int> (std::floor (rampLengthSeconds * sampleRate));
+        setCurrentAndTargetValue (target);
+    }
+
+    void setCurrentAndTargetValue (SampleType newValue) noexcept
+    {
+        target = currentValue = newValue;
+        countdown = 0;
+    }
+
+    void setTargetValue (SampleType newValue) noexcept
+    {
+        if (newValue == target)
+            return;
+
+        if (stepsToTarget <= 0)
+        {
+            setCurrentAndTargetValue (newValue);
+            return;
+        }
+
+        target = newValue;
+        countdown = stepsToTarget;
+
+        if constexpr (multiplicative)
+            step = std::exp ((std::log (std::abs (target)) - std::log (std::abs (currentValue))) / static_cast<SampleType> (countdown));
+        else
+            step = (target - currentValue) / static_cast<SampleType> (countdown);
+    }
+
+    bool isSmoothing() const noexcept               { return countdown > 0; }
+    SampleType getCurrentValue() const noexcept     { return currentValue; }
+    SampleType getTargetValue() const noexcept      { return target; }
+
+    /** Moves numSamples along the ramp and returns the value reached. */
+    SampleType skip (int numSamples) noexcept
+    {
+        if (numSamples >= countdown)
+        {
+            setCurrentAndTargetValue (target);
+            return target;
+        }
+
+        if constexpr (multiplicative)
+            currentValue *= static_cast<SampleType> (std::pow (step, numSamples));
+        else
+            currentValue += step * static_cast<SampleType> (numSamples);
+
+        countdown -= numSamples;
+        return currentValue;
+    }
+
+private:
+    SampleType currentValue {}, target {}, step {};
+    int countdown = 0, stepsToTarget = 0;
+};
+
+//==============================================================================
+/**
+    Coefficients and ramps are computed in the sample type the kernel runs in.
+*/
+template <typename SampleType>
+class CrossfeedCoefficients
+{
+public:
+    /** Coefficients are redesigned at most once per this many samples while the crossover moves. */
+    static constexpr int subBlockSize = 32;
+
+    static constexpr double pi = 3.141592653589793238;
+
+    /** The crossover is kept this far below Nyquist; beyond it the prewarped
+        bilinear design blows up (tan reaches infinity at Nyquist, then turns
+        negative) and the filters go unstable.
+    */
+    static constexpr double maxCrossoverRatio = 0.49;
+
+    /** Clamps a crossover frequency to what the filters can be designed for at sampleRate. */
+    static double limitCrossoverFrequency (double sampleRate, double frequency) noexcept
+    {
+        return std::clamp (frequency, 1.0, maxCrossoverRatio * sampleRate);
+    }
+
+    //==============================================================================
+    void prepare (double newSampleRate, double rampLengthSeconds = 0.02)
+    {
+        sampleRate = newSampleRate;
+
+        crossoverFrequency.reset (sampleRate, rampLengthSeconds);
+        delayLow.reset (sampleRate, rampLengthSeconds);
+        delayHigh.reset (sampleRate, rampLengthSeconds);
+        amplitudeLow.reset (sampleRate, rampLengthSeconds);
+        amplitudeHigh.reset (sampleRate, rampLengthSeconds);
+
+        // The first set of targets after prepare() is applied immediately.
+        snapToTargets = true;
+    }
+
+    /** Sets new targets; delays are in samples. Cheap enough to call every block. */
+    void setTargets (SampleType frequency, SampleType lowDelaySamples, SampleType highDelaySamples,
+                     SampleType lowAmplitude, SampleType highAmplitude) noexcept
+    {
+        frequency = static_cast<SampleType> (limitCrossoverFrequency (sampleRate, static_cast<double> (frequency)));
+
+        if (snapToTargets)
+        {
+            crossoverFrequency.setCurrentAndTargetValue (frequency);
+            delayLow.setCurrentAndTargetValue (lowDelaySamples);
+            delayHigh.setCurrentAndTargetValue (highDelaySamples);
+            amplitudeLow.setCurrentAndTargetValue (lowAmplitude);
+            amplitudeHigh.setCurrentAndTargetValue (highAmplitude);
+
+            designFilters (frequency);
+            snapToTargets = false;
+            return;
+        }
+
+        crossoverFrequency.setTargetValue (frequency);
+        delayLow.setTargetValue (lowDelaySamples);
+        delayHigh.setTargetValue (highDelaySamples);
+        amplitudeLow.setTargetValue (lowAmplitude);
+        amplitudeHigh.setTargetValue (highAmplitude);
+    }
+
+    /** Jumps every ramp to its target; for when there is no signal state to ramp. */
+    void settle() noexcept
+    {
+        crossoverFrequency.setCurrentAndTargetValue (crossoverFrequency.getTargetValue());
+        delayLow.setCurrentAndTargetValue (delayLow.getTargetValue());
+        delayHigh.setCurrentAndTargetValue (delayHigh.getTargetValue());
+        amplitudeLow.setCurrentAndTargetValue (amplitudeLow.getTargetValue());
+        amplitudeHigh.setCurrentAndTargetValue (amplitudeHigh.getTargetValue());
+
+        if (designedFrequency != crossoverFrequency.getTargetValue())
+            designFilters (crossoverFrequency.getTargetValue());
+    }
+
+    SampleType getTargetCrossoverFrequency() const noexcept     { return crossoverFrequency.getTargetValue(); }
+
+    bool isRamping() const noexcept
+    {
+        return crossoverFrequency.isSmoothing() || delayLow.isSmoothing() || delayHigh.isSmoothing()
+            || amplitudeLow.isSmoothing() || amplitudeHigh.isSmoothing();
+    }
+
+    /** Samples until the memory of the crossover filters has decayed to tolerance
+        (relative to the signal level) at the given crossover frequency.
+    */
+    static int getSettlingSamples (double sampleRate, double frequency, double tolerance)
+    {
+        const auto n = std::tan (pi * limitCrossoverFrequency (sampleRate, frequency) / sampleRate);
+        const auto pole = std::abs ((n - 1.0) / (n + 1.0));
+
+        if (pole <= 0.0 || pole >= 1.0)
+            return 1;
+
+        return static_cast<int> (std::ceil (std::log (tolerance) / std::log (pole)));
+    }
+
+    //==============================================================================
+    /** Advances the ramps by numSamples (at most subBlockSize) and describes that stretch in segment.
+        The kernel always asks for whole sub-blocks, see CrossfeedKernel.
+    */
+    void next (int numSamples, CrossfeedSegment<SampleType>& segment) noexcept
+    {
+        assert (numSamples > 0 && numSamples <= subBlockSize);
+
+        if (crossoverFrequency.isSmoothing())
+            designFilters (crossoverFrequency.skip (numSamples));
+
+        std::copy (std::begin (b0), std::end (b0), segment.b0);
+        std::copy (std::begin (b1), std::end (b1), segment.b1);
+        std::copy (std::begin (a1), std::end (a1), segment.a1);
+
+        const auto inverse = (SampleType) 1 / static_cast<SampleType> (numSamples);
+
+        segment.ramping = isRamping();
+
+        advance (amplitudeLow, numSamples, inverse, segment.wet[0], segment.wetStep[0]);
+        advance (amplitudeHigh, numSamples, inverse, segment.wet[2], segment.wetStep[2]);
+        segment.wet[1] = segment.wet[0];
+        segment.wetStep[1] = segment.wetStep[0];
+        segment.wet[3] = segment.wet[2];
+        segment.wetStep[3] = segment.wetStep[2];
+
+        advance (delayLow, numSamples, inverse, segment.delayLow, segment.delayLowStep);
+        advance (delayHigh, numSamples, inverse, segment.delayHigh, segment.delayHighStep);
+
+        segment.path = choosePath (segment);
+    }
+
+private:
+    //==============================================================================
+    /** Only steady segments take a shortcut; every ramp runs through the general
+        path, so switching paths never changes the output beyond rounding.
+    */
+    static CrossfeedPath choosePath (const CrossfeedSegment<SampleType>& segment) noexcept
+    {
+        if (segment.ramping)
+            return CrossfeedPath::general;
+
+        if (segment.wet[0] == SampleType() && segment.wet[2] == SampleType())
+            return CrossfeedPath::bypass;
+
+        if (segment.delayLow == SampleType() && segment.delayHigh == SampleType())
+            return CrossfeedPath::noDelay;
+
+        if (segment.wet[2] == SampleType())
+            return CrossfeedPath::noHighCrossfeed;
+
+        return CrossfeedPath::general;
+    }
+
+    template <typename Smoothed>
+    static void advance (Smoothed& value, int numSamples, SampleType inverse, SampleType& start, SampleType& step) noexcept
+    {
+        start = value.getCurrentValue();
+
+        if (! value.isSmoothing())
+        {
+            step = {};
+            return;
+        }
+
+        step = (value.skip (numSamples) - start) * inverse;
+    }
+
+    void designFilters (SampleType frequency) noexcept
+    {
+        // The targets are limited already; this catches a rate lowered since they were set.
+        frequency = static_cast<SampleType> (limitCrossoverFrequency (sampleRate, static_cast<double> (frequency)));
+        designedFrequency = frequency;
+
+        // Same bilinear first-order design as IIR::Coefficients::makeFirstOrderLowPass/HighPass.
+        const auto n = std::tan (static_cast<SampleType> (pi) * frequency / static_cast<SampleType> (sampleRate));
+        const auto a0inv = (SampleType) 1 / (n + (SampleType) 1);
+
+        b0[0] = b0[1] = n * a0inv;
+        b1[0] = b1[1] = n * a0inv;
+        b0[2] = b0[3] = a0inv;
+        b1[2] = b1[3] = -a0inv;
+
+        for (auto& a : a1)
+            a = (n - (SampleType) 1) * a0inv;
+    }
+
+    //==============================================================================
+    double sampleRate = 44100.0;
+    bool snapToTargets = true;
+
+    CrossfeedSmoothedValue<SampleType, true> crossoverFrequency { (SampleType) 1000 };
+    CrossfeedSmoothedValue<SampleType> delayLow, delayHigh;
+    CrossfeedSmoothedValue<SampleType> amplitudeLow, amplitudeHigh;
+
+    SampleType designedFrequency {};
+    SampleType b0[4] {}, b1[4] {}, a1[4] {};
+};
@@ -0,0 +1,608 @@
+/*
+  ==============================================================================
+
+    Partitioned FFT convolution for the HRTF crossfeed mode.
+
+    Each speaker is convolved with a measured head-related impulse response
+    for each ear: four paths, summed per ear. The convolution is partitioned
+    non-uniformly in two stages. The first tailSize samples of the responses
+    are split into small partitions of headSize, which set the latency. The
+    rest is split into partitions of tailSize, computed once per tailSize
+    samples. Both stages run uniformly partitioned overlap-save with a
+    frequency-domain delay line, and each speaker is transformed once per
+    stage no matter how many paths use it.
+
+    Responses are partitioned and transformed into a Filter off the audio
+    thread, then handed over without locks. The audio thread swaps them in at
+    the start of a tail period and crossfades from the old filter over that
+    period. Filters it is done with go back through a queue, to be freed by
+    the thread that hands over new ones.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "CrossfeedPerformance.h"
+
+//==============================================================================
+/**
+*/
+class CrossfeedConvolution
+{
+public:
+    /** Head partition size; this is also the latency. */
+    static constexpr int headSize = 64;
+
+    /** Tail partition size, and the part of the responses the head covers. */
+    static constexpr int tailSize = 1024;
+
+    static constexpr int chunksPerTail = tailSize / headSize;
+
+    /** Channels of a response buffer: from each speaker to each ear. */
+    enum Path { leftToLeft = 0, leftToRight, rightToLeft, rightToRight, numPaths };
+
+    //==============================================================================
+    /** One block of spectrum in split real/imaginary form, bins 0 to size / 2. */
+    struct Spectrum
+    {
+        std::vector<float> real, imag;
+
+        void setSize (int numBins)
+        {
+            real.assign (static_cast<size_t> (numBins), 0.f);
+            imag.assign (static_cast<size_t> (numBins), 0.f);
+        }
+
+        void clear() noexcept
+        {
+            std::fill (real.begin(), real.end(), 0.f);
+            std::fill (imag.begin(), imag.end(), 0.f);
+        }
+    };
+
+    //==============================================================================
+    /**
+        The four responses, partitioned and transformed. Expensive to build, so
+        build it on a background thread.
+    */
+    class Filter
+    {
+    public:
+        /** responses holds the four paths as channels (see Path), at the processing sample rate. */
+        explicit Filter (const juce::AudioBuffer<float>& responses)
+        {
+            jassert (responses.getNumChannels() == numPaths);
+
+            const auto length = responses.getNumSamples();
+            const auto headLength = juce::jmin (length, tailSize);
+
+            juce::dsp::FFT headFFT (juce::roundToInt (std::log2 (2 * headSize)));
+            juce::dsp::FFT tailFFT (juce::roundToInt (std::log2 (2 * tailSize)));
+            std::vector<float> scratch (static_cast<size_t> (4 * tailSize));
+
+            for (int path = 0; path < numPaths; path++)
+            {
+                partition (headFFT, responses.getReadPointer (path), 0, headLength, headSize, head[path], scratch.data());
+                partition (tailFFT, responses.getReadPointer (path), headLength, length, tailSize, tail[path], scratch.data());
+            }
+        }
+
+        int getNumHeadPartitions() const noexcept     { return static_cast<int> (head[0].size()); }
+        int getNumTailPartitions() const noexcept     { return static_cast<int> (tail[0].size()); }
+
+    private:
+        friend class CrossfeedConvolution;
+
+        static void partition (juce::dsp::FFT& fft, const float* response, int start, int end, int size,
+                               std::vector<Spectrum>& partitions, float* scratch)
+        {
+            for (int offset = start; offset < end; offset += size)
+            {
+                partitions.emplace_back();
+                partitions.back().setSize (size + 1);
+                forward (fft, response + offset, juce::jmin (size, end - offset), partitions.back(), scratch);
+            }
+        }
+
+        std::vector<Spectrum> head[numPaths], tail[numPaths];
+    };
+
+    //==============================================================================
+    CrossfeedConvolution() = default;
+
+    ~CrossfeedConvolution()
+    {
+        releaseFilters();
+    }
+
+    /** Sizes the delay lines for responses of up to maxLength samples and drops
+        any filter, which was made for another sample rate.
+    */
+    void prepare (int maxLength)
+    {
+        releaseFilters();
+
+        head.prepare (headSize, chunksPerTail);
+        tail.prepare (tailSize, juce::jmax (0, (maxLength - tailSize + tailSize - 1) / tailSize));
+
+        scratch.assign (static_cast<size_t> (4 * tailSize), 0.f);
+
+        for (auto& channel : inputChunk)
+            channel.assign (headSize, 0.f);
+
+        for (auto& channel : outputChunk)
+            channel.assign (headSize, 0.f);
+
+        for (auto& filterOutput : headOutput)
+            for (auto& channel : filterOutput)
+                channel.assign (headSize, 0.f);
+
+        for (auto& filterOutput : tailOutput)
+            for (auto& channel : filterOutput)
+                channel.assign (tailSize, 0.f);
+
+        reset();
+    }
+
+    /** Clears the signal history; the filter stays. */
+    void reset() noexcept
+    {
+        head.reset();
+        tail.reset();
+
+        for (auto* channels : { &inputChunk, &outputChunk })
+            for (auto& channel : *channels)
+                std::fill (channel.begin(), channel.end(), 0.f);
+
+        for (auto& filterOutput : tailOutput)
+            for (auto& channel : filterOutput)
+                std::fill (channel.begin(), channel.end(), 0.f);
+
+        chunkPosition = 0;
+        tailPhase = 0;
+    }
+
+    static constexpr int getLatencySamples() noexcept     { return headSize; }
+
+    //==============================================================================
+    /** Hands a filter to the audio thread, replacing one that has not been picked up yet. */
+    void setFilter (std::unique_ptr<Filter> filter)
+    {
+        delete pending.exchange (filter.release());
+        collectGarbage();
+    }
+
+    /** Frees the filters the audio thread has finished with. Call from the thread that calls setFilter(). */
+    void collectGarbage()
+    {
+        Filter* filters[8];
+
+        while (const auto n = garbage.pop (filters, 8))
+            for (int i = 0; i < n; i++)
+                delete filters[i];
+    }
+
+    /** Audio thread: true once a filter is in use. Picks up the first filter straight away. */
+    bool isReady() noexcept
+    {
+        if (current == nullptr)
+            current = pending.exchange (nullptr);
+
+        return current != nullptr;
+    }
+
+    //==============================================================================
+    /** Convolves a stereo block in place, delayed by getLatencySamples(). */
+    void process (float* left, float* right, int numSamples) noexcept
+    {
+        if (! isReady())
+        {
+            juce::FloatVectorOperations::clear (left, numSamples);
+            juce::FloatVectorOperations::clear (right, numSamples);
+            return;
+        }
+
+        for (int offset = 0; offset < numSamples;)
+        {
+            const auto length = juce::jmin (headSize - chunkPosition, numSamples - offset);
+
+            juce::FloatVectorOperations::copy (inputChunk[0].data() + chunkPosition, left + offset, length);
+            juce::FloatVectorOperations::copy (inputChunk[1].data() + chunkPosition, right + offset, length);
+            juce::FloatVectorOperations::copy (left + offset, outputChunk[0].data() + chunkPosition, length);
+            juce::FloatVectorOperations::copy (right + offset, outputChunk[1].data() + chunkPosition, length);
+
+            offset += length;
+            chunkPosition += length;
+
+            if (chunkPosition == headSize)
+            {
+                processChunk();
+                chunkPosition = 0;
+            }
+        }
+    }
+
+    //==============================================================================
+    /** Reads a response file: either a stereo file holding the left speaker's
+        response at the left and right ear (mirrored for the right speaker), or
+        a four-channel file with all paths in the order of Path.
+
+        The responses are resampled to sampleRate and scaled so that no
+        frequency gains level for a centred source.
+    */
+    static juce::AudioBuffer<float> readResponses (const juce::File& file, double sampleRate, int maxLength, juce::String& error)
+    {
+        juce::AudioFormatManager formats;
+        formats.registerBasicFormats();
+
+        std::unique_ptr<juce::AudioFormatReader> reader (formats.createReaderFor (file));
+
+        if (reader == nullptr)
+        {
+            error = "Cannot read " + file.getFullPathName();
+            return {};
+        }
+
+        if (reader->numChannels != 2 && reader->numChannels != 4)
+        {
+            error = file.getFileName() + ": needs 2 or 4 channels";
+            return {};
+        }
+
+        const auto ratio = reader->sampleRate / sampleRate;
+        const auto fileLength = static_cast<int> (juce::jmin (reader->lengthInSamples,
+                                                              static_cast<juce::int64> (std::ceil (maxLength * ratio))));
+
+        if (fileLength <= 0)
+        {
+            error = file.getFileName() + " is empty";
+            return {};
+        }
+
+        juce::AudioBuffer<float> source (static_cast<int> (reader->numChannels), fileLength);
+        reader->read (&source, 0, fileLength, 0, true, true);
+
+        if (ratio > 1.0)
+            for (int channel = 0; channel < source.getNumChannels(); channel++)
+                bandLimit (source.getWritePointer (channel), fileLength, ratio);
+
+        const int channels[numPaths] = { 0, 1, reader->numChannels == 2 ? 1 : 2, reader->numChannels == 2 ? 0 : 3 };
+        const auto length = juce::jmin (maxLength, static_cast<int> (std::ceil (fileLength / ratio)));
+
+        juce::AudioBuffer<float> responses (numPaths, length);
+
+        for (int path = 0; path < numPaths; path++)
+        {
+            if (ratio == 1.0)
+            {
+                responses.copyFrom (path, 0, source, channels[path], 0, length);
+            }
+            else
+            {
+                // Told how much input there is, the interpolator reads zeros past the end
+                // instead of running off the buffer, whatever the ratio.
+                juce::LagrangeInterpolator interpolator;
+                interpolator.process (ratio, source.getReadPointer (channels[path]), responses.getWritePointer (path),
+                                      length, fileLength, 0);
+            }
+        }
+
+        normalise (responses);
+        return responses;
+    }
+
+private:
+    //==============================================================================
+    /** Low-passes a response for resampling it to a rate ratio times lower:
+        flat to 0.84 of the new Nyquist frequency and down by 79 dB from it on,
+        so nothing aliases. The filter is a Blackman-windowed sinc applied
+        without delay, which keeps the response's timing; it runs once per
+        load, so it is computed directly.
+    */
+    static void bandLimit (float* samples, int numSamples, double ratio)
+    {
+        const auto cutoff = 0.45 / ratio;
+        const auto half = static_cast<int> (std::ceil (32.0 * ratio));
+        std::vector<double> taps (static_cast<size_t> (2 * half + 1));
+        double sum = 0.0;
+
+        for (int k = -half; k <= half; k++)
+        {
+            const auto x = juce::MathConstants<double>::pi * k;
+            const auto sinc = k == 0 ? 2.0 * cutoff : std::sin (2.0 * cutoff * x) / x;
+            const auto window = 0.42 + 0.5 * std::cos (x / (half + 1)) + 0.08 * std::cos (2.0 * x / (half + 1));
+
+            taps[static_cast<size_t> (k + half)] = sinc * window;
+            sum += sinc * window;
+        }
+
+        const std::vector<float> input (samples, samples + numSamples);
+
+        for (int i = 0; i < numSamples; i++)
+        {
+            double output = 0.0;
+
+            for (int k = juce::jmax (-half, -i); k <= juce::jmin (half, numSamples - 1 - i); k++)
+                output += taps[static_cast<size_t> (k + half)] * input[static_cast<size_t> (i + k)];
+
+            samples[i] = static_cast<float> (output / sum);
+        }
+    }
+
+    static void normalise (juce::AudioBuffer<float>& responses)
+    {
+        const auto order = juce::roundToInt (std::log2 (juce::nextPowerOfTwo (responses.getNumSamples()))) + 1;
+        juce::dsp::FFT fft (order);
+
+        Spectrum ears[2], path;
+        ears[0].setSize (fft.getSize() / 2 + 1);
+        ears[1].setSize (fft.getSize() / 2 + 1);
+        path.setSize (fft.getSize() / 2 + 1);
+        std::vector<float> scratch (static_cast<size_t> (2 * fft.getSize()));
+
+        for (int p = 0; p < numPaths; p++)
+        {
+            forward (fft, responses.getReadPointer (p), responses.getNumSamples(), path, scratch.data());
+            auto& ear = ears[p == leftToLeft || p == rightToLeft ? 0 : 1];
+
+            juce::FloatVectorOperations::add (ear.real.data(), path.real.data(), static_cast<int> (path.real.size()));
+            juce::FloatVectorOperations::add (ear.imag.data(), path.imag.data(), static_cast<int> (path.imag.size()));
+        }
+
+        // Peak of the response to the same signal on both speakers.
+        auto peak = 0.f;
+
+        for (const auto& ear : ears)
+            for (size_t bin = 0; bin < ear.real.size(); bin++)
+                peak = juce::jmax (peak, std::hypot (ear.real[bin], ear.imag[bin]));
+
+        if (peak > 0.f)
+            responses.applyGain (1.f / peak);
+    }
+
+    //==============================================================================
+    /** Transforms length samples, zero-padded to the FFT size. scratch holds 2 * FFT size floats. */
+    static void forward (const juce::dsp::FFT& fft, const float* input, int length, Spectrum& spectrum, float* scratch) noexcept
+    {
+        const auto size = fft.getSize();
+
+        std::copy (input, input + length, scratch);
+        std::fill (scratch + length, scratch + 2 * size, 0.f);
+        fft.performRealOnlyForwardTransform (scratch, true);
+
+        for (int bin = 0; bin <= size / 2; bin++)
+        {
+            spectrum.real[static_cast<size_t> (bin)] = scratch[2 * bin];
+            spectrum.imag[static_cast<size_t> (bin)] = scratch[2 * bin + 1];
+        }
+    }
+
+    /** Back to FFT size real samples in scratch; the negative frequencies are filled in by symmetry. */
+    static void inverse (const juce::dsp::FFT& fft, const Spectrum& spectrum, float* scratch) noexcept
+    {
+        const auto size = fft.getSize();
+
+        for (int bin = 0; bin <= size / 2; bin++)
+        {
+            scratch[2 * bin] = spectrum.real[static_cast<size_t> (bin)];
+            scratch[2 * bin + 1] = spectrum.imag[static_cast<size_t> (bin)];
+        }
+
+        for (int bin = size / 2 + 1; bin < size; bin++)
+        {
+            scratch[2 * bin] = scratch[2 * (size - bin)];
+            scratch[2 * bin + 1] = -scratch[2 * (size - bin) + 1];
+        }
+
+        fft.performRealOnlyInverseTransform (scratch);
+    }
+
+    //==============================================================================
+    /** One uniformly partitioned overlap-save stage. */
+    struct Stage
+    {
+        void prepare (int partitionSize, int maxPartitions)
+        {
+            size = partitionSize;
+            numPartitions = maxPartitions;
+            fft = std::make_unique<juce::dsp::FFT> (juce::roundToInt (std::log2 (2 * size)));
+
+            for (int speaker = 0; speaker < 2; speaker++)
+            {
+                window[speaker].assign (static_cast<size_t> (2 * size), 0.f);
+                history[speaker].resize (static_cast<size_t> (juce::jmax (1, numPartitions)));
+
+                for (auto& spectrum : history[speaker])
+                    spectrum.setSize (size + 1);
+            }
+
+            accumulator.setSize (size + 1);
+            newest = 0;
+        }
+
+        void reset() noexcept
+        {
+            for (int speaker = 0; speaker < 2; speaker++)
+            {
+                std::fill (window[speaker].begin(), window[speaker].end(), 0.f);
+
+                for (auto& spectrum : history[speaker])
+                    spectrum.clear();
+            }
+
+            newest = 0;
+        }
+
+        /** The second half of each window is filled with new input; this transforms and slides it. */
+        void push (float* scratch) noexcept
+        {
+            newest = (newest + 1) % static_cast<int> (history[0].size());
+
+            for (int speaker = 0; speaker < 2; speaker++)
+            {
+                auto& w = window[speaker];
+                forward (*fft, w.data(), 2 * size, history[speaker][static_cast<size_t> (newest)], scratch);
+                std::copy (w.begin() + size, w.end(), w.begin());
+            }
+        }
+
+        float* getInput (int speaker, int offset) noexcept     { return window[speaker].data() + size + offset; }
+
+        /** Output for the last pushed block through the given paths, into size samples per ear. */
+        void convolve (const std::vector<Spectrum>* paths, std::vector<float>* output, float* scratch) noexcept
+        {
+            const auto partitions = juce::jmin (numPartitions, static_cast<int> (paths[0].size()));
+            const auto numBins = size + 1;
+            const auto numSlots = static_cast<int> (history[0].size());
+
+            for (int ear = 0; ear < 2; ear++)
+            {
+                accumulator.clear();
+
+                for (int partition = 0; partition < partitions; partition++)
+                {
+                    const auto slot = static_cast<size_t> ((newest - partition + numSlots) % numSlots);
+
+                    for (int speaker = 0; speaker < 2; speaker++)
+                    {
+                        const auto& x = history[speaker][slot];
+                        const auto& h = paths[speaker * 2 + ear][static_cast<size_t> (partition)];
+
+                        auto* accReal = accumulator.real.data();
+                        auto* accImag = accumulator.imag.data();
+
+                        for (int bin = 0; bin < numBins; bin++)
+                        {
+                            accReal[bin] += x.real[static_cast<size_t> (bin)] * h.real[static_cast<size_t> (bin)]
+                                          - x.imag[static_cast<size_t> (bin)] * h.imag[static_cast<size_t> (bin)];
+                            accImag[bin] += x.real[static_cast<size_t> (bin)] * h.imag[static_cast<size_t> (bin)]
+                                          + x.imag[static_cast<size_t> (bin)] * h.real[static_cast<size_t> (bin)];
+                        }
+                    }
+                }
+
+                if (partitions == 0)
+                {
+                    std::fill (output[ear].begin(), output[ear].end(), 0.f);
+                    continue;
+                }
+
+                inverse (*fft, accumulator, scratch);
+                std::copy (scratch + size, scratch + 2 * size, output[ear].begin());
+            }
+        }
+
+        int size = 0, numPartitions = 0;
+        std::unique_ptr<juce::dsp::FFT> fft;
+        std::vector<float> window[2];
+        std::vector<Spectrum> history[2];
+        Spectrum accumulator;
+        int newest = 0;
+    };
+
+    //==============================================================================
+    void processChunk() noexcept
+    {
+        // Head: a new partition every chunk.
+        for (int speaker = 0; speaker < 2; speaker++)
+        {
+            std::copy (inputChunk[speaker].begin(), inputChunk[speaker].end(), head.getInput (speaker, 0));
+            std::copy (inputChunk[speaker].begin(), inputChunk[speaker].end(), tail.getInput (speaker, tailPhase * headSize));
+        }
+
+        head.push (scratch.data());
+
+        Filter* filters[2] = { current, fading ? previous : nullptr };
+
+        for (int f = 0; f < 2; f++)
+        {
+            if (filters[f] == nullptr)
+                continue;
+
+            head.convolve (filters[f]->head, headOutput[f], scratch.data());
+
+            for (int ear = 0; ear < 2; ear++)
+                juce::FloatVectorOperations::add (headOutput[f][ear].data(), tailOutput[f][ear].data() + tailPhase * headSize, headSize);
+        }
+
+        if (! fading)
+        {
+            for (int ear = 0; ear < 2; ear++)
+                std::copy (headOutput[0][ear].begin(), headOutput[0][ear].end(), outputChunk[ear].begin());
+        }
+        else
+        {
+            // Linear crossfade over the tail period that follows a swap.
+            const auto step = 1.f / static_cast<float> (tailSize);
+            const auto start = static_cast<float> (tailPhase * headSize + 1) * step;
+
+            for (int ear = 0; ear < 2; ear++)
+                for (int i = 0; i < headSize; i++)
+                {
+                    const auto gain = juce::jmin (1.f, start + static_cast<float> (i) * step);
+                    outputChunk[ear][static_cast<size_t> (i)] = headOutput[1][ear][static_cast<size_t> (i)]
+                                                              + gain * (headOutput[0][ear][static_cast<size_t> (i)] - headOutput[1][ear][static_cast<size_t> (i)]);
+                }
+        }
+
+        if (++tailPhase < chunksPerTail)
+            return;
+
+        // Tail: a new partition every tail period, covering the whole of the next period.
+        tailPhase = 0;
+        tail.push (scratch.data());
+
+        fading = false;
+
+        if (previous != nullptr && garbage.push (previous))
+            previous = nullptr;
+
+        if (previous == nullptr)
+        {
+            if (auto* next = pending.exchange (nullptr))
+            {
+                previous = current;
+                current = next;
+                fading = true;
+            }
+        }
+
+        tail.convolve (current->tail, tailOutput[0], scratch.data());
+
+        if (fading)
+            tail.convolve (previous->tail, tailOutput[1], scratch.data());
+    }
+
+    void releaseFilters()
+    {
+        collectGarbage();
+
+        delete pending.exchange (nullptr);
+        delete current;
+        delete previous;
+
+        current = previous = nullptr;
+        fading = false;
+    }
+
+    //==============================================================================
+    Stage head, tail;
+    std::vector<float> scratch;
+
+    std::vector<float> inputChunk[2], outputChunk[2];
+    std::vector<float> headOutput[2][2], tailOutput[2][2];  // [current, previous][ear]
+    int chunkPosition = 0, tailPhase = 0;
+
+    // Audio thread. previous waits here for room in the garbage queue once the fade is over.
+    Filter* current = nullptr;
+    Filter* previous = nullptr;
+    bool fading = false;
+
+    // Handover between the audio thread and the loading thread.
+    std::atomic<Filter*> pending { nullptr };
+    CrossfeedSPSCQueue<Filter*, 16> garbage;
+
+    JUCE_DECLARE_NON_COPYABLE (CrossfeedConvolution)
+};
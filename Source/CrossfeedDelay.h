@@ -0,0 +1,287 @@
+/*
+  ==============================================================================
+
+    Cross-delay line for the crossfeed kernel.
+
+    The ring holds interleaved four-lane frames and is sized to the largest
+    delay the parameters allow rather than to a fixed amount of time, rounded
+    up to a power of two so that wrapping is a mask. At the default 1 ms
+    maximum this is a few kilobytes even at 384 kHz, so the whole history
+    stays in L1.
+
+    Frames are written and read a block at a time. The sample type and the
+    interpolation method are template arguments, see CrossfeedInterpolationTypes.
+
+    Each frame is stored with the channels of both bands swapped (low R, low L,
+    high R, high L), which is the order the crossed signal is read back in. A
+    read then interpolates whole frames with the kernel's lane type, one vector
+    operation for all four lanes, and picks each band's lanes with a 0/1 mask;
+    reading lane by lane used to cost about as much as the rest of the kernel.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+//==============================================================================
+/**
+    Fractional delay interpolators, following juce::dsp::DelayLineInterpolationTypes.
+
+    Each type adjusts the integer/fractional split of the delay to suit its
+    kernel, then interpolates whole frames at index, index - 1, ... (newest to
+    oldest) in the ring. Types that need memory between samples get the
+    previous output frame from the delay line.
+*/
+namespace CrossfeedInterpolationTypes
+{
+    template <typename Lanes, typename SampleType>
+    inline Lanes frameAt (const SampleType* ring, int mask, int index) noexcept
+    {
+        return Lanes::fromRawArray (ring + (index & mask) * 4);
+    }
+
+    /** Two-point linear interpolation. */
+    struct Linear
+    {
+        static constexpr int extraFrames = 1;
+
+        template <typename SampleType>
+        static void adjust (int&, SampleType&) noexcept {}
+
+        template <typename Lanes, typename SampleType>
+        static Lanes interpolate (const SampleType* ring, int mask, int index, SampleType frac, const Lanes&) noexcept
+        {
+            const auto value1 = frameAt<Lanes> (ring, mask, index);
+            const auto value2 = frameAt<Lanes> (ring, mask, index - 1);
+            return value1 + Lanes::expand (frac) * (value2 - value1);
+        }
+    };
+
+    /** Third-order Lagrange interpolation over four frames. */
+    struct Lagrange3rd
+    {
+        static constexpr int extraFrames = 3;
+
+        template <typename SampleType>
+        static void adjust (int& delayInt, SampleType& delayFrac) noexcept
+        {
+            // Centre the fractional part between the middle two taps.
+            if (delayInt >= 1)
+            {
+                delayFrac++;
+                delayInt--;
+            }
+        }
+
+        template <typename Lanes, typename SampleType>
+        static Lanes interpolate (const SampleType* ring, int mask, int index, SampleType frac, const Lanes&) noexcept
+        {
+            const auto value1 = frameAt<Lanes> (ring, mask, index);
+            const auto value2 = frameAt<Lanes> (ring, mask, index - 1);
+            const auto value3 = frameAt<Lanes> (ring, mask, index - 2);
+            const auto value4 = frameAt<Lanes> (ring, mask, index - 3);
+
+            const auto d1 = frac - (SampleType) 1;
+            const auto d2 = frac - (SampleType) 2;
+            const auto d3 = frac - (SampleType) 3;
+
+            const auto c1 = -d1 * d2 * d3 / (SampleType) 6;
+            const auto c2 = d2 * d3 * (SampleType) 0.5;
+            const auto c3 = -d1 * d3 * (SampleType) 0.5;
+            const auto c4 = d1 * d2 / (SampleType) 6;
+
+            return value1 * Lanes::expand (c1)
+                 + Lanes::expand (frac) * (value2 * Lanes::expand (c2) + value3 * Lanes::expand (c3) + value4 * Lanes::expand (c4));
+        }
+    };
+
+    /** First-order Thiran allpass; flat magnitude, feeds back its previous output. */
+    struct Thiran
+    {
+        static constexpr int extraFrames = 1;
+
+        template <typename SampleType>
+        static void adjust (int& delayInt, SampleType& delayFrac) noexcept
+        {
+            // Keep the allpass away from its poorly behaved low-fraction region.
+            if (delayFrac < (SampleType) 0.618 && delayInt >= 1)
+            {
+                delayFrac++;
+                delayInt--;
+            }
+        }
+
+        template <typename Lanes, typename SampleType>
+        static Lanes interpolate (const SampleType* ring, int mask, int index, SampleType frac, const Lanes& previous) noexcept
+        {
+            const auto value1 = frameAt<Lanes> (ring, mask, index);
+
+            if (frac == (SampleType) 0)
+                return value1;
+
+            const auto value2 = frameAt<Lanes> (ring, mask, index - 1);
+            const auto alpha = ((SampleType) 1 - frac) / ((SampleType) 1 + frac);
+            return value2 + Lanes::expand (alpha) * (value1 - previous);
+        }
+    };
+}
+
+//==============================================================================
+/**
+*/
+template <typename SampleType, typename Interpolation>
+class CrossfeedDelay
+{
+public:
+    static constexpr int numLanes = 4;
+
+    //==============================================================================
+    /** Sizes the ring for delays up to maxDelaySamples read back after blocks of up to maxBlockFrames. */
+    void prepare (int maxDelaySamples, int maxBlockFrames)
+    {
+        maxDelay = std::max (0, maxDelaySamples);
+
+        auto frames = 1;
+
+        while (frames < maxDelay + Interpolation::extraFrames + maxBlockFrames + 1)
+            frames *= 2;
+
+        mask = frames - 1;
+
+        // One spare frame so the ring can start on a register boundary.
+        storage.assign (static_cast<size_t> ((frames + 1) * numLanes), (SampleType) 0);
+
+        const auto address = reinterpret_cast<std::uintptr_t> (storage.data());
+        ring = storage.data() + (alignment - address % alignment) % alignment / sizeof (SampleType);
+
+        reset();
+    }
+
+    void reset() noexcept
+    {
+        std::fill (storage.begin(), storage.end(), (SampleType) 0);
+        std::fill (std::begin (interpolatorState), std::end (interpolatorState), (SampleType) 0);
+        writePosition = 0;
+    }
+
+    int getMaximumDelay() const noexcept     { return maxDelay; }
+
+    //==============================================================================
+    /** Appends numFrames interleaved frames (low L, low R, high L, high R) to the history. */
+    void write (const SampleType* frames, int numFrames) noexcept
+    {
+        for (int i = 0; i < numFrames; i++)
+        {
+            const auto* frame = frames + i * numLanes;
+            auto* stored = ring + ((writePosition + i) & mask) * numLanes;
+
+            stored[0] = frame[1];
+            stored[1] = frame[0];
+            stored[2] = frame[3];
+            stored[3] = frame[2];
+        }
+
+        writePosition = (writePosition + numFrames) & mask;
+    }
+
+    /** For the numFrames frames written last, reads the delayed signal of the
+        opposite channel into each lane of the interleaved crossed frames,
+        which must be aligned for Lanes.
+
+        The low lanes are read delayLow behind, the high lanes delayHigh behind;
+        each delay starts at delay + delayStep for the first frame and grows by
+        delayStep per frame. Without includeHigh the high lanes are left at zero
+        and delayHigh is ignored.
+    */
+    template <typename Lanes, bool includeHigh = true>
+    void readCrossed (SampleType delayLow, SampleType delayLowStep, SampleType delayHigh, SampleType delayHighStep,
+                      SampleType* crossed, int numFrames) noexcept
+    {
+        alignas (alignment) static constexpr SampleType lowLanes[numLanes] { 1, 1, 0, 0 };
+        alignas (alignment) static constexpr SampleType highLanes[numLanes] { 0, 0, 1, 1 };
+
+        const auto lowMask = Lanes::fromRawArray (lowLanes);
+        const auto highMask = Lanes::fromRawArray (highLanes);
+        auto previous = Lanes::fromRawArray (interpolatorState);
+        auto position = writePosition - numFrames;   // may go negative, the mask takes care of it
+
+        int lowInt = 0, highInt = 0;
+        SampleType lowFrac {}, highFrac {};
+        split (delayLow, lowInt, lowFrac);
+
+        if constexpr (includeHigh)
+            split (delayHigh, highInt, highFrac);
+
+        for (int i = 0; i < numFrames; i++, position++)
+        {
+            if (delayLowStep != (SampleType) 0)
+            {
+                delayLow += delayLowStep;
+                split (delayLow, lowInt, lowFrac);
+            }
+
+            auto output = Interpolation::interpolate (ring, mask, position - lowInt, lowFrac, previous) * lowMask;
+
+            if constexpr (includeHigh)
+            {
+                if (delayHighStep != (SampleType) 0)
+                {
+                    delayHigh += delayHighStep;
+                    split (delayHigh, highInt, highFrac);
+                }
+
+                output = output + Interpolation::interpolate (ring, mask, position - highInt, highFrac, previous) * highMask;
+                previous = output;
+            }
+            else
+            {
+                previous = output + previous * highMask;
+            }
+
+            output.copyToRawArray (crossed + i * numLanes);
+        }
+
+        previous.copyToRawArray (interpolatorState);
+    }
+
+    /** readCrossed() for both bands at zero delay, which needs no interpolation:
+        the stored frames are already in crossed order.
+    */
+    void readCrossedUndelayed (SampleType* crossed, int numFrames) noexcept
+    {
+        const auto start = (writePosition - numFrames) & mask;
+        const auto first = std::min (numFrames, mask + 1 - start);
+
+        std::copy (ring + start * numLanes, ring + (start + first) * numLanes, crossed);
+        std::copy (ring, ring + (numFrames - first) * numLanes, crossed + first * numLanes);
+
+        // An interpolator at zero delay would be left remembering the last frame.
+        if (numFrames > 0)
+            std::copy (crossed + (numFrames - 1) * numLanes, crossed + numFrames * numLanes, interpolatorState);
+    }
+
+private:
+    //==============================================================================
+    void split (SampleType delay, int& delayInt, SampleType& delayFrac) const noexcept
+    {
+        delay = std::clamp (delay, (SampleType) 0, static_cast<SampleType> (maxDelay));
+        delayInt = static_cast<int> (delay);
+        delayFrac = delay - static_cast<SampleType> (delayInt);
+        Interpolation::adjust (delayInt, delayFrac);
+    }
+
+    //==============================================================================
+    static constexpr size_t alignment = numLanes * sizeof (SampleType);
+
+    std::vector<SampleType> storage;
+    SampleType* ring = nullptr;
+    int mask = 0;
+    int maxDelay = 0;
+    int writePosition = 0;
+
+    alignas (alignment) SampleType interpolatorState[numLanes] {};
+};
@@ -0,0 +1,191 @@
+/*
+  ==============================================================================
+
+    The crossfeed in the plugin's own terms.
+
+    CrossfeedEngine puts the plugin's parameter units (gains, delays in
+    microseconds, crossover in Hz) and the usual buffer layouts in front of
+    a CrossfeedKernel. The processor runs one, and so does the C library
+    (crossfeed.h), so both give the same output for the same settings.
+
+    Prepared with a speaker layout, it also renders surround input to stereo
+    through a CrossfeedSurround, driven by the same parameters.
+
+    Like the kernel it uses nothing from JUCE.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "CrossfeedKernel.h"
+#include "CrossfeedSurround.h"
+
+//==============================================================================
+/** One complete set of parameter values, in the plugin's units (delays in microseconds). */
+struct CrossfeedParameterSnapshot
+{
+    float amplitudeLow = .75f;
+    float amplitudeHigh = .1f;
+    float delayLow = 250.f;
+    float delayHigh = 100.f;
+    float crossoverFrequency = 2000.f;
+
+    bool operator== (const CrossfeedParameterSnapshot& other) const noexcept
+    {
+        return amplitudeLow == other.amplitudeLow && amplitudeHigh == other.amplitudeHigh
+            && delayLow == other.delayLow && delayHigh == other.delayHigh
+            && crossoverFrequency == other.crossoverFrequency;
+    }
+
+    bool operator!= (const CrossfeedParameterSnapshot& other) const noexcept     { return ! operator== (other); }
+};
+
+//==============================================================================
+/**
+    A stereo or surround crossfeed driven by CrossfeedParameterSnapshots.
+
+    prepare() allocates; everything else is real-time safe and must be
+    called from one thread at a time.
+*/
+template <typename SampleType>
+class CrossfeedEngine
+{
+public:
+    /** The longest delay the plugin's parameters allow. */
+    static constexpr float defaultMaxDelayMicroseconds = 1000.f;
+
+    //==============================================================================
+    /** With speakers, one per input channel, processSurround() becomes available as well. */
+    void prepare (double newSampleRate, float maxDelayMicroseconds = defaultMaxDelayMicroseconds,
+                  const std::vector<CrossfeedSpeaker>& speakers = {})
+    {
+        sampleRate = newSampleRate;
+        kernel.prepare (sampleRate, toSeconds (maxDelayMicroseconds));
+        surround.prepare (sampleRate, toSeconds (maxDelayMicroseconds), speakers);
+    }
+
+    /** Clears the filter and delay state; parameters keep their current values. */
+    void reset() noexcept
+    {
+        kernel.reset();
+        surround.reset();
+    }
+
+    /** True if prepared with a speaker layout. */
+    bool isSurround() const noexcept                   { return surround.getNumChannels() > 0; }
+    int getNumSurroundChannels() const noexcept        { return surround.getNumChannels(); }
+
+    /** Takes effect at once for the first call after prepare(), ramped in after that. */
+    void setParameters (const CrossfeedParameterSnapshot& parameters) noexcept
+    {
+        const auto crossover = static_cast<SampleType> (parameters.crossoverFrequency);
+        const auto low = static_cast<SampleType> (sampleRate * toSeconds (parameters.delayLow));
+        const auto high = static_cast<SampleType> (sampleRate * toSeconds (parameters.delayHigh));
+        const auto amplitudeLow = static_cast<SampleType> (parameters.amplitudeLow);
+        const auto amplitudeHigh = static_cast<SampleType> (parameters.amplitudeHigh);
+
+        kernel.setParameters (crossover, low, high, amplitudeLow, amplitudeHigh);
+
+        if (isSurround())
+            surround.setParameters (crossover, low, high, amplitudeLow, amplitudeHigh);
+    }
+
+    //==============================================================================
+    /** Processes separate left and right channels in place. */
+    void process (SampleType* left, SampleType* right, int numFrames) noexcept
+    {
+        kernel.process (left, right, numFrames);
+        lastPath = kernel.getLastPath();
+        surroundLast = false;
+    }
+
+    /** Renders one input channel per speaker to left and right, which may be the first two inputs. */
+    void processSurround (const SampleType* const* inputs, SampleType* left, SampleType* right, int numFrames) noexcept
+    {
+        surround.process (inputs, left, right, numFrames);
+        lastPath = surround.getLastPath();
+        surroundLast = true;
+    }
+
+    /** Only the surround downmix, for a stereo stage that follows (HRTF mode). */
+    void downmixSurround (const SampleType* const* inputs, SampleType* left, SampleType* right, int numFrames) noexcept
+    {
+        surround.downmix (inputs, left, right, numFrames);
+        lastPath = surround.getLastPath();
+        surroundLast = true;
+    }
+
+    /** The surround downmix for a stereo stage that runs beside processSurround()
+        on the same input, as in a crossfade into or out of HRTF mode. Nothing
+        changes state; left and right may be the first two inputs.
+    */
+    template <typename OutputType>
+    void mixSurround (const SampleType* const* inputs, OutputType* left, OutputType* right, int numFrames) const noexcept
+    {
+        surround.mix (inputs, left, right, numFrames);
+    }
+
+    /** Processes interleaved stereo frames (left, right, left, ...) in place. */
+    void processInterleaved (SampleType* frames, int numFrames) noexcept
+    {
+        for (int offset = 0, length = 0; offset < numFrames; offset += length)
+        {
+            // Chunks end on the kernel's sub-block grid, so a ramp is never
+            // split where one call over the whole block would not split it.
+            const auto remaining = kernel.getSubBlockRemaining();
+            const auto subBlockSize = CrossfeedCoefficients<SampleType>::subBlockSize;
+            length = std::min (remaining + (scratchFrames - remaining) / subBlockSize * subBlockSize, numFrames - offset);
+
+            auto* block = frames + 2 * offset;
+
+            for (int i = 0; i < length; i++)
+            {
+                scratch[0][i] = block[2 * i];
+                scratch[1][i] = block[2 * i + 1];
+            }
+
+            kernel.process (scratch[0], scratch[1], length);
+            lastPath = kernel.getLastPath();
+            surroundLast = false;
+
+            for (int i = 0; i < length; i++)
+            {
+                block[2 * i] = scratch[0][i];
+                block[2 * i + 1] = scratch[1][i];
+            }
+        }
+    }
+
+    //==============================================================================
+    /** Samples for an impulse to decay below tolerance at the given crossover frequency. */
+    int getTailSamples (double crossoverFrequency, double tolerance) const
+    {
+        return isSurround() ? surround.getTailSamples (crossoverFrequency, tolerance)
+                            : kernel.getTailSamples (crossoverFrequency, tolerance);
+    }
+
+    /** True while silent input is being skipped, by whichever of the stereo
+        and surround paths processed the last block.
+    */
+    bool isIdle() const noexcept                       { return surroundLast ? surround.isIdle() : kernel.isIdle(); }
+
+    /** The most general path that ran in the last block, stereo or surround. */
+    CrossfeedPath getLastPath() const noexcept         { return lastPath; }
+
+private:
+    //==============================================================================
+    // The same float arithmetic the processor has always used, so delays land on
+    // the same fractional sample positions.
+    static double toSeconds (float microseconds) noexcept     { return microseconds / 1000.f / 1000.f; }
+
+    // Interleaved blocks are split through here, a chunk at a time.
+    static constexpr int scratchFrames = 256;
+
+    CrossfeedKernel<SampleType> kernel;
+    CrossfeedSurround<SampleType> surround;
+    CrossfeedPath lastPath = CrossfeedPath::general;
+    bool surroundLast = false;
+    double sampleRate = 44100.0;
+    SampleType scratch[2][scratchFrames];
+};
@@ -0,0 +1,340 @@
+/*
+  ==============================================================================
+
+    Fused stereo crossfeed kernel.
+
+    The band split, cross-delay, mixing and band sum are done together for each
+    sub-block, with all intermediate frames kept on the stack. The four signal
+    paths are kept side by side in one register as lanes (low L, low R, high L,
+    high R), so both channels and both bands are filtered and mixed with the
+    same vector instructions, each lane with its own filter state. Parameter
+    changes arrive as smoothed ramps from CrossfeedCoefficients, one sub-block
+    at a time.
+
+    Sub-blocks are laid on a fixed grid over the stream rather than over each
+    host block: a segment always covers subBlockSize samples, and when the host
+    block ends part-way through one the rest of it is rendered at the start of
+    the next call. Tiny host blocks therefore share one set of coefficients and
+    ramps instead of each paying for its own, and parameter changes take effect
+    at the next sub-block boundary whatever the host's block size.
+
+    Each sub-block runs through the path the coefficient engine picked for it
+    (see CrossfeedPath), a separate instantiation of the frame loop with the
+    unused work compiled out. Parameter ramps always take the general path,
+    so any change into or out of a shortcut is crossfaded by the gain ramps.
+    Bypass leaves the band split and delay line unfed; they are cleared on the
+    way out and the cross signal fades in from silence.
+
+    The kernel is templated on the sample type, so the float and double
+    processing paths share one implementation. With four lanes in a register
+    the vector path needs 128-bit registers for float and 256-bit ones for
+    double; otherwise the scalar lanes are used (see CrossfeedSIMD.h).
+
+    Like the coefficient engine and the delay line, the kernel uses nothing
+    from JUCE, so it can be built into the C library as well as the plugin.
+
+    Once the input has been silent for longer than the filters and delays take
+    to ring out, the kernel clears its state and goes idle, leaving silent
+    blocks untouched until signal returns.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <limits>
+#include "CrossfeedCoefficients.h"
+#include "CrossfeedDelay.h"
+#include "CrossfeedSIMD.h"
+
+//==============================================================================
+/**
+    The sample type (float or double) and the interpolation used for the
+    fractional cross delay are chosen at compile time, see
+    CrossfeedInterpolationTypes.
+*/
+template <typename SampleType = float, typename Interpolation = CrossfeedInterpolationTypes::Linear>
+class CrossfeedKernel
+{
+public:
+    // Lane layout used for filter state, coefficients and the delay ring.
+    enum Lane { lowLeft = 0, lowRight, highLeft, highRight, numLanes };
+
+    using SIMDLanes = typename CrossfeedLanes<SampleType>::Type;
+    using ScalarLanes = CrossfeedScalarLanes<SampleType>;
+    static constexpr bool canUseSIMD = CrossfeedLanes<SampleType>::isVector;
+
+    /** Input below this level (about -160 dBFS) counts as silence. */
+    static constexpr SampleType silenceThreshold = (SampleType) 1.0e-8;
+
+    //==============================================================================
+    /** Prepares for delays of up to maxDelaySeconds; this is what sizes the delay ring. */
+    void prepare (double newSampleRate, double maxDelaySeconds = 0.001)
+    {
+        sampleRate = newSampleRate;
+
+        maxDelaySamples = static_cast<int> (std::ceil (sampleRate * maxDelaySeconds));
+        delay.prepare (maxDelaySamples, Coefficients::subBlockSize);
+
+        coefficients.prepare (sampleRate);
+        reset();
+    }
+
+    void reset() noexcept
+    {
+        clearState();
+        segmentRemaining = 0;
+
+        silentSamples = 0;
+        idle = false;
+        bypassed = false;
+    }
+
+    /** Samples for the response to an impulse to decay below tolerance, for a
+        given crossover frequency: filter settling plus the longest delay.
+    */
+    int getTailSamples (double crossoverFrequency, double tolerance) const
+    {
+        return Coefficients::getSettlingSamples (sampleRate, crossoverFrequency, tolerance)
+             + maxDelaySamples + Interpolation::extraFrames;
+    }
+
+    /** True while silent input is being skipped. */
+    bool isIdle() const noexcept     { return idle; }
+
+    /** The most general path that ran in the last block. */
+    CrossfeedPath getLastPath() const noexcept     { return lastPath; }
+
+    /** Samples left in the current sub-block; 0 when the next block starts a new one. */
+    int getSubBlockRemaining() const noexcept      { return segmentRemaining; }
+
+    //==============================================================================
+    /** Sets the parameter targets; delays are given in samples and may be fractional.
+
+        The first call after prepare() takes effect immediately, later calls are
+        ramped in by the coefficient engine.
+    */
+    void setParameters (SampleType crossoverFrequency, SampleType lowDelaySamples, SampleType highDelaySamples,
+                        SampleType lowAmplitude, SampleType highAmplitude) noexcept
+    {
+        const auto maxDelay = static_cast<SampleType> (maxDelaySamples);
+
+        coefficients.setTargets (crossoverFrequency,
+                                 std::clamp (lowDelaySamples, (SampleType) 0, maxDelay),
+                                 std::clamp (highDelaySamples, (SampleType) 0, maxDelay),
+                                 lowAmplitude, highAmplitude);
+    }
+
+    //==============================================================================
+    /** Processes a stereo block in place, using SIMD registers where the platform has four lanes of SampleType. */
+    void process (SampleType* left, SampleType* right, int numSamples) noexcept
+    {
+        if constexpr (canUseSIMD)
+            processBlock<SIMDLanes> (left, right, numSamples);
+        else
+            processBlock<ScalarLanes> (left, right, numSamples);
+    }
+
+    /** Reference implementation; bit-compatible with process(). */
+    void processScalar (SampleType* left, SampleType* right, int numSamples) noexcept
+    {
+        processBlock<ScalarLanes> (left, right, numSamples);
+    }
+
+private:
+    //==============================================================================
+    using Coefficients = CrossfeedCoefficients<SampleType>;
+    static constexpr size_t alignment = numLanes * sizeof (SampleType);
+
+    //==============================================================================
+    template <typename Lanes>
+    void processBlock (SampleType* left, SampleType* right, int numSamples) noexcept
+    {
+        if (! isSilent (left, numSamples) || ! isSilent (right, numSamples))
+        {
+            silentSamples = 0;
+            idle = false;
+        }
+        else if (idle)
+        {
+            // Nothing is ringing, so parameter changes need no ramp either.
+            coefficients.settle();
+            segmentRemaining = 0;
+            lastPath = CrossfeedPath::idle;
+            return;
+        }
+        else
+        {
+            silentSamples = std::min (silentSamples + numSamples, std::numeric_limits<int>::max() / 2);
+        }
+
+        processSubBlocks<Lanes> (left, right, numSamples);
+
+        if (silentSamples > 0 && silentSamples >= getTailSamples (coefficients.getTargetCrossoverFrequency(), silenceThreshold))
+        {
+            // Everything left in the filters and the delay ring is below the
+            // threshold; clearing it now lets signal resume from a clean state.
+            clearState();
+            idle = true;
+        }
+    }
+
+    void clearState() noexcept
+    {
+        delay.reset();
+        std::fill (std::begin (filterState), std::end (filterState), (SampleType) 0);
+    }
+
+    static bool isSilent (const SampleType* data, int numSamples) noexcept
+    {
+        // Signal usually shows up in the first sample, so this rarely scans the block.
+        for (int i = 0; i < numSamples; i++)
+            if (! (std::abs (data[i]) < silenceThreshold))
+                return false;
+
+        return true;
+    }
+
+    template <typename Lanes>
+    void processSubBlocks (SampleType* left, SampleType* right, int numSamples) noexcept
+    {
+        lastPath = CrossfeedPath::bypass;
+
+        for (int offset = 0, length = 0; offset < numSamples; offset += length)
+        {
+            if (segmentRemaining == 0)
+            {
+                coefficients.next (Coefficients::subBlockSize, segment);
+                segmentRemaining = Coefficients::subBlockSize;
+            }
+
+            length = std::min (segmentRemaining, numSamples - offset);
+            segmentRemaining -= length;
+
+            if (segment.path == CrossfeedPath::bypass)
+            {
+                bypassed = true;
+                continue;
+            }
+
+            if (bypassed)
+            {
+                // The shortcut left the state behind; start from silence instead.
+                clearState();
+                bypassed = false;
+            }
+
+            lastPath = std::max (lastPath, segment.path);
+
+            auto* l = left + offset;
+            auto* r = right + offset;
+
+            switch (segment.path)
+            {
+                case CrossfeedPath::noDelay:            processFrames<Lanes, false, CrossfeedPath::noDelay> (l, r, length); break;
+                case CrossfeedPath::noHighCrossfeed:    processFrames<Lanes, false, CrossfeedPath::noHighCrossfeed> (l, r, length); break;
+                case CrossfeedPath::idle:
+                case CrossfeedPath::bypass:
+                case CrossfeedPath::general:
+                case CrossfeedPath::convolution:
+                case CrossfeedPath::numPaths:
+                    if (segment.ramping)
+                        processFrames<Lanes, true, CrossfeedPath::general> (l, r, length);
+                    else
+                        processFrames<Lanes, false, CrossfeedPath::general> (l, r, length);
+                    break;
+            }
+
+            // The host block ended inside the segment; the next call carries on from here.
+            if (segment.ramping && segmentRemaining > 0)
+                segment.skip (length);
+        }
+    }
+
+    template <typename Lanes, bool ramping, CrossfeedPath path>
+    void processFrames (SampleType* left, SampleType* right, int numSamples) noexcept
+    {
+        alignas (alignment) SampleType filtered[Coefficients::subBlockSize * numLanes];
+        alignas (alignment) SampleType crossed[Coefficients::subBlockSize * numLanes];
+        alignas (alignment) SampleType frame[numLanes];
+
+        // Band split: transposed direct form II, first order, one state per lane.
+        {
+            const auto b0 = Lanes::fromRawArray (segment.b0);
+            const auto b1 = Lanes::fromRawArray (segment.b1);
+            const auto a1 = Lanes::fromRawArray (segment.a1);
+            auto state = Lanes::fromRawArray (filterState);
+
+            for (int i = 0; i < numSamples; i++)
+            {
+                frame[lowLeft] = frame[highLeft] = left[i];
+                frame[lowRight] = frame[highRight] = right[i];
+
+                const auto x = Lanes::fromRawArray (frame);
+                const auto y = b0 * x + state;
+                state = b1 * x - a1 * y;
+                y.copyToRawArray (filtered + i * numLanes);
+            }
+
+            state.copyToRawArray (filterState);
+        }
+
+        // Cross delay: each output lane takes the delayed signal of the opposite channel in its band.
+        // The shortcuts still feed the delay line, so the general path can pick up where they left off.
+        delay.write (filtered, numSamples);
+
+        if constexpr (path == CrossfeedPath::noDelay)
+        {
+            delay.readCrossedUndelayed (crossed, numSamples);
+        }
+        else
+        {
+            // Zeros are cheaper than interpolating a signal that gets no gain.
+            constexpr bool includeHigh = path != CrossfeedPath::noHighCrossfeed;
+
+            delay.template readCrossed<Lanes, includeHigh> (segment.delayLow, ramping ? segment.delayLowStep : SampleType(),
+                                                            segment.delayHigh, ramping ? segment.delayHighStep : SampleType(),
+                                                            crossed, numSamples);
+        }
+
+        // Mix and band sum.
+        {
+            const auto one = Lanes::expand ((SampleType) 1);
+            const auto wetStep = Lanes::fromRawArray (segment.wetStep);
+            auto wetGain = Lanes::fromRawArray (segment.wet);
+            auto dryGain = one - wetGain;
+
+            for (int i = 0; i < numSamples; i++)
+            {
+                if (ramping)
+                {
+                    wetGain = wetGain + wetStep;
+                    dryGain = one - wetGain;
+                }
+
+                const auto out = Lanes::fromRawArray (filtered + i * numLanes) * dryGain
+                               + Lanes::fromRawArray (crossed + i * numLanes) * wetGain;
+                out.copyToRawArray (frame);
+
+                left[i]  = frame[lowLeft]  + frame[highLeft];
+                right[i] = frame[lowRight] + frame[highRight];
+            }
+        }
+    }
+
+    //==============================================================================
+    double sampleRate = 44100.0;
+    int maxDelaySamples = 0;
+
+    Coefficients coefficients;
+    CrossfeedSegment<SampleType> segment;
+    int segmentRemaining = 0;
+    CrossfeedDelay<SampleType, Interpolation> delay;
+
+    alignas (alignment) SampleType filterState[numLanes] {};
+
+    int silentSamples = 0;
+    bool idle = false;
+    bool bypassed = false;
+    CrossfeedPath lastPath = CrossfeedPath::general;
+};
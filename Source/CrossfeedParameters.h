@@ -0,0 +1,137 @@
+/*
+  ==============================================================================
+
+    Parameter snapshots for the audio thread.
+
+    The processor's parameters can change from the message thread (editor,
+    preset loads) and from whatever thread the host automates on. The audio
+    thread does not read them one by one; it takes one coherent snapshot per
+    block from a CrossfeedParameterStore.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include "CrossfeedEngine.h"
+
+//==============================================================================
+/**
+    Hands parameter snapshots from any number of writers to one reader.
+
+    The values sit behind a sequence lock that neither side ever waits on, so
+    a host may publish from its audio thread as well. Writers mark themselves
+    active while they store, and count a version when done. The reader takes
+    the values only when no write is in progress and none finished while it
+    was reading; otherwise it keeps the previous complete snapshot, so a
+    preset is seen either entirely or not at all.
+
+    Publishing one value touches only that value, so a single parameter moved
+    during a preset load ends up at one of the two settings. Whole snapshots
+    published from two threads at once are not ordered against each other;
+    the processor only publishes them from the message thread.
+
+    Nothing here depends on JUCE.
+*/
+class CrossfeedParameterStore
+{
+public:
+    //==============================================================================
+    /** Publishes a complete set of values at once. */
+    void publish (const CrossfeedParameterSnapshot& snapshot) noexcept
+    {
+        beginWrite();
+
+        shared.amplitudeLow.store (snapshot.amplitudeLow, std::memory_order_relaxed);
+        shared.amplitudeHigh.store (snapshot.amplitudeHigh, std::memory_order_relaxed);
+        shared.delayLow.store (snapshot.delayLow, std::memory_order_relaxed);
+        shared.delayHigh.store (snapshot.delayHigh, std::memory_order_relaxed);
+        shared.crossoverFrequency.store (snapshot.crossoverFrequency, std::memory_order_relaxed);
+
+        endWrite();
+    }
+
+    /** Changes one value, keeping the others as last published. */
+    void publish (float CrossfeedParameterSnapshot::* member, float value) noexcept
+    {
+        beginWrite();
+        (shared.*getShared (member)).store (value, std::memory_order_relaxed);
+        endWrite();
+    }
+
+    //==============================================================================
+    /** The latest complete snapshot. Only one thread may read. */
+    CrossfeedParameterSnapshot read() noexcept
+    {
+        const auto version = shared.version.load (std::memory_order_acquire);
+
+        // A write in progress, or nothing new; keep what we have until the next call.
+        if (version == readVersion || shared.activeWriters.load (std::memory_order_acquire) != 0)
+            return lastRead;
+
+        CrossfeedParameterSnapshot snapshot;
+        snapshot.amplitudeLow = shared.amplitudeLow.load (std::memory_order_relaxed);
+        snapshot.amplitudeHigh = shared.amplitudeHigh.load (std::memory_order_relaxed);
+        snapshot.delayLow = shared.delayLow.load (std::memory_order_relaxed);
+        snapshot.delayHigh = shared.delayHigh.load (std::memory_order_relaxed);
+        snapshot.crossoverFrequency = shared.crossoverFrequency.load (std::memory_order_relaxed);
+
+        std::atomic_thread_fence (std::memory_order_acquire);
+
+        // Any value stored since the first check shows up here as an active
+        // writer, or as a write finished since, which moved the version on.
+        if (shared.activeWriters.load (std::memory_order_acquire) != 0
+             || shared.version.load (std::memory_order_relaxed) != version)
+            return lastRead;
+
+        readVersion = version;
+        lastRead = snapshot;
+        return lastRead;
+    }
+
+    /** What the last read() returned; for the reader's thread, or once it has stopped. */
+    const CrossfeedParameterSnapshot& getLastRead() const noexcept     { return lastRead; }
+
+private:
+    //==============================================================================
+    struct Shared
+    {
+        std::atomic<std::uint32_t> activeWriters { 0 }, version { 0 };
+        std::atomic<float> amplitudeLow { 0.f }, amplitudeHigh { 0.f };
+        std::atomic<float> delayLow { 0.f }, delayHigh { 0.f };
+        std::atomic<float> crossoverFrequency { 0.f };
+    };
+
+    static std::atomic<float> Shared::* getShared (float CrossfeedParameterSnapshot::* member) noexcept
+    {
+        if (member == &CrossfeedParameterSnapshot::amplitudeLow)    return &Shared::amplitudeLow;
+        if (member == &CrossfeedParameterSnapshot::amplitudeHigh)   return &Shared::amplitudeHigh;
+        if (member == &CrossfeedParameterSnapshot::delayLow)        return &Shared::delayLow;
+        if (member == &CrossfeedParameterSnapshot::delayHigh)       return &Shared::delayHigh;
+
+        return &Shared::crossoverFrequency;
+    }
+
+    void beginWrite() noexcept
+    {
+        shared.activeWriters.fetch_add (1, std::memory_order_relaxed);
+
+        // Keeps the value stores below from becoming visible before the mark.
+        std::atomic_thread_fence (std::memory_order_release);
+    }
+
+    void endWrite() noexcept
+    {
+        shared.version.fetch_add (1, std::memory_order_release);
+        shared.activeWriters.fetch_sub (1, std::memory_order_release);
+    }
+
+    //==============================================================================
+    Shared shared;
+
+    // Reader side.
+    std::uint32_t readVersion = 0;
+    CrossfeedParameterSnapshot lastRead;
+};
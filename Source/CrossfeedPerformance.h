@@ -0,0 +1,243 @@
+/*
+  ==============================================================================
+
+    Real-time performance instrumentation.
+
+    The audio thread times every block and publishes the timing through a
+    lock-free single-producer/single-consumer queue. Whoever reads the queue
+    (the editor, the offline renderer) aggregates the figures into
+    CrossfeedPerformanceStats, so the audio thread only pays for two clock
+    reads and one queue push per block. Each block also records which kernel
+    path processed it.
+
+    Hosts running tiny blocks would pay that push (and the load measurer's
+    lock) every few samples, so consecutive blocks shorter than a kernel
+    sub-block are added up and published as one.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "CrossfeedCoefficients.h"
+
+//==============================================================================
+/**
+    Wait-free queue for one producer thread and one consumer thread, built on
+    juce::AbstractFifo. Pushes that find the queue full are dropped.
+*/
+template <typename Type, int capacity>
+class CrossfeedSPSCQueue
+{
+public:
+    bool push (const Type& item) noexcept
+    {
+        const auto scope = fifo.write (1);
+
+        if (scope.blockSize1 == 0)
+            return false;
+
+        items[static_cast<size_t> (scope.startIndex1)] = item;
+        return true;
+    }
+
+    int pop (Type* destination, int maxItems) noexcept
+    {
+        const auto scope = fifo.read (maxItems);
+        scope.forEach ([&] (int index) { *destination++ = items[static_cast<size_t> (index)]; });
+        return scope.blockSize1 + scope.blockSize2;
+    }
+
+private:
+    juce::AbstractFifo fifo { capacity };
+    std::array<Type, capacity> items {};
+};
+
+//==============================================================================
+/**
+*/
+class CrossfeedPerformanceMonitor
+{
+public:
+    /** Timing of one processBlock call, or of a run of consecutive short ones. */
+    struct Block
+    {
+        double seconds = 0.0;       // time spent processing
+        double deadline = 0.0;      // audio duration of the block
+        CrossfeedPath path = CrossfeedPath::general;
+    };
+
+    //==============================================================================
+    void prepare (double newSampleRate, int maximumBlockSize)
+    {
+        sampleRate = newSampleRate;
+        loadMeasurer.reset (sampleRate, juce::jmax (maximumBlockSize, minimumBlockSamples));
+
+        pendingTicks = 0;
+        pendingSamples = 0;
+        pendingPath = CrossfeedPath::idle;
+    }
+
+    /** Times the enclosing scope as one block of numSamples. */
+    class ScopedBlock
+    {
+    public:
+        ScopedBlock (CrossfeedPerformanceMonitor& m, int samples) noexcept
+            : monitor (m), numSamples (samples), start (juce::Time::getHighResolutionTicks())
+        {
+        }
+
+        ~ScopedBlock()
+        {
+            monitor.record (juce::Time::getHighResolutionTicks() - start, numSamples, path);
+        }
+
+        /** Records which kernel path ran, once it is known. */
+        void setPath (CrossfeedPath newPath) noexcept     { path = newPath; }
+
+    private:
+        CrossfeedPerformanceMonitor& monitor;
+        int numSamples;
+        juce::int64 start;
+        CrossfeedPath path = CrossfeedPath::general;
+
+        JUCE_DECLARE_NON_COPYABLE (ScopedBlock)
+    };
+
+    //==============================================================================
+    /** Consumer side: takes up to maxBlocks timings off the queue. */
+    int popBlocks (Block* destination, int maxBlocks) noexcept     { return queue.pop (destination, maxBlocks); }
+
+    /** Smoothed load relative to the block deadline, from any thread. */
+    double getLoad() const                                          { return loadMeasurer.getLoadAsProportion(); }
+    int getXRunCount() const                                        { return loadMeasurer.getXRunCount(); }
+
+private:
+    //==============================================================================
+    void record (juce::int64 ticks, int numSamples, CrossfeedPath path) noexcept
+    {
+        if (numSamples <= 0)
+            return;
+
+        pendingTicks += ticks;
+        pendingSamples += numSamples;
+        pendingPath = juce::jmax (pendingPath, path);
+
+        if (pendingSamples < minimumBlockSamples)
+            return;
+
+        Block block;
+        block.seconds = juce::Time::highResolutionTicksToSeconds (pendingTicks);
+        block.deadline = pendingSamples / sampleRate;
+        block.path = pendingPath;
+
+        loadMeasurer.registerRenderTime (block.seconds * 1000.0, pendingSamples);
+        queue.push (block);
+
+        pendingTicks = 0;
+        pendingSamples = 0;
+        pendingPath = CrossfeedPath::idle;
+    }
+
+    static constexpr int minimumBlockSamples = CrossfeedCoefficients<float>::subBlockSize;
+
+    double sampleRate = 44100.0;
+    juce::AudioProcessLoadMeasurer loadMeasurer;
+    CrossfeedSPSCQueue<Block, 1024> queue;
+
+    // Short blocks not yet published, audio thread only.
+    juce::int64 pendingTicks = 0;
+    int pendingSamples = 0;
+    CrossfeedPath pendingPath = CrossfeedPath::idle;
+};
+
+//==============================================================================
+/** Aggregated block timings, kept by the consumer of a CrossfeedPerformanceMonitor. */
+struct CrossfeedPerformanceStats
+{
+    // Load histogram in 10% steps up to 200%; the last bin takes everything above.
+    static constexpr int numBins = 21;
+
+    void add (const CrossfeedPerformanceMonitor::Block& block) noexcept
+    {
+        const auto load = block.deadline > 0.0 ? block.seconds / block.deadline : 0.0;
+
+        blocks++;
+        totalSeconds += block.seconds;
+        totalDeadline += block.deadline;
+        lastLoad = load;
+        worstLoad = juce::jmax (worstLoad, load);
+
+        if (load > 1.0)
+            overruns++;
+
+        histogram[static_cast<size_t> (juce::jlimit (0, numBins - 1, static_cast<int> (load * 10.0)))]++;
+
+        const auto path = static_cast<size_t> (block.path);
+        lastPath = block.path;
+        pathBlocks[path]++;
+        pathSeconds[path] += block.seconds;
+        pathDeadline[path] += block.deadline;
+    }
+
+    /** Drains everything the monitor has queued. */
+    void addAll (CrossfeedPerformanceMonitor& monitor) noexcept
+    {
+        CrossfeedPerformanceMonitor::Block buffer[64];
+
+        for (;;)
+        {
+            const auto n = monitor.popBlocks (buffer, 64);
+
+            if (n == 0)
+                break;
+
+            for (int i = 0; i < n; i++)
+                add (buffer[i]);
+        }
+    }
+
+    double getAverageLoad() const noexcept     { return totalDeadline > 0.0 ? totalSeconds / totalDeadline : 0.0; }
+
+    juce::String toString() const
+    {
+        juce::String text;
+        text << "blocks " << blocks << ", average load " << juce::String (getAverageLoad() * 100.0, 2)
+             << "%, worst " << juce::String (worstLoad * 100.0, 2) << "%, overruns " << overruns << "\n";
+
+        for (int bin = 0; bin < numBins; bin++)
+        {
+            if (histogram[static_cast<size_t> (bin)] == 0)
+                continue;
+
+            text << (bin < numBins - 1 ? juce::String (bin * 10).paddedLeft (' ', 3) + "-" + juce::String (bin * 10 + 10).paddedLeft (' ', 3) + "%"
+                                       : juce::String (">200%").paddedLeft (' ', 8))
+                 << "  " << histogram[static_cast<size_t> (bin)] << "\n";
+        }
+
+        for (size_t path = 0; path < numPaths; path++)
+        {
+            if (pathBlocks[path] == 0)
+                continue;
+
+            text << juce::String (getCrossfeedPathName (static_cast<CrossfeedPath> (path))).paddedLeft (' ', 17)
+                 << "  " << pathBlocks[path] << " blocks, load "
+                 << juce::String (pathDeadline[path] > 0.0 ? pathSeconds[path] / pathDeadline[path] * 100.0 : 0.0, 2) << "%\n";
+        }
+
+        return text;
+    }
+
+    static constexpr size_t numPaths = static_cast<size_t> (CrossfeedPath::numPaths);
+
+    juce::int64 blocks = 0, overruns = 0;
+    double totalSeconds = 0.0, totalDeadline = 0.0;
+    double lastLoad = 0.0, worstLoad = 0.0;
+    std::array<juce::int64, numBins> histogram {};
+
+    // Blocks and load per kernel path.
+    CrossfeedPath lastPath = CrossfeedPath::general;
+    std::array<juce::int64, numPaths> pathBlocks {};
+    std::array<double, numPaths> pathSeconds {}, pathDeadline {};
+};
@@ -0,0 +1,127 @@
+/*
+  ==============================================================================
+
+    Frequency response of the two-band model.
+
+    With its parameters held still, the crossfeed is a linear filter from
+    each input channel to both ears. The same ear hears its own side through
+    the band split with the dry gains; the opposite ear hears it through the
+    same filters with the wet gains, each band delayed by its cross delay.
+    CrossfeedResponse evaluates both transfer functions in closed form, with
+    the coefficients CrossfeedCoefficients designs, so it costs a few complex
+    multiplies per frequency and needs no impulse response or FFT.
+
+    Parameter ramps and the fractional delay's interpolation error are not
+    modelled; the delays are taken as exact.
+
+    Like the kernel it uses nothing from JUCE.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <vector>
+#include "CrossfeedEngine.h"
+
+//==============================================================================
+/**
+    Steady-state magnitude and group delay of the crossfeed at a set of
+    frequencies, for one channel into the same-side and the opposite-side ear.
+*/
+struct CrossfeedResponse
+{
+    std::vector<float> frequencies;         // Hz
+    std::vector<float> ipsilateralGain;     // same side, dB
+    std::vector<float> contralateralGain;   // opposite side, dB
+    std::vector<float> ipsilateralDelay;    // group delays, microseconds
+    std::vector<float> contralateralDelay;
+
+    /** Gains below this come out as this, including for a path with no gain at all. */
+    static constexpr float minusInfinityDecibels = -100.f;
+
+    //==============================================================================
+    /** numPoints frequencies spaced logarithmically from minFrequency to
+        maxFrequency, which should stay below half the sample rate.
+    */
+    static CrossfeedResponse compute (const CrossfeedParameterSnapshot& parameters, double sampleRate,
+                                      int numPoints, double minFrequency, double maxFrequency)
+    {
+        CrossfeedResponse response;
+        response.resize (std::max (numPoints, 2));
+
+        const auto last = static_cast<double> (response.frequencies.size() - 1);
+
+        for (size_t i = 0; i < response.frequencies.size(); i++)
+        {
+            const auto frequency = minFrequency * std::pow (maxFrequency / minFrequency, static_cast<double> (i) / last);
+            response.frequencies[i] = static_cast<float> (frequency);
+            response.evaluate (i, parameters, sampleRate, frequency);
+        }
+
+        return response;
+    }
+
+private:
+    //==============================================================================
+    using Complex = std::complex<double>;
+
+    void resize (int numPoints)
+    {
+        for (auto* v : { &frequencies, &ipsilateralGain, &contralateralGain, &ipsilateralDelay, &contralateralDelay })
+            v->resize (static_cast<size_t> (numPoints));
+    }
+
+    void evaluate (size_t index, const CrossfeedParameterSnapshot& parameters, double sampleRate, double frequency)
+    {
+        // The bilinear first-order pair from CrossfeedCoefficients::designFilters.
+        const auto crossover = CrossfeedCoefficients<double>::limitCrossoverFrequency (sampleRate, parameters.crossoverFrequency);
+        const auto n = std::tan (CrossfeedCoefficients<double>::pi * crossover / sampleRate);
+        const auto a1 = (n - 1.0) / (n + 1.0);
+        const auto lowB0 = n / (n + 1.0), lowB1 = lowB0;
+        const auto highB0 = 1.0 / (n + 1.0), highB1 = -highB0;
+
+        const auto omega = 2.0 * CrossfeedCoefficients<double>::pi * frequency / sampleRate;
+        const auto z1 = std::polar (1.0, -omega);                   // z^-1
+        const auto dz1 = Complex (0.0, -1.0) * z1;                  // d(z^-1)/d(omega)
+        const auto denominator = 1.0 + a1 * z1;
+
+        // H(omega) = (b0 + b1 z^-1) / (1 + a1 z^-1) and its derivative with respect to omega.
+        const auto low = (lowB0 + lowB1 * z1) / denominator;
+        const auto high = (highB0 + highB1 * z1) / denominator;
+        const auto lowSlope = (lowB1 - lowB0 * a1) * dz1 / (denominator * denominator);
+        const auto highSlope = (highB1 - highB0 * a1) * dz1 / (denominator * denominator);
+
+        const auto microsecondsPerSample = 1.0e6 / sampleRate;
+
+        // Same side: dry gains, no delay.
+        const auto dryLow = 1.0 - static_cast<double> (parameters.amplitudeLow);
+        const auto dryHigh = 1.0 - static_cast<double> (parameters.amplitudeHigh);
+
+        store (dryLow * low + dryHigh * high, dryLow * lowSlope + dryHigh * highSlope,
+               microsecondsPerSample, ipsilateralGain[index], ipsilateralDelay[index]);
+
+        // Opposite side: wet gains, each band delayed by exp (-j omega d).
+        const auto delayLow = static_cast<double> (parameters.delayLow) / microsecondsPerSample;
+        const auto delayHigh = static_cast<double> (parameters.delayHigh) / microsecondsPerSample;
+        const auto shiftLow = std::polar (static_cast<double> (parameters.amplitudeLow), -omega * delayLow);
+        const auto shiftHigh = std::polar (static_cast<double> (parameters.amplitudeHigh), -omega * delayHigh);
+
+        store (shiftLow * low + shiftHigh * high,
+               shiftLow * (lowSlope - Complex (0.0, delayLow) * low) + shiftHigh * (highSlope - Complex (0.0, delayHigh) * high),
+               microsecondsPerSample, contralateralGain[index], contralateralDelay[index]);
+    }
+
+    static void store (Complex h, Complex slope, double microsecondsPerSample, float& gain, float& delay)
+    {
+        const auto magnitude = std::abs (h);
+
+        gain = std::max (minusInfinityDecibels, static_cast<float> (20.0 * std::log10 (std::max (magnitude, 1.0e-10))));
+
+        // Group delay -d(arg H)/d(omega) = -Im (H'/H), in samples; undefined where the path is silent.
+        delay = magnitude > 1.0e-10 ? static_cast<float> (-(slope / h).imag() * microsecondsPerSample) : 0.f;
+    }
+};
@@ -0,0 +1,149 @@
+/*
+  ==============================================================================
+
+    Four-lane registers for the crossfeed kernel.
+
+    The kernel keeps its four signal paths side by side in one register. The
+    types here give it that register without depending on JUCE, so the DSP
+    core builds on its own (see crossfeed.h): SSE for float on x86, NEON for
+    float on ARM, AVX for double where the compiler has it enabled, and plain
+    scalar lanes everywhere else.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <cstddef>
+
+#if defined (__SSE2__) || defined (_M_X64) || (defined (_M_IX86_FP) && _M_IX86_FP >= 2)
+ #include <immintrin.h>
+ #define CROSSFEED_SSE 1
+#elif defined (__ARM_NEON) || defined (__ARM_NEON__) || defined (_M_ARM64)
+ #include <arm_neon.h>
+ #define CROSSFEED_NEON 1
+#endif
+
+//==============================================================================
+/**
+    Plain scalar stand-in for a four-lane register.
+
+    It exposes the same operations the kernel uses and evaluates them lane by
+    lane in the same order, so the scalar path produces bit-identical results
+    to the vector path (as long as the compiler is not allowed to contract
+    multiply-adds into FMAs).
+*/
+template <typename SampleType>
+struct CrossfeedScalarLanes
+{
+    SampleType value[4];
+
+    static CrossfeedScalarLanes fromRawArray (const SampleType* a) noexcept     { return {{ a[0], a[1], a[2], a[3] }}; }
+    static CrossfeedScalarLanes fromUnalignedRawArray (const SampleType* a) noexcept    { return fromRawArray (a); }
+    static CrossfeedScalarLanes expand (SampleType s) noexcept                  { return {{ s, s, s, s }}; }
+    void copyToRawArray (SampleType* a) const noexcept                          { for (int i = 0; i < 4; i++) a[i] = value[i]; }
+
+    friend CrossfeedScalarLanes operator+ (CrossfeedScalarLanes a, CrossfeedScalarLanes b) noexcept
+    {
+        return {{ a.value[0] + b.value[0], a.value[1] + b.value[1], a.value[2] + b.value[2], a.value[3] + b.value[3] }};
+    }
+
+    friend CrossfeedScalarLanes operator- (CrossfeedScalarLanes a, CrossfeedScalarLanes b) noexcept
+    {
+        return {{ a.value[0] - b.value[0], a.value[1] - b.value[1], a.value[2] - b.value[2], a.value[3] - b.value[3] }};
+    }
+
+    friend CrossfeedScalarLanes operator* (CrossfeedScalarLanes a, CrossfeedScalarLanes b) noexcept
+    {
+        return {{ a.value[0] * b.value[0], a.value[1] * b.value[1], a.value[2] * b.value[2], a.value[3] * b.value[3] }};
+    }
+};
+
+//==============================================================================
+/**
+    One native register of four SampleType lanes, in the style of
+    juce::dsp::SIMDRegister. Loads and stores need arrays aligned to the
+    register size, except for fromUnalignedRawArray().
+*/
+template <typename SampleType>
+struct CrossfeedVectorLanes;
+
+#if CROSSFEED_SSE
+template <>
+struct CrossfeedVectorLanes<float>
+{
+    __m128 value;
+
+    static CrossfeedVectorLanes fromRawArray (const float* a) noexcept      { return { _mm_load_ps (a) }; }
+    static CrossfeedVectorLanes fromUnalignedRawArray (const float* a) noexcept     { return { _mm_loadu_ps (a) }; }
+    static CrossfeedVectorLanes expand (float s) noexcept                   { return { _mm_set1_ps (s) }; }
+    void copyToRawArray (float* a) const noexcept                           { _mm_store_ps (a, value); }
+
+    friend CrossfeedVectorLanes operator+ (CrossfeedVectorLanes a, CrossfeedVectorLanes b) noexcept    { return { _mm_add_ps (a.value, b.value) }; }
+    friend CrossfeedVectorLanes operator- (CrossfeedVectorLanes a, CrossfeedVectorLanes b) noexcept    { return { _mm_sub_ps (a.value, b.value) }; }
+    friend CrossfeedVectorLanes operator* (CrossfeedVectorLanes a, CrossfeedVectorLanes b) noexcept    { return { _mm_mul_ps (a.value, b.value) }; }
+};
+#endif
+
+#if CROSSFEED_SSE && defined (__AVX__)
+template <>
+struct CrossfeedVectorLanes<double>
+{
+    __m256d value;
+
+    static CrossfeedVectorLanes fromRawArray (const double* a) noexcept     { return { _mm256_load_pd (a) }; }
+    static CrossfeedVectorLanes fromUnalignedRawArray (const double* a) noexcept    { return { _mm256_loadu_pd (a) }; }
+    static CrossfeedVectorLanes expand (double s) noexcept                  { return { _mm256_set1_pd (s) }; }
+    void copyToRawArray (double* a) const noexcept                          { _mm256_store_pd (a, value); }
+
+    friend CrossfeedVectorLanes operator+ (CrossfeedVectorLanes a, CrossfeedVectorLanes b) noexcept    { return { _mm256_add_pd (a.value, b.value) }; }
+    friend CrossfeedVectorLanes operator- (CrossfeedVectorLanes a, CrossfeedVectorLanes b) noexcept    { return { _mm256_sub_pd (a.value, b.value) }; }
+    friend CrossfeedVectorLanes operator* (CrossfeedVectorLanes a, CrossfeedVectorLanes b) noexcept    { return { _mm256_mul_pd (a.value, b.value) }; }
+};
+#endif
+
+#if CROSSFEED_NEON
+template <>
+struct CrossfeedVectorLanes<float>
+{
+    float32x4_t value;
+
+    static CrossfeedVectorLanes fromRawArray (const float* a) noexcept      { return { vld1q_f32 (a) }; }
+    static CrossfeedVectorLanes fromUnalignedRawArray (const float* a) noexcept     { return { vld1q_f32 (a) }; }
+    static CrossfeedVectorLanes expand (float s) noexcept                   { return { vdupq_n_f32 (s) }; }
+    void copyToRawArray (float* a) const noexcept                           { vst1q_f32 (a, value); }
+
+    friend CrossfeedVectorLanes operator+ (CrossfeedVectorLanes a, CrossfeedVectorLanes b) noexcept    { return { vaddq_f32 (a.value, b.value) }; }
+    friend CrossfeedVectorLanes operator- (CrossfeedVectorLanes a, CrossfeedVectorLanes b) noexcept    { return { vsubq_f32 (a.value, b.value) }; }
+    friend CrossfeedVectorLanes operator* (CrossfeedVectorLanes a, CrossfeedVectorLanes b) noexcept    { return { vmulq_f32 (a.value, b.value) }; }
+};
+#endif
+
+//==============================================================================
+/** The best lane type for SampleType on this platform; isVector is false where
+    only the scalar lanes are available.
+*/
+template <typename SampleType>
+struct CrossfeedLanes
+{
+    using Type = CrossfeedScalarLanes<SampleType>;
+    static constexpr bool isVector = false;
+};
+
+#if CROSSFEED_SSE || CROSSFEED_NEON
+template <>
+struct CrossfeedLanes<float>
+{
+    using Type = CrossfeedVectorLanes<float>;
+    static constexpr bool isVector = true;
+};
+#endif
+
+#if CROSSFEED_SSE && defined (__AVX__)
+template <>
+struct CrossfeedLanes<double>
+{
+    using Type = CrossfeedVectorLanes<double>;
+    static constexpr bool isVector = true;
+};
+#endif
@@ -0,0 +1,559 @@
+/*
+  ==============================================================================
+
+    Surround to headphone crossfeed.
+
+    Downmixes a multichannel speaker layout to stereo and crossfeeds every
+    speaker on its own, in one pass. Each speaker reaches the ear on its side
+    directly and the other ear through the two-band crossfeed, with a cross
+    delay scaled to how far off centre it sits: a centre speaker has none, a
+    front pair at +-30 degrees gets the delays set by the parameters, and a
+    speaker at the side gets twice as much. The downmix gains are those of
+    ITU-R BS.775 by default.
+
+    Filtering and delaying are linear, so instead of band-splitting every
+    speaker the channels are first summed per ear by a channel matrix: the
+    direct sum and, per band, the sum of the cross-delayed channels. Only
+    those sums go through the band split, so the filter cost stays that of
+    the stereo kernel whatever the channel count. The matrix runs four frames
+    per register over per-channel rings laid out one after the other, each
+    mirrored so that a delayed run of a sub-block can be read without
+    wrapping.
+
+    Parameters ramp on the same sub-block grid as CrossfeedKernel, from the
+    same coefficient engine, and silence is skipped the same way: once every
+    speaker has been quiet for longer than the tail, the state is cleared and
+    silent blocks render silence without touching the rings. Like the kernel
+    this uses nothing from JUCE.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <limits>
+#include <vector>
+#include "CrossfeedCoefficients.h"
+#include "CrossfeedSIMD.h"
+
+//==============================================================================
+/** Where a speaker sits and how loud it goes into the downmix. */
+struct CrossfeedSpeaker
+{
+    float azimuth = 0.f;        // degrees, negative to the left, 0 straight ahead
+    float elevation = 0.f;      // degrees above the ear plane
+    float gain = 1.f;           // linear downmix gain; 0 leaves the channel out
+};
+
+//==============================================================================
+/**
+    Crossfeeds up to maxChannels speaker channels into a stereo pair.
+
+    prepare() allocates; everything else is real-time safe.
+*/
+template <typename SampleType = float>
+class CrossfeedSurround
+{
+public:
+    static constexpr int maxChannels = 16;
+
+    /** A speaker at the side gets this many times the cross delay of the front pair. */
+    static constexpr double maxDelayScale = 2.0;
+
+    /** Input below this level (about -160 dBFS) counts as silence, as in CrossfeedKernel. */
+    static constexpr SampleType silenceThreshold = (SampleType) 1.0e-8;
+
+    using Lanes = typename CrossfeedLanes<SampleType>::Type;
+
+    //==============================================================================
+    /** Prepares for the given speakers, one per input channel, and for base
+        delays (those of the front pair) of up to maxDelaySeconds.
+    */
+    void prepare (double newSampleRate, double maxDelaySeconds, const std::vector<CrossfeedSpeaker>& speakers)
+    {
+        sampleRate = newSampleRate;
+        numChannels = std::min (static_cast<int> (speakers.size()), maxChannels);
+
+        constexpr auto degrees = Coefficients::pi / 180.0;
+        constexpr auto frontLateral = 0.5;      // sin (30 degrees)
+
+        for (int channel = 0; channel < numChannels; channel++)
+        {
+            const auto& speaker = speakers[static_cast<size_t> (channel)];
+            const auto lateral = std::sin (speaker.azimuth * degrees) * std::cos (speaker.elevation * degrees);
+            const auto gain = static_cast<SampleType> (speaker.gain);
+
+            // Speakers on the centre line go to both ears at -3 dB, like the centre channel in BS.775.
+            const auto centred = std::abs (lateral) < 1.0e-3;
+            toLeft[channel]  = centred ? gain * (SampleType) 0.70710678118654752 : (lateral < 0.0 ? gain : (SampleType) 0);
+            toRight[channel] = centred ? gain * (SampleType) 0.70710678118654752 : (lateral > 0.0 ? gain : (SampleType) 0);
+            delayScale[channel] = static_cast<SampleType> (centred ? 0.0 : std::min (std::abs (lateral) / frontLateral, maxDelayScale));
+        }
+
+        maxBaseDelaySamples = sampleRate * maxDelaySeconds;
+        maxDelaySamples = static_cast<int> (std::ceil (maxBaseDelaySamples * maxDelayScale));
+
+        // A sub-block is read up to maxDelay + 1 frames behind its first frame,
+        // and up to a register beyond its last.
+        auto frames = 1;
+
+        while (frames < maxDelaySamples + 2 + Coefficients::subBlockSize + numLanes)
+            frames *= 2;
+
+        ringSize = frames;
+        mask = frames - 1;
+        channelStride = 2 * frames + numLanes;
+        rings.assign (static_cast<size_t> (channelStride * std::max (1, numChannels)), (SampleType) 0);
+
+        coefficients.prepare (sampleRate);
+        reset();
+    }
+
+    void reset() noexcept
+    {
+        clearState();
+        writePosition = 0;
+        segmentRemaining = 0;
+        bypassed = false;
+
+        silentSamples = 0;
+        idle = false;
+    }
+
+    int getNumChannels() const noexcept     { return numChannels; }
+
+    /** Samples for an impulse to decay below tolerance, with the widest speaker's delay. */
+    int getTailSamples (double crossoverFrequency, double tolerance) const
+    {
+        return Coefficients::getSettlingSamples (sampleRate, crossoverFrequency, tolerance) + maxDelaySamples + 1;
+    }
+
+    /** True while silent input is being skipped. */
+    bool isIdle() const noexcept     { return idle; }
+
+    /** The most general path that ran in the last block: idle, bypass or general. */
+    CrossfeedPath getLastPath() const noexcept     { return lastPath; }
+
+    //==============================================================================
+    /** The same parameters as CrossfeedKernel::setParameters(), with the delays
+        those of the front pair. Other speakers scale them by their position.
+    */
+    void setParameters (SampleType crossoverFrequency, SampleType lowDelaySamples, SampleType highDelaySamples,
+                        SampleType lowAmplitude, SampleType highAmplitude) noexcept
+    {
+        const auto maxDelay = static_cast<SampleType> (maxBaseDelaySamples);
+
+        coefficients.setTargets (crossoverFrequency,
+                                 std::clamp (lowDelaySamples, (SampleType) 0, maxDelay),
+                                 std::clamp (highDelaySamples, (SampleType) 0, maxDelay),
+                                 lowAmplitude, highAmplitude);
+    }
+
+    //==============================================================================
+    /** Renders getNumChannels() input channels to a stereo pair. left and right
+        may be the first two inputs.
+    */
+    void process (const SampleType* const* inputs, SampleType* left, SampleType* right, int numSamples) noexcept
+    {
+        if (! isSilent (inputs, numSamples))
+        {
+            silentSamples = 0;
+            idle = false;
+        }
+        else if (idle)
+        {
+            // Nothing is ringing, so parameter changes need no ramp either.
+            std::fill (left, left + numSamples, (SampleType) 0);
+            std::fill (right, right + numSamples, (SampleType) 0);
+            coefficients.settle();
+            segmentRemaining = 0;
+            lastPath = CrossfeedPath::idle;
+            return;
+        }
+        else
+        {
+            silentSamples = std::min (silentSamples + numSamples, std::numeric_limits<int>::max() / 2);
+        }
+
+        processSubBlocks (inputs, left, right, numSamples);
+
+        if (silentSamples > 0 && silentSamples >= getTailSamples (coefficients.getTargetCrossoverFrequency(), silenceThreshold))
+        {
+            // The rings and filters hold nothing above the threshold; signal
+            // resumes from a clean state, whatever the write position.
+            clearState();
+            idle = true;
+        }
+    }
+
+    /** The channel matrix alone, without crossfeed. The history is kept up to
+        date, so process() can take over from here.
+    */
+    void downmix (const SampleType* const* inputs, SampleType* left, SampleType* right, int numSamples) noexcept
+    {
+        for (int offset = 0, length = 0; offset < numSamples; offset += length)
+        {
+            length = std::min (Coefficients::subBlockSize, numSamples - offset);
+
+            write (inputs, offset, length);
+            downmixFrames (left + offset, right + offset, length);
+            writePosition = (writePosition + length) & mask;
+        }
+
+        bypassed = true;
+        silentSamples = 0;
+        idle = false;
+        lastPath = CrossfeedPath::bypass;
+    }
+
+    /** The same channel matrix as downmix(), read straight from the inputs and
+        leaving all state alone, so that it can run beside process() on the same
+        input. The sums are formed at SampleType precision and then stored as
+        OutputType; left and right may be the first two inputs.
+    */
+    template <typename OutputType>
+    void mix (const SampleType* const* inputs, OutputType* left, OutputType* right, int numSamples) const noexcept
+    {
+        for (int i = 0; i < numSamples; i++)
+        {
+            SampleType sums[2] {};
+
+            for (int channel = 0; channel < numChannels; channel++)
+            {
+                if (toLeft[channel] != SampleType())
+                    sums[0] += toLeft[channel] * inputs[channel][i];
+
+                if (toRight[channel] != SampleType())
+                    sums[1] += toRight[channel] * inputs[channel][i];
+            }
+
+            left[i] = static_cast<OutputType> (sums[0]);
+            right[i] = static_cast<OutputType> (sums[1]);
+        }
+    }
+
+private:
+    //==============================================================================
+    using Coefficients = CrossfeedCoefficients<SampleType>;
+
+    static constexpr int numLanes = 4;
+    static constexpr size_t alignment = numLanes * sizeof (SampleType);
+    static constexpr int maxFrames = Coefficients::subBlockSize;
+
+    // One block of per-ear sums, each padded to whole registers.
+    struct Sums
+    {
+        alignas (alignment) SampleType direct[2][maxFrames];
+        alignas (alignment) SampleType crossLow[2][maxFrames];
+        alignas (alignment) SampleType crossHigh[2][maxFrames];
+    };
+
+    //==============================================================================
+    void processSubBlocks (const SampleType* const* inputs, SampleType* left, SampleType* right, int numSamples) noexcept
+    {
+        lastPath = CrossfeedPath::bypass;
+
+        for (int offset = 0, length = 0; offset < numSamples; offset += length)
+        {
+            if (segmentRemaining == 0)
+            {
+                coefficients.next (Coefficients::subBlockSize, segment);
+                segmentRemaining = Coefficients::subBlockSize;
+            }
+
+            length = std::min (segmentRemaining, numSamples - offset);
+            segmentRemaining -= length;
+
+            write (inputs, offset, length);
+
+            if (segment.path == CrossfeedPath::bypass)
+            {
+                downmixFrames (left + offset, right + offset, length);
+                bypassed = true;
+            }
+            else
+            {
+                if (bypassed)
+                {
+                    // As in the kernel, the cross signal fades in from a clean filter state.
+                    std::fill (std::begin (filterState), std::end (filterState), (SampleType) 0);
+                    bypassed = false;
+                }
+
+                lastPath = CrossfeedPath::general;
+
+                if (segment.ramping)
+                    processFrames<true> (left + offset, right + offset, length);
+                else
+                    processFrames<false> (left + offset, right + offset, length);
+            }
+
+            writePosition = (writePosition + length) & mask;
+
+            if (segment.ramping && segmentRemaining > 0)
+                segment.skip (length);
+        }
+    }
+
+    void clearState() noexcept
+    {
+        std::fill (rings.begin(), rings.end(), (SampleType) 0);
+        std::fill (std::begin (filterState), std::end (filterState), (SampleType) 0);
+    }
+
+    /** True if every channel that goes into the downmix is below the threshold. */
+    bool isSilent (const SampleType* const* inputs, int numSamples) const noexcept
+    {
+        for (int channel = 0; channel < numChannels; channel++)
+        {
+            if (! isUsed (channel))
+                continue;
+
+            const auto* input = inputs[channel];
+
+            for (int i = 0; i < numSamples; i++)
+                if (! (std::abs (input[i]) < silenceThreshold))
+                    return false;
+        }
+
+        return true;
+    }
+
+    //==============================================================================
+    bool isUsed (int channel) const noexcept
+    {
+        return toLeft[channel] != SampleType() || toRight[channel] != SampleType();
+    }
+
+    SampleType* getRing (int channel) noexcept     { return rings.data() + channel * channelStride; }
+
+    void write (const SampleType* const* inputs, int offset, int numFrames) noexcept
+    {
+        for (int channel = 0; channel < numChannels; channel++)
+        {
+            if (! isUsed (channel))
+                continue;
+
+            const auto* input = inputs[channel] + offset;
+            auto* ring = getRing (channel);
+
+            // Every frame is stored twice, so any run shorter than the ring reads contiguously.
+            for (int i = 0; i < numFrames; i++)
+            {
+                const auto position = (writePosition + i) & mask;
+                ring[position] = ring[position + ringSize] = input[i];
+            }
+        }
+    }
+
+    //==============================================================================
+    static int roundUpToRegister (int numFrames) noexcept
+    {
+        return (numFrames + numLanes - 1) & ~(numLanes - 1);
+    }
+
+    static void clear (SampleType* destination, int numVectorFrames) noexcept
+    {
+        std::fill (destination, destination + numVectorFrames, (SampleType) 0);
+    }
+
+    /** destination += gain * source, a register at a time. */
+    static void addScaled (SampleType* destination, const SampleType* source, SampleType gain, int numVectorFrames) noexcept
+    {
+        const auto g = Lanes::expand (gain);
+
+        for (int i = 0; i < numVectorFrames; i += numLanes)
+            (Lanes::fromRawArray (destination + i) + g * Lanes::fromUnalignedRawArray (source + i)).copyToRawArray (destination + i);
+    }
+
+    /** destination += gain * source delayed by a steady fractional delay, with linear interpolation. */
+    void addDelayed (SampleType* destination, const SampleType* ring, SampleType delay, SampleType gain, int numVectorFrames) const noexcept
+    {
+        const auto delayInt = static_cast<int> (delay);
+        const auto delayFrac = delay - static_cast<SampleType> (delayInt);
+        const auto* older = ring + ((writePosition - delayInt - 1) & mask);
+
+        if (delayFrac == SampleType())
+        {
+            addScaled (destination, older + 1, gain, numVectorFrames);
+            return;
+        }
+
+        const auto newerGain = Lanes::expand (gain * ((SampleType) 1 - delayFrac));
+        const auto olderGain = Lanes::expand (gain * delayFrac);
+
+        for (int i = 0; i < numVectorFrames; i += numLanes)
+        {
+            const auto sum = Lanes::fromRawArray (destination + i)
+                           + newerGain * Lanes::fromUnalignedRawArray (older + i + 1)
+                           + olderGain * Lanes::fromUnalignedRawArray (older + i);
+            sum.copyToRawArray (destination + i);
+        }
+    }
+
+    /** addDelayed() for a delay that grows by step per frame, starting at delay + step. */
+    void addRampedDelay (SampleType* destination, const SampleType* ring, SampleType delay, SampleType step,
+                         SampleType gain, int numFrames) const noexcept
+    {
+        const auto maxDelay = static_cast<SampleType> (maxDelaySamples);
+
+        for (int i = 0; i < numFrames; i++)
+        {
+            const auto d = std::clamp (delay + step * static_cast<SampleType> (i + 1), (SampleType) 0, maxDelay);
+            const auto delayInt = static_cast<int> (d);
+            const auto delayFrac = d - static_cast<SampleType> (delayInt);
+            const auto* older = ring + ((writePosition + i - delayInt - 1) & mask);
+
+            destination[i] += gain * (older[1] + delayFrac * (older[0] - older[1]));
+        }
+    }
+
+    //==============================================================================
+    /** Sums the channels written last into each ear, undelayed. */
+    void sumDirect (Sums& sums, int numVectorFrames) noexcept
+    {
+        clear (sums.direct[0], numVectorFrames);
+        clear (sums.direct[1], numVectorFrames);
+
+        for (int channel = 0; channel < numChannels; channel++)
+        {
+            const auto* current = getRing (channel) + writePosition;
+
+            if (toLeft[channel] != SampleType())
+                addScaled (sums.direct[0], current, toLeft[channel], numVectorFrames);
+
+            if (toRight[channel] != SampleType())
+                addScaled (sums.direct[1], current, toRight[channel], numVectorFrames);
+        }
+    }
+
+    void downmixFrames (SampleType* left, SampleType* right, int numFrames) noexcept
+    {
+        Sums sums;
+        sumDirect (sums, roundUpToRegister (numFrames));
+
+        std::copy (sums.direct[0], sums.direct[0] + numFrames, left);
+        std::copy (sums.direct[1], sums.direct[1] + numFrames, right);
+    }
+
+    template <bool ramping>
+    void processFrames (SampleType* left, SampleType* right, int numFrames) noexcept
+    {
+        Sums sums;
+        const auto numVectorFrames = roundUpToRegister (numFrames);
+
+        // Channel matrix: the direct sum per ear, and per band the cross-delayed
+        // sum of the channels on the other side.
+        sumDirect (sums, numVectorFrames);
+
+        for (int ear = 0; ear < 2; ear++)
+        {
+            clear (sums.crossLow[ear], numVectorFrames);
+            clear (sums.crossHigh[ear], numVectorFrames);
+        }
+
+        const auto includeHigh = ramping || segment.wet[2] != SampleType();
+
+        for (int channel = 0; channel < numChannels; channel++)
+        {
+            const auto* ring = getRing (channel);
+            const SampleType crossGains[2] { toRight[channel], toLeft[channel] };
+            const auto scale = delayScale[channel];
+
+            for (int ear = 0; ear < 2; ear++)
+            {
+                if (crossGains[ear] == SampleType())
+                    continue;
+
+                if constexpr (ramping)
+                {
+                    addRampedDelay (sums.crossLow[ear], ring, segment.delayLow * scale, segment.delayLowStep * scale, crossGains[ear], numFrames);
+                    addRampedDelay (sums.crossHigh[ear], ring, segment.delayHigh * scale, segment.delayHighStep * scale, crossGains[ear], numFrames);
+                }
+                else
+                {
+                    addDelayed (sums.crossLow[ear], ring, segment.delayLow * scale, crossGains[ear], numVectorFrames);
+
+                    if (includeHigh)
+                        addDelayed (sums.crossHigh[ear], ring, segment.delayHigh * scale, crossGains[ear], numVectorFrames);
+                }
+            }
+        }
+
+        // Band split and mix, as in the kernel: lanes are low L, low R, high L, high R.
+        // The direct sums go through both bands, the cross sums through their own.
+        alignas (alignment) SampleType frame[numLanes];
+
+        const auto b0 = Lanes::fromRawArray (segment.b0);
+        const auto b1 = Lanes::fromRawArray (segment.b1);
+        const auto a1 = Lanes::fromRawArray (segment.a1);
+        const auto one = Lanes::expand ((SampleType) 1);
+        const auto wetStep = Lanes::fromRawArray (segment.wetStep);
+
+        auto directState = Lanes::fromRawArray (filterState);
+        auto crossState = Lanes::fromRawArray (filterState + numLanes);
+        auto wetGain = Lanes::fromRawArray (segment.wet);
+        auto dryGain = one - wetGain;
+
+        for (int i = 0; i < numFrames; i++)
+        {
+            frame[0] = frame[2] = sums.direct[0][i];
+            frame[1] = frame[3] = sums.direct[1][i];
+
+            const auto direct = Lanes::fromRawArray (frame);
+            const auto directOut = b0 * direct + directState;
+            directState = b1 * direct - a1 * directOut;
+
+            frame[0] = sums.crossLow[0][i];
+            frame[1] = sums.crossLow[1][i];
+            frame[2] = sums.crossHigh[0][i];
+            frame[3] = sums.crossHigh[1][i];
+
+            const auto cross = Lanes::fromRawArray (frame);
+            const auto crossOut = b0 * cross + crossState;
+            crossState = b1 * cross - a1 * crossOut;
+
+            if (ramping)
+            {
+                wetGain = wetGain + wetStep;
+                dryGain = one - wetGain;
+            }
+
+            (directOut * dryGain + crossOut * wetGain).copyToRawArray (frame);
+
+            left[i]  = frame[0] + frame[2];
+            right[i] = frame[1] + frame[3];
+        }
+
+        directState.copyToRawArray (filterState);
+        crossState.copyToRawArray (filterState + numLanes);
+    }
+
+    //==============================================================================
+    double sampleRate = 44100.0;
+    double maxBaseDelaySamples = 0.0;
+    int maxDelaySamples = 0;
+    int numChannels = 0;
+
+    // Downmix gain into each ear, and cross delay relative to the front pair, per channel.
+    SampleType toLeft[maxChannels] {}, toRight[maxChannels] {};
+    SampleType delayScale[maxChannels] {};
+
+    // One mirrored ring per channel, channelStride apart.
+    std::vector<SampleType> rings;
+    int ringSize = 0, mask = 0, channelStride = 0;
+    int writePosition = 0;
+
+    Coefficients coefficients;
+    CrossfeedSegment<SampleType> segment;
+    int segmentRemaining = 0;
+    bool bypassed = false;
+    CrossfeedPath lastPath = CrossfeedPath::general;
+
+    // Input frames since anything above the threshold came in, capped well below overflow.
+    int silentSamples = 0;
+    bool idle = false;
+
+    // Band split state for the direct sums, then the cross sums.
+    alignas (alignment) SampleType filterState[2 * numLanes] {};
+};
@@ -20,7 +20,8 @@ CrossfeedAudioProcessorEditor::CrossfeedAudioProcessorEditor (CrossfeedAudioProc
 {
     // Make sure that before the constructor has finished, you've set the
     // editor's size to whatever you need it to be.
-    setSize (440, 360);
+    setSize (440, 560);
+    setOpaque(true);
     
     
     addAndMakeVisible (amplitudeLowSlider);
@@ -106,16 +107,76 @@ CrossfeedAudioProcessorEditor::CrossfeedAudioProcessorEditor (CrossfeedAudioProc
     crossoverFrequencySlider.setColour(juce::Slider::ColourIds::textBoxOutlineColourId, black);
     crossoverFrequencySlider.setColour(juce::Slider::ColourIds::textBoxHighlightColourId, blue);
     crossoverFrequencySlider.setColour(juce::Slider::ColourIds::textBoxBackgroundColourId, black);
+    
+    
+    addAndMakeVisible (modeButton);
+    modeButton.setButtonText(getModeText());
+    modeButton.setColour(juce::TextButton::ColourIds::buttonColourId, black);
+    modeButton.setColour(juce::TextButton::ColourIds::textColourOffId, grey);
+    modeButton.setLookAndFeel(&modeButtonLookAndFeel);
+    modeButton.onClick = [this] { showModeMenu(); };
+    
+    twoBandMode = audioProcessor.getImpulseResponseFile() == juce::File();
+    updateResponse();
+    startTimerHz(30);
 }
 
 CrossfeedAudioProcessorEditor::~CrossfeedAudioProcessorEditor()
 {
+    modeButton.setLookAndFeel(nullptr);
 }
 
 //==============================================================================
 void CrossfeedAudioProcessorEditor::paint (juce::Graphics& g)
 {
-    // (Our component is opaque, so we must completely fill the background with a solid colour)
+    // Only the meter and the response change from one repaint to the next;
+    // the rest comes from the cached background.
+    auto scale = g.getInternalContext().getPhysicalPixelScaleFactor();
+    if (background.isNull() || scale != backgroundScale)
+        renderBackground(scale);
+    
+    g.drawImage(background, getLocalBounds().toFloat());
+    
+    g.setColour(grey);
+    g.setFont(12);
+    
+    auto meter = getLoadMeterBounds();
+    g.drawFittedText(juce::String::formatted("%s  load %.1f%%  worst %.0f%%  overruns %d",
+                                             getCrossfeedPathName(performanceStats.lastPath),
+                                             displayedLoad * 100, performanceStats.worstLoad * 100,
+                                             (int) performanceStats.overruns),
+                     meter.removeFromTop(15), juce::Justification::right, 1);
+    
+    meter.removeFromTop(5);
+    g.drawRect(meter);
+    
+    auto load = juce::jlimit(0.0, 1.0, displayedLoad);
+    g.setColour(load < .7 ? green : (load < 1 ? yellow : red));
+    g.fillRect(meter.reduced(2).withWidth(juce::roundToInt((meter.getWidth() - 4) * load)));
+    
+    // In HRTF mode the two-band settings are not what is heard, so their response is shown dimmed.
+    juce::Graphics::ScopedSaveState state(g);
+    g.reduceClipRegion(getResponseBounds());
+    auto alpha = twoBandMode ? 1.f : .3f;
+    
+    g.setColour(yellow.withMultipliedAlpha(alpha));
+    g.strokePath(delayPath, juce::PathStrokeType(1.f));
+    g.setColour(red.withMultipliedAlpha(alpha));
+    g.strokePath(contralateralPath, juce::PathStrokeType(1.5f));
+    g.setColour(white.withMultipliedAlpha(alpha));
+    g.strokePath(ipsilateralPath, juce::PathStrokeType(1.5f));
+}
+
+void CrossfeedAudioProcessorEditor::renderBackground (float scale)
+{
+    background = juce::Image(juce::Image::RGB,
+                             juce::jmax(1, juce::roundToInt(getWidth() * scale)),
+                             juce::jmax(1, juce::roundToInt(getHeight() * scale)), false);
+    backgroundScale = scale;
+    
+    juce::Graphics g(background);
+    g.addTransform(juce::AffineTransform::scale(scale));
+    
     g.fillAll (black);
     g.setColour(white);
     g.setFont(18);
@@ -141,11 +202,226 @@ void CrossfeedAudioProcessorEditor::paint (juce::Graphics& g)
     g.setFont(15);
     g.drawFittedText("Crossover", 40,  250, 100, 30, juce::Justification::left, 1);
     
+    drawResponseGrid(g);
+    
     g.setColour(grey);
     g.setFont(12);
     g.drawFittedText("Unusual Audio", 40, getHeight() - 60, 300, 30, juce::Justification::left, 1);
 }
 
+void CrossfeedAudioProcessorEditor::drawResponseGrid (juce::Graphics& g) const
+{
+    auto plot = getResponseBounds();
+    auto area = plot.toFloat();
+    
+    g.setFont(12);
+    
+    for (auto frequency : { 100.0, 1000.0, 10000.0 })
+    {
+        auto x = area.getX() + area.getWidth() * (float) (std::log(frequency / minResponseFrequency)
+                                                         / std::log(maxResponseFrequency / minResponseFrequency));
+        g.setColour(grey.withAlpha(.5f));
+        g.drawVerticalLine(juce::roundToInt(x), area.getY(), area.getBottom());
+        g.setColour(grey);
+        g.drawFittedText(frequency < 1000 ? "100 Hz" : juce::String((int) frequency / 1000) + " kHz",
+                         juce::roundToInt(x) - 30, plot.getBottom() + 2, 60, 15, juce::Justification::centred, 1);
+    }
+    
+    for (auto gain = maxResponseGain - 6; gain > minResponseGain; gain -= 12)
+    {
+        auto y = juce::jmap(gain, minResponseGain, maxResponseGain, area.getBottom(), area.getY());
+        g.setColour(grey.withAlpha(.5f));
+        g.drawHorizontalLine(juce::roundToInt(y), area.getX(), area.getRight());
+        g.setColour(grey);
+        g.drawFittedText(juce::String((int) gain) + " dB", plot.getX() + 4, juce::roundToInt(y) - 15, 60, 15, juce::Justification::left, 1);
+    }
+    
+    g.setColour(grey);
+    g.drawRect(plot);
+    
+    auto legend = plot.reduced(4).removeFromTop(15);
+    g.setColour(yellow);
+    g.drawFittedText("interaural delay (0-1.2 ms)", legend.removeFromRight(160), juce::Justification::right, 1);
+    g.setColour(red);
+    g.drawFittedText("opposite", legend.removeFromRight(60), juce::Justification::right, 1);
+    g.setColour(white);
+    g.drawFittedText("same side", legend.removeFromRight(70), juce::Justification::right, 1);
+}
+
+void CrossfeedAudioProcessorEditor::timerCallback()
+{
+    auto& monitor = audioProcessor.getPerformanceMonitor();
+    performanceStats.addAll(monitor);
+    displayedLoad = monitor.getLoad();
+    
+    repaint(getLoadMeterBounds());
+    
+    auto mode = getModeText();
+    if (mode != modeButton.getButtonText())
+        modeButton.setButtonText(mode);
+    
+    auto twoBand = audioProcessor.getImpulseResponseFile() == juce::File();
+    if (twoBand != twoBandMode)
+    {
+        twoBandMode = twoBand;
+        repaint(getResponseBounds());
+    }
+    
+    std::unique_ptr<CrossfeedResponse> ready;
+    {
+        const juce::ScopedLock lock(responseLock);
+        ready = std::move(pendingResponse);
+    }
+    
+    if (ready != nullptr)
+    {
+        response = std::move(*ready);
+        updateResponsePaths();
+        repaint(getResponseBounds());
+    }
+    
+    updateResponse();
+}
+
+//==============================================================================
+CrossfeedParameterSnapshot CrossfeedAudioProcessorEditor::getParameterSnapshot() const
+{
+    CrossfeedParameterSnapshot parameters;
+    parameters.amplitudeLow = audioProcessor.amplitudeLow->get();
+    parameters.amplitudeHigh = audioProcessor.amplitudeHigh->get();
+    parameters.delayLow = audioProcessor.delayLow->get();
+    parameters.delayHigh = audioProcessor.delayHigh->get();
+    parameters.crossoverFrequency = audioProcessor.crossoverFrequency->get();
+    return parameters;
+}
+
+void CrossfeedAudioProcessorEditor::updateResponse()
+{
+    // One job at a time. While a drag outruns the worker the values it passes
+    // over are skipped, and the latest is computed once the worker is free.
+    if (responseWorker.getNumJobs() > 0)
+        return;
+    
+    auto parameters = getParameterSnapshot();
+    auto rate = audioProcessor.getSampleRate() > 0 ? audioProcessor.getSampleRate() : 48000.0;
+    
+    if (parameters == requestedParameters && rate == requestedSampleRate)
+        return;
+    
+    requestedParameters = parameters;
+    requestedSampleRate = rate;
+    
+    responseWorker.addJob([this, parameters, rate]
+    {
+        auto result = std::make_unique<CrossfeedResponse>(CrossfeedResponse::compute(parameters, rate, numResponsePoints,
+                                                                                     minResponseFrequency,
+                                                                                     juce::jmin(maxResponseFrequency, rate * .49)));
+        
+        const juce::ScopedLock lock(responseLock);
+        pendingResponse = std::move(result);
+    });
+}
+
+void CrossfeedAudioProcessorEditor::updateResponsePaths()
+{
+    ipsilateralPath.clear();
+    contralateralPath.clear();
+    delayPath.clear();
+    
+    auto area = getResponseBounds().toFloat();
+    auto gainToY = [&] (float gain)
+    {
+        return juce::jmap(juce::jlimit(minResponseGain - 1, maxResponseGain, gain), minResponseGain, maxResponseGain, area.getBottom(), area.getY());
+    };
+    
+    for (size_t i = 0; i < response.frequencies.size(); i++)
+    {
+        auto x = area.getX() + area.getWidth() * (float) (std::log(response.frequencies[i] / minResponseFrequency)
+                                                         / std::log(maxResponseFrequency / minResponseFrequency));
+        
+        auto delay = response.contralateralDelay[i] - response.ipsilateralDelay[i];
+        auto delayY = juce::jmap(juce::jlimit(-1.f, maxResponseDelay, delay), 0.f, maxResponseDelay, area.getBottom(), area.getY());
+        
+        if (i == 0)
+        {
+            ipsilateralPath.startNewSubPath(x, gainToY(response.ipsilateralGain[i]));
+            contralateralPath.startNewSubPath(x, gainToY(response.contralateralGain[i]));
+            delayPath.startNewSubPath(x, delayY);
+        }
+        else
+        {
+            ipsilateralPath.lineTo(x, gainToY(response.ipsilateralGain[i]));
+            contralateralPath.lineTo(x, gainToY(response.contralateralGain[i]));
+            delayPath.lineTo(x, delayY);
+        }
+    }
+}
+
+void CrossfeedAudioProcessorEditor::showModeMenu()
+{
+    const auto hrtf = audioProcessor.getImpulseResponseFile() != juce::File();
+    
+    juce::PopupMenu menu;
+    menu.addItem("Load HRIR...", [this]
+    {
+        impulseResponseChooser = std::make_unique<juce::FileChooser>("Load HRIR", audioProcessor.getImpulseResponseFile(), "*.wav;*.aif;*.aiff;*.flac");
+        impulseResponseChooser->launchAsync(juce::FileBrowserComponent::openMode | juce::FileBrowserComponent::canSelectFiles,
+                                            [this] (const juce::FileChooser& chooser)
+        {
+            auto file = chooser.getResult();
+            if (file == juce::File())
+                return;
+            
+            auto result = audioProcessor.loadImpulseResponse(file);
+            if (result.failed())
+                juce::AlertWindow::showMessageBoxAsync(juce::MessageBoxIconType::WarningIcon, "Load HRIR", result.getErrorMessage());
+        });
+    });
+    menu.addItem("Use two-band model", hrtf, ! hrtf, [this] { audioProcessor.clearImpulseResponse(); });
+    
+    menu.showMenuAsync(juce::PopupMenu::Options().withTargetComponent(&modeButton));
+}
+
+void CrossfeedAudioProcessorEditor::ModeButtonLookAndFeel::drawButtonBackground (juce::Graphics& g, juce::Button& button,
+                                                                                const juce::Colour& backgroundColour,
+                                                                                bool isMouseOverButton, bool isButtonDown)
+{
+    auto bounds = button.getLocalBounds().toFloat().reduced(.5f);
+    
+    g.setColour(isButtonDown || isMouseOverButton ? backgroundColour.contrasting(isButtonDown ? .2f : .1f) : backgroundColour);
+    g.fillRoundedRectangle(bounds, 3.f);
+    
+    g.setColour(button.findColour(juce::TextButton::ColourIds::textColourOffId));
+    g.drawRoundedRectangle(bounds, 3.f, 1.f);
+}
+
+juce::String CrossfeedAudioProcessorEditor::getModeText() const
+{
+    auto file = audioProcessor.getImpulseResponseFile();
+    
+    if (file == juce::File())
+        return "Two-band";
+    
+    if (audioProcessor.isLoadingImpulseResponse())
+        return "Loading...";
+    
+    auto error = audioProcessor.getImpulseResponseError();
+    if (error.isNotEmpty())
+        return "HRIR error";
+    
+    return "HRTF: " + file.getFileNameWithoutExtension();
+}
+
+juce::Rectangle<int> CrossfeedAudioProcessorEditor::getLoadMeterBounds() const
+{
+    return { getWidth() - 40 - 260, getHeight() - 60, 260, 30 };
+}
+
+juce::Rectangle<int> CrossfeedAudioProcessorEditor::getResponseBounds() const
+{
+    return { 40, 300, getWidth() - 80, getHeight() - 300 - 90 };
+}
+
 void CrossfeedAudioProcessorEditor::resized()
 {
     // This is generally where you'll want to lay out the positions of any
@@ -155,4 +431,9 @@ void CrossfeedAudioProcessorEditor::resized()
     delayLowSlider          .setBounds (140, 175, getWidth() - 140 - 40, 20);
     delayHighSlider         .setBounds (140, 215, getWidth() - 140 - 40, 20);
     crossoverFrequencySlider.setBounds (140, 255, getWidth() - 140 - 40, 20);
+    
+    modeButton.setBounds (getWidth() - 40 - 160, 30, 160, 30);
+    
+    background = {};
+    updateResponsePaths();
 }
@@ -10,11 +10,13 @@
 
 #include <JuceHeader.h>
 #include "PluginProcessor.h"
+#include "CrossfeedResponse.h"
 
 //==============================================================================
 /**
 */
-class CrossfeedAudioProcessorEditor  : public juce::AudioProcessorEditor
+class CrossfeedAudioProcessorEditor  : public juce::AudioProcessorEditor,
+                                       private juce::Timer
 {
 public:
     CrossfeedAudioProcessorEditor (CrossfeedAudioProcessor&);
@@ -33,6 +35,17 @@ public:
     void resized() override;
 
 private:
+    void timerCallback() override;
+    juce::Rectangle<int> getLoadMeterBounds() const;
+    juce::Rectangle<int> getResponseBounds() const;
+    void renderBackground (float scale);
+    void drawResponseGrid (juce::Graphics&) const;
+    void updateResponse();
+    void updateResponsePaths();
+    CrossfeedParameterSnapshot getParameterSnapshot() const;
+    void showModeMenu();
+    juce::String getModeText() const;
+    
     // This reference is provided as a quick way for your editor to
     // access the processor object that created it.
     CrossfeedAudioProcessor& audioProcessor;
@@ -51,6 +64,45 @@ private:
     
     juce::Slider crossoverFrequencySlider;
     juce::SliderParameterAttachment crossoverFrequencyAttachment;
+    
+    // Draws the mode button's outline in its text colour; the stock look
+    // would take it from a ComboBox colour id.
+    struct ModeButtonLookAndFeel : public juce::LookAndFeel_V4
+    {
+        void drawButtonBackground (juce::Graphics&, juce::Button&, const juce::Colour& backgroundColour,
+                                   bool isMouseOverButton, bool isButtonDown) override;
+    };
+    
+    ModeButtonLookAndFeel modeButtonLookAndFeel;
+    juce::TextButton modeButton;
+    std::unique_ptr<juce::FileChooser> impulseResponseChooser;
+    
+    CrossfeedPerformanceStats performanceStats;
+    double displayedLoad = 0.0;
+    
+    // Everything that does not change between repaints, drawn once per size
+    // and display scale.
+    juce::Image background;
+    float backgroundScale = 0.f;
+    
+    //==============================================================================
+    // The response plot. Responses are computed on responseWorker and handed
+    // over through pendingResponse; the timer picks them up, so the plot is
+    // repainted at most once per tick however fast a slider moves.
+    static constexpr int numResponsePoints = 256;
+    static constexpr double minResponseFrequency = 20.0, maxResponseFrequency = 20000.0;
+    static constexpr float minResponseGain = -36.f, maxResponseGain = 6.f;
+    static constexpr float maxResponseDelay = 1200.f;
+    
+    CrossfeedResponse response;
+    juce::Path ipsilateralPath, contralateralPath, delayPath;
+    CrossfeedParameterSnapshot requestedParameters;
+    double requestedSampleRate = 0.0;
+    bool twoBandMode = true;
+    
+    juce::CriticalSection responseLock;
+    std::unique_ptr<CrossfeedResponse> pendingResponse;
+    juce::ThreadPool responseWorker { 1 };
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (CrossfeedAudioProcessorEditor)
 };
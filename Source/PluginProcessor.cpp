@@ -27,10 +27,16 @@ CrossfeedAudioProcessor::CrossfeedAudioProcessor()
     addParameter (delayLow = new juce::AudioParameterFloat ({"delayLow", 1}, "Delay (low)", 0.f, 1000.f, 250.f));
     addParameter (delayHigh = new juce::AudioParameterFloat ({"delayHigh", 1}, "Delay (high)", 0.f, 1000.f, 100.f));
     addParameter (crossoverFrequency = new juce::AudioParameterFloat ({"crossoverFrequency", 1}, "Crossover frequency", 20.f, 20000.f, 2000.f));
+
+    parameterStore.publish ({ *amplitudeLow, *amplitudeHigh, *delayLow, *delayHigh, *crossoverFrequency });
+
+    for (auto* parameter : getParameters())
+        parameter->addListener (this);
 }
 
 CrossfeedAudioProcessor::~CrossfeedAudioProcessor()
 {
+    stopTimer();
 }
 
 //==============================================================================
@@ -68,7 +74,20 @@ bool CrossfeedAudioProcessor::isMidiEffect() const
 
 double CrossfeedAudioProcessor::getTailLengthSeconds() const
 {
-    return 0.0;
+    // The filters ring longest at the lowest crossover frequency; report that
+    // worst case (down to -120 dB) so the tail holds whatever the automation does.
+    auto rate = sampleRate > 0 ? (double) sampleRate : 44100.0;
+    auto settling = CrossfeedCoefficients<double>::getSettlingSamples(rate, crossoverFrequency->range.start, tailTolerance);
+    auto delay = juce::jmax(delayLow->range.end, delayHigh->range.end) / 1000.f / 1000.f;
+    
+    // Speakers at the side are fed across with longer delays than the front pair.
+    if (getTotalNumInputChannels() > 2)
+        delay *= (float) CrossfeedSurround<>::maxDelayScale;
+    
+    // In HRTF mode, and while it fades out, the responses ring on as well.
+    auto convolution = reportedLatency > 0 ? impulseResponseSeconds.load() : 0.0;
+    
+    return settling / rate + delay + convolution;
 }
 
 int CrossfeedAudioProcessor::getNumPrograms()
@@ -98,26 +117,38 @@ void CrossfeedAudioProcessor::changeProgramName (int index, const juce::String&
 //==============================================================================
 void CrossfeedAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlock)
 {
-    juce::dsp::ProcessSpec spec;
-    spec.sampleRate = sampleRate;
-    spec.maximumBlockSize = samplesPerBlock;
-    spec.numChannels = 2;
-    
     this->sampleRate = sampleRate;
     
-    delayLine1 = juce::dsp::DelayLine<float, juce::dsp::DelayLineInterpolationTypes::Linear>{static_cast<int>(std::ceil(sampleRate * (1000.f / 1000.f)))};
-    delayLine1.reset();
-    delayLine1.prepare(spec);
+    // All state the engines need is allocated here, so processBlock never has
+    // to touch the allocator. Both are prepared, as the host may switch the
+    // processing precision without another call to prepareToPlay.
+    auto maxDelay = juce::jmax(delayLow->range.end, delayHigh->range.end);
+    auto speakers = getSurroundSpeakers(getChannelLayoutOfBus(true, 0));
+    floatEngine.prepare(sampleRate, maxDelay, speakers);
+    doubleEngine.prepare(sampleRate, maxDelay, speakers);
+    performance.prepare(sampleRate, samplesPerBlock);
     
-    delayLine2 = juce::dsp::DelayLine<float, juce::dsp::DelayLineInterpolationTypes::Linear>{static_cast<int>(std::ceil(sampleRate * (1000.f / 1000.f)))};
-    delayLine2.reset();
-    delayLine2.prepare(spec);
+    convolutionBuffer.setSize(2, juce::jmax(1, samplesPerBlock));
+    convolutionMix.reset(sampleRate, 0.05);
+    snapConvolutionMix = true;
     
-    lowPassFilter.reset();
-    lowPassFilter.prepare(spec);
+    const juce::dsp::ProcessSpec spec { sampleRate, (juce::uint32) juce::jmax(1, samplesPerBlock), 2 };
+    floatCompensation.prepare(spec);
+    doubleCompensation.prepare(spec);
+    compensatedLatency = 0;
     
-    highPassFilter.reset();
-    highPassFilter.prepare(spec);
+    {
+        // Responses are resampled for the sample rate, so any loaded ones are stale.
+        const juce::ScopedLock lock (loaderLock);
+        loadGeneration++;
+        convolution.prepare(juce::roundToInt(sampleRate * maxImpulseResponseSeconds));
+        
+        if (impulseResponseFile != juce::File())
+            startLoadingImpulseResponse();
+    }
+    
+    // The mix snaps to its target on the next block, so any fade-out is over.
+    reportLatency(convolutionEnabled ? CrossfeedConvolution::getLatencySamples() : 0);
 }
 
 void CrossfeedAudioProcessor::releaseResources()
@@ -134,15 +165,17 @@ bool CrossfeedAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts
     return true;
   #else
     // This is the place where you check if the layout is supported.
-    // In this template code we only support mono or stereo.
+    // The output is always stereo, for headphones.
     // Some plugin hosts, such as certain GarageBand versions, will only
     // load plugins that support stereo bus layouts.
     if (layouts.getMainOutputChannelSet() != juce::AudioChannelSet::stereo())
         return false;
 
-    // This checks if the input layout matches the output layout
+    // Stereo in, or a surround layout that is downmixed and crossfed in one go.
    #if ! JucePlugin_IsSynth
-    if (layouts.getMainOutputChannelSet() != layouts.getMainInputChannelSet())
+    const auto input = layouts.getMainInputChannelSet();
+    
+    if (input != juce::AudioChannelSet::stereo() && getSurroundSpeakers(input).empty())
         return false;
    #endif
 
@@ -153,69 +186,323 @@ bool CrossfeedAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts
 
 void CrossfeedAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
 {
-    double t = *delayLow / 1000.f / 1000.f;
-    delayLine1.setDelay(this->sampleRate * t);
+    process(buffer, floatEngine, floatCompensation);
+}
 
-    t = *delayHigh / 1000.f / 1000.f;
-    delayLine2.setDelay(this->sampleRate * t);
+void CrossfeedAudioProcessor::processBlock (juce::AudioBuffer<double>& buffer, juce::MidiBuffer& midiMessages)
+{
+    process(buffer, doubleEngine, doubleCompensation);
+}
+
+bool CrossfeedAudioProcessor::supportsDoublePrecisionProcessing() const
+{
+    return true;
+}
+
+template <typename SampleType>
+void CrossfeedAudioProcessor::process (juce::AudioBuffer<SampleType>& buffer, CrossfeedEngine<SampleType>& engine, Compensation<SampleType>& compensation)
+{
+    CrossfeedPerformanceMonitor::ScopedBlock timing(performance, buffer.getNumSamples());
+    juce::ScopedNoDenormals noDenormals;
     
-    lowPassFilter.coefficients = juce::dsp::IIR::Coefficients<float>::makeFirstOrderLowPass(sampleRate, *crossoverFrequency);
+    engine.setParameters(parameterStore.read());
     
-    highPassFilter.coefficients = juce::dsp::IIR::Coefficients<float>::makeFirstOrderHighPass(sampleRate, *crossoverFrequency);
-
-    int samples = buffer.getNumSamples();
+    const auto convolving = convolutionEnabled.load() && convolution.isReady();
+    const auto target = convolving ? 1.f : 0.f;
+    
+    // For as long as hosts are told about the convolution's latency, even while
+    // it loads or fades out, the two-band output is delayed to line up with it.
+    const auto latency = reportedLatency.load();
+    
+    if (latency != compensatedLatency)
+    {
+        // Both precisions, as the host may switch between them at any block.
+        floatCompensation.reset();
+        floatCompensation.setDelay((float) latency);
+        doubleCompensation.reset();
+        doubleCompensation.setDelay((double) latency);
+        compensatedLatency = latency;
+    }
+    
+    if (snapConvolutionMix)
+    {
+        convolutionMix.setCurrentAndTargetValue(target);
+        snapConvolutionMix = false;
+    }
+    else if (target != convolutionMix.getTargetValue())
+    {
+        // Whichever model fades in starts from a clean history.
+        if (convolving && convolutionMix.getCurrentValue() == 0.f)
+            convolution.reset();
+        
+        if (! convolving && convolutionMix.getCurrentValue() == 1.f)
+        {
+            engine.reset();
+            compensation.reset();
+        }
+        
+        convolutionMix.setTargetValue(target);
+    }
+    
+    const auto surround = engine.isSurround() && buffer.getNumChannels() >= engine.getNumSurroundChannels();
+    const auto inputs = buffer.getArrayOfReadPointers();
+    
+    if (! convolutionMix.isSmoothing() && convolutionMix.getCurrentValue() == 0.f)
+    {
+        if (surround)
+            engine.processSurround(inputs, buffer.getWritePointer(0), buffer.getWritePointer(1), buffer.getNumSamples());
+        else
+            engine.process(buffer.getWritePointer(0), buffer.getWritePointer(1), buffer.getNumSamples());
+        
+        if (compensatedLatency > 0)
+            compensate(buffer.getWritePointer(0), buffer.getWritePointer(1), buffer.getNumSamples(), compensation);
+        
+        timing.setPath(engine.getLastPath());
+    }
+    else
+    {
+        processConvolution(buffer, surround, engine, compensation);
+        timing.setPath(CrossfeedPath::convolution);
+    }
+    
+    convolutionFadedOut = ! convolving && ! convolutionMix.isSmoothing() && convolutionMix.getCurrentValue() == 0.f;
+}
 
-    juce::AudioBuffer<float> lowBandBuffer;
-    lowBandBuffer.makeCopyOf(buffer);
+template <typename SampleType>
+void CrossfeedAudioProcessor::processConvolution (juce::AudioBuffer<SampleType>& buffer, bool surround,
+                                                  CrossfeedEngine<SampleType>& engine, Compensation<SampleType>& compensation)
+{
+    const auto crossfade = convolutionMix.isSmoothing();
+    const auto numSamples = buffer.getNumSamples();
+    auto* left = buffer.getWritePointer(0);
+    auto* right = buffer.getWritePointer(1);
+    auto* l = convolutionBuffer.getWritePointer(0);
+    auto* r = convolutionBuffer.getWritePointer(1);
+    const SampleType* inputs[CrossfeedSurround<SampleType>::maxChannels] {};
     
-    auto ch1 = lowBandBuffer.getWritePointer(0);
-    auto ch2 = lowBandBuffer.getWritePointer(1);
-    for (int i = 0; i < samples; i++)
+    for (int offset = 0; offset < numSamples; offset += convolutionBuffer.getNumSamples())
     {
-        ch1[i] = lowPassFilter.processSample(ch1[i]);
-        ch2[i] = lowPassFilter.processSample(ch2[i]);
+        const auto length = juce::jmin(convolutionBuffer.getNumSamples(), numSamples - offset);
+        
+        // HRTF responses are for a stereo pair, so surround input is downmixed
+        // for them. The downmix leaves the surround state alone: while the
+        // models crossfade, the two-band side renders the same input.
+        if (surround)
+        {
+            for (int channel = 0; channel < engine.getNumSurroundChannels(); channel++)
+                inputs[channel] = buffer.getReadPointer(channel, offset);
+            
+            engine.mixSurround(inputs, l, r, length);
+        }
+        else
+        {
+            std::copy(left + offset, left + offset + length, l);
+            std::copy(right + offset, right + offset + length, r);
+        }
+        
+        // While the models crossfade both run, the two-band one in place and
+        // delayed as far as the convolution, so the two don't comb. It is the
+        // same rendering as without the convolution, surround included, so
+        // nothing jumps when the mix reaches either end.
+        if (crossfade)
+        {
+            if (surround)
+                engine.processSurround(inputs, left + offset, right + offset, length);
+            else
+                engine.process(left + offset, right + offset, length);
+            
+            if (compensatedLatency > 0)
+                compensate(left + offset, right + offset, length, compensation);
+        }
+        
+        convolution.process(l, r, length);
+        
+        for (int i = 0; i < length; i++)
+        {
+            const auto mix = static_cast<SampleType>(crossfade ? convolutionMix.getNextValue() : 1.f);
+            left[offset + i] += mix * (static_cast<SampleType>(l[i]) - left[offset + i]);
+            right[offset + i] += mix * (static_cast<SampleType>(r[i]) - right[offset + i]);
+        }
     }
+}
+
+template <typename SampleType>
+void CrossfeedAudioProcessor::compensate (SampleType* left, SampleType* right, int numSamples, Compensation<SampleType>& compensation) noexcept
+{
+    for (int i = 0; i < numSamples; i++)
+    {
+        compensation.pushSample(0, left[i]);
+        compensation.pushSample(1, right[i]);
+        left[i] = compensation.popSample(0);
+        right[i] = compensation.popSample(1);
+    }
+}
+
+//==============================================================================
+std::vector<CrossfeedSpeaker> CrossfeedAudioProcessor::getSurroundSpeakers (const juce::AudioChannelSet& layout)
+{
+    if (layout != juce::AudioChannelSet::create5point1()
+        && layout != juce::AudioChannelSet::create7point1()
+        && layout != juce::AudioChannelSet::create7point1point4())
+        return {};
     
-    juce::AudioBuffer<float> highBandBuffer;
-    highBandBuffer.makeCopyOf(buffer);
+    // Nominal positions from ITU-R BS.2051. As in the BS.775 downmix, everything
+    // but the front three goes in at -3 dB and the LFE channel is left out.
+    constexpr auto surroundGain = 0.70710678f;
+    std::vector<CrossfeedSpeaker> speakers;
     
-    ch1 = highBandBuffer.getWritePointer(0);
-    ch2 = highBandBuffer.getWritePointer(1);
-    for (int i = 0; i < samples; i++)
+    for (auto type : layout.getChannelTypes())
     {
-        ch1[i] = highPassFilter.processSample(ch1[i]);
-        ch2[i] = highPassFilter.processSample(ch2[i]);
+        switch (type)
+        {
+            case juce::AudioChannelSet::left:                   speakers.push_back({ -30.f,  0.f,  1.f }); break;
+            case juce::AudioChannelSet::right:                  speakers.push_back({ 30.f,   0.f,  1.f }); break;
+            case juce::AudioChannelSet::centre:                 speakers.push_back({ 0.f,    0.f,  1.f }); break;
+            case juce::AudioChannelSet::leftSurround:           speakers.push_back({ -110.f, 0.f,  surroundGain }); break;
+            case juce::AudioChannelSet::rightSurround:          speakers.push_back({ 110.f,  0.f,  surroundGain }); break;
+            case juce::AudioChannelSet::leftSurroundSide:       speakers.push_back({ -90.f,  0.f,  surroundGain }); break;
+            case juce::AudioChannelSet::rightSurroundSide:      speakers.push_back({ 90.f,   0.f,  surroundGain }); break;
+            case juce::AudioChannelSet::leftSurroundRear:       speakers.push_back({ -135.f, 0.f,  surroundGain }); break;
+            case juce::AudioChannelSet::rightSurroundRear:      speakers.push_back({ 135.f,  0.f,  surroundGain }); break;
+            case juce::AudioChannelSet::topFrontLeft:           speakers.push_back({ -45.f,  45.f, surroundGain }); break;
+            case juce::AudioChannelSet::topFrontRight:          speakers.push_back({ 45.f,   45.f, surroundGain }); break;
+            case juce::AudioChannelSet::topRearLeft:            speakers.push_back({ -135.f, 45.f, surroundGain }); break;
+            case juce::AudioChannelSet::topRearRight:           speakers.push_back({ 135.f,  45.f, surroundGain }); break;
+            default:                                            speakers.push_back({ 0.f,    0.f,  0.f }); break;
+        }
     }
+    
+    return speakers;
+}
 
-    float a = *amplitudeLow;
+//==============================================================================
+juce::Result CrossfeedAudioProcessor::loadImpulseResponse (const juce::File& file)
+{
+    {
+        juce::AudioFormatManager formats;
+        formats.registerBasicFormats();
+        std::unique_ptr<juce::AudioFormatReader> reader (formats.createReaderFor (file));
+        
+        if (reader == nullptr)
+            return juce::Result::fail("Cannot read " + file.getFullPathName());
+        
+        if (reader->numChannels != 2 && reader->numChannels != 4)
+            return juce::Result::fail(file.getFileName() + ": needs 2 or 4 channels");
+    }
     
-    ch1 = lowBandBuffer.getWritePointer(0);
-    ch2 = lowBandBuffer.getWritePointer(1);
-    for (int i = 0; i < samples; i++)
     {
-        delayLine1.pushSample(0, ch1[i]);
-        delayLine1.pushSample(1, ch2[i]);
-        ch1[i] = ch1[i] * (1.f - a) + delayLine1.popSample(1) * a;
-        ch2[i] = ch2[i] * (1.f - a) + delayLine1.popSample(0) * a;
+        const juce::ScopedLock lock (loaderLock);
+        impulseResponseFile = file;
+        startLoadingImpulseResponse();
     }
     
-    a = *amplitudeHigh;
+    // Until the responses are in, assume they are as long as they are allowed to be.
+    if (reportedLatency == 0)
+        impulseResponseSeconds = maxImpulseResponseSeconds;
+    
+    convolutionEnabled = true;
+    reportLatency(CrossfeedConvolution::getLatencySamples());
+    return juce::Result::ok();
+}
 
-    ch1 = highBandBuffer.getWritePointer(0);
-    ch2 = highBandBuffer.getWritePointer(1);
-    for (int i = 0; i < samples; i++)
+void CrossfeedAudioProcessor::clearImpulseResponse()
+{
     {
-        delayLine2.pushSample(0, ch1[i]);
-        delayLine2.pushSample(1, ch2[i]);
-        ch1[i] = ch1[i] * (1.f - a) + delayLine2.popSample(1) * a;
-        ch2[i] = ch2[i] * (1.f - a) + delayLine2.popSample(0) * a;
+        const juce::ScopedLock lock (loaderLock);
+        impulseResponseFile = juce::File();
+        impulseResponseError = {};
+        loadGeneration++;
     }
     
-    buffer.clear();
-    buffer.addFrom(0, 0, lowBandBuffer, 0, 0, samples);
-    buffer.addFrom(0, 0, highBandBuffer, 0, 0, samples);
-    buffer.addFrom(1, 0, lowBandBuffer, 1, 0, samples);
-    buffer.addFrom(1, 0, highBandBuffer, 1, 0, samples);
+    // The convolution fades out from the next block on; the latency goes once
+    // the audio thread reports that it has.
+    convolutionEnabled = false;
+    startTimer(20);
+}
+
+juce::File CrossfeedAudioProcessor::getImpulseResponseFile() const
+{
+    const juce::ScopedLock lock (loaderLock);
+    return impulseResponseFile;
+}
+
+juce::String CrossfeedAudioProcessor::getImpulseResponseError() const
+{
+    const juce::ScopedLock lock (loaderLock);
+    return impulseResponseError;
+}
+
+bool CrossfeedAudioProcessor::isLoadingImpulseResponse() const
+{
+    return loader.getNumJobs() > 0;
+}
+
+void CrossfeedAudioProcessor::startLoadingImpulseResponse()
+{
+    // Called with loaderLock held. A job that finds a newer generation drops its result.
+    const auto generation = ++loadGeneration;
+    const auto file = impulseResponseFile;
+    const auto rate = sampleRate > 0 ? (double) sampleRate : 44100.0;
+    
+    impulseResponseError = {};
+    
+    loader.addJob([this, file, rate, generation]
+    {
+        juce::String error;
+        auto responses = CrossfeedConvolution::readResponses(file, rate, juce::roundToInt(rate * maxImpulseResponseSeconds), error);
+        
+        std::unique_ptr<CrossfeedConvolution::Filter> filter;
+        
+        if (error.isEmpty())
+            filter = std::make_unique<CrossfeedConvolution::Filter>(responses);
+        
+        const juce::ScopedLock lock (loaderLock);
+        
+        if (generation != loadGeneration)
+            return;
+        
+        impulseResponseError = error;
+        
+        if (filter != nullptr)
+        {
+            impulseResponseSeconds = responses.getNumSamples() / rate;
+            convolution.setFilter(std::move(filter));
+        }
+    });
+}
+
+void CrossfeedAudioProcessor::reportLatency (int samples)
+{
+    reportedLatency = samples;
+    setLatencySamples(samples);
+}
+
+void CrossfeedAudioProcessor::timerCallback()
+{
+    // Running after clearImpulseResponse, until the convolution has faded out or is back.
+    if (! convolutionEnabled && convolutionFadedOut)
+        reportLatency(0);
+    
+    if (convolutionEnabled || reportedLatency == 0)
+        stopTimer();
+}
+
+void CrossfeedAudioProcessor::parameterValueChanged (int parameterIndex, float newValue)
+{
+    // Called on whichever thread changed the parameter, the audio thread included.
+    static float CrossfeedParameterSnapshot::* const members[] = {
+        &CrossfeedParameterSnapshot::amplitudeLow,
+        &CrossfeedParameterSnapshot::amplitudeHigh,
+        &CrossfeedParameterSnapshot::delayLow,
+        &CrossfeedParameterSnapshot::delayHigh,
+        &CrossfeedParameterSnapshot::crossoverFrequency
+    };
+    
+    if (! juce::isPositiveAndBelow (parameterIndex, juce::numElementsInArray (members)))
+        return;
+    
+    if (auto* parameter = dynamic_cast<juce::AudioParameterFloat*> (getParameters()[parameterIndex]))
+        parameterStore.publish(members[parameterIndex], parameter->convertFrom0to1(newValue));
 }
 
 //==============================================================================
@@ -241,6 +528,7 @@ void CrossfeedAudioProcessor::getStateInformation (juce::MemoryBlock& destData)
     xml->setAttribute ("delayLow", (double) *delayLow);
     xml->setAttribute ("delayHigh", (double) *delayHigh);
     xml->setAttribute ("crossoverFrequency", (double) *crossoverFrequency);
+    xml->setAttribute ("impulseResponse", getImpulseResponseFile().getFullPathName());
     copyXmlToBinary (*xml, destData);
 }
 
@@ -253,11 +541,30 @@ void CrossfeedAudioProcessor::setStateInformation (const void* data, int sizeInB
     if (xmlState.get() != nullptr)
         if (xmlState->hasTagName ("CrossfeedParameter"))
         {
-            *amplitudeLow = (float) xmlState->getDoubleAttribute ("amplitudeLow", *amplitudeLow);
-            *amplitudeHigh = (float) xmlState->getDoubleAttribute ("amplitudeHigh", *amplitudeHigh);
-            *delayLow = (float) xmlState->getDoubleAttribute ("delayLow", *delayLow);
-            *delayHigh = (float) xmlState->getDoubleAttribute ("delayHigh", *delayHigh);
-            *crossoverFrequency = (float) xmlState->getDoubleAttribute ("crossoverFrequency", *crossoverFrequency);
+            CrossfeedParameterSnapshot state;
+            state.amplitudeLow = amplitudeLow->range.snapToLegalValue ((float) xmlState->getDoubleAttribute ("amplitudeLow", *amplitudeLow));
+            state.amplitudeHigh = amplitudeHigh->range.snapToLegalValue ((float) xmlState->getDoubleAttribute ("amplitudeHigh", *amplitudeHigh));
+            state.delayLow = delayLow->range.snapToLegalValue ((float) xmlState->getDoubleAttribute ("delayLow", *delayLow));
+            state.delayHigh = delayHigh->range.snapToLegalValue ((float) xmlState->getDoubleAttribute ("delayHigh", *delayHigh));
+            state.crossoverFrequency = crossoverFrequency->range.snapToLegalValue ((float) xmlState->getDoubleAttribute ("crossoverFrequency", *crossoverFrequency));
+            
+            // The audio thread gets the whole preset in one go; the parameters
+            // follow for the host and the editor, each re-publishing a value
+            // the snapshot already holds.
+            parameterStore.publish (state);
+            
+            *amplitudeLow = state.amplitudeLow;
+            *amplitudeHigh = state.amplitudeHigh;
+            *delayLow = state.delayLow;
+            *delayHigh = state.delayHigh;
+            *crossoverFrequency = state.crossoverFrequency;
+            
+            const auto path = xmlState->getStringAttribute ("impulseResponse");
+            
+            if (! juce::File::isAbsolutePath (path))
+                clearImpulseResponse();
+            else if (juce::File (path) != getImpulseResponseFile())
+                loadImpulseResponse (juce::File (path));
         }
 }
 
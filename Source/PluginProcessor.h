@@ -9,11 +9,17 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "CrossfeedConvolution.h"
+#include "CrossfeedEngine.h"
+#include "CrossfeedParameters.h"
+#include "CrossfeedPerformance.h"
 
 //==============================================================================
 /**
 */
-class CrossfeedAudioProcessor  : public juce::AudioProcessor
+class CrossfeedAudioProcessor  : public juce::AudioProcessor,
+                                 private juce::AudioProcessorParameter::Listener,
+                                 private juce::Timer
                             #if JucePlugin_Enable_ARA
                              , public juce::AudioProcessorARAExtension
                             #endif
@@ -38,6 +44,9 @@ public:
    #endif
 
     void processBlock (juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
+    void processBlock (juce::AudioBuffer<double>&, juce::MidiBuffer&) override;
+
+    bool supportsDoublePrecisionProcessing() const override;
 
     //==============================================================================
     juce::AudioProcessorEditor* createEditor() override;
@@ -51,6 +60,9 @@ public:
     bool isMidiEffect() const override;
     double getTailLengthSeconds() const override;
 
+    /** The level, relative to the signal, below which the tail counts as over (-120 dB). */
+    static constexpr double tailTolerance = 1.0e-6;
+
     //==============================================================================
     int getNumPrograms() override;
     int getCurrentProgram() override;
@@ -62,13 +74,96 @@ public:
     void getStateInformation (juce::MemoryBlock& destData) override;
     void setStateInformation (const void* data, int sizeInBytes) override;
 
+    //==============================================================================
+    /** Switches to HRTF mode with measured responses from a file (see
+        CrossfeedConvolution::readResponses). The file is checked here and loaded
+        on a background thread; the output crossfades once it is ready.
+    */
+    juce::Result loadImpulseResponse (const juce::File&);
+
+    /** Back to the two-band model. The convolution's latency is still reported
+        until it has faded out, as the two-band output stays delayed to match.
+    */
+    void clearImpulseResponse();
+
+    juce::File getImpulseResponseFile() const;
+    juce::String getImpulseResponseError() const;
+    bool isLoadingImpulseResponse() const;
+
+    //==============================================================================
+    /** Speaker positions and downmix gains for the surround input layouts
+        (5.1, 7.1 and 7.1.4), one per channel; empty for any other layout.
+    */
+    static std::vector<CrossfeedSpeaker> getSurroundSpeakers (const juce::AudioChannelSet&);
+
+    //==============================================================================
+    /** Block timings published by the audio thread; see CrossfeedPerformanceStats. */
+    CrossfeedPerformanceMonitor& getPerformanceMonitor() noexcept { return performance; }
+
+    /** The parameter values the audio thread picked up for its last block; only
+        meaningful on the audio thread, or while processing is stopped.
+    */
+    const CrossfeedParameterSnapshot& getProcessedParameters() const noexcept { return parameterStore.getLastRead(); }
+
 private:
-    juce::dsp::DelayLine<float, juce::dsp::DelayLineInterpolationTypes::Linear> delayLine1;
-    juce::dsp::DelayLine<float, juce::dsp::DelayLineInterpolationTypes::Linear> delayLine2;
-    juce::dsp::IIR::Filter<float> lowPassFilter;
-    juce::dsp::IIR::Filter<float> highPassFilter;
+    /** Delays the two-band output by the convolution's latency while it is reported. */
+    template <typename SampleType>
+    using Compensation = juce::dsp::DelayLine<SampleType, juce::dsp::DelayLineInterpolationTypes::None>;
+
+    template <typename SampleType>
+    void process (juce::AudioBuffer<SampleType>& buffer, CrossfeedEngine<SampleType>& engine, Compensation<SampleType>& compensation);
+
+    //==============================================================================
+    void parameterValueChanged (int parameterIndex, float newValue) override;
+    void parameterGestureChanged (int, bool) override {}
+
+    /** The audio thread's view of the parameters, one snapshot per block. */
+    CrossfeedParameterStore parameterStore;
+
+    template <typename SampleType>
+    void processConvolution (juce::AudioBuffer<SampleType>& buffer, bool surround,
+                             CrossfeedEngine<SampleType>& engine, Compensation<SampleType>& compensation);
+
+    template <typename SampleType>
+    static void compensate (SampleType* left, SampleType* right, int numSamples, Compensation<SampleType>& compensation) noexcept;
+
+    void startLoadingImpulseResponse();
+    void reportLatency (int samples);
+    void timerCallback() override;
+
+    CrossfeedEngine<float> floatEngine;
+    CrossfeedEngine<double> doubleEngine;
+    CrossfeedPerformanceMonitor performance;
     
-    int sampleRate;
+    int sampleRate = 0;
+
+    //==============================================================================
+    // HRTF mode. The convolution runs in float for either processing precision.
+    static constexpr double maxImpulseResponseSeconds = 1.0;
+
+    CrossfeedConvolution convolution;
+    juce::AudioBuffer<float> convolutionBuffer;
+    juce::SmoothedValue<float> convolutionMix;
+    bool snapConvolutionMix = true;
+    std::atomic<bool> convolutionEnabled { false };
+
+    // The latency hosts were told about, and the length of the responses that
+    // add to the tail while it is non-zero. Both change on the message thread.
+    std::atomic<int> reportedLatency { 0 };
+    std::atomic<double> impulseResponseSeconds { 0.0 };
+
+    // Set by the audio thread once the two-band model is back on its own.
+    std::atomic<bool> convolutionFadedOut { true };
+
+    Compensation<float> floatCompensation { CrossfeedConvolution::getLatencySamples() };
+    Compensation<double> doubleCompensation { CrossfeedConvolution::getLatencySamples() };
+    int compensatedLatency = 0;
+
+    juce::CriticalSection loaderLock;
+    juce::File impulseResponseFile;
+    juce::String impulseResponseError;
+    int loadGeneration = 0;
+    juce::ThreadPool loader { 1 };
 
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (CrossfeedAudioProcessor)
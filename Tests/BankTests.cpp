@@ -0,0 +1,109 @@
+/*
+  ==============================================================================
+
+    CrossfeedBank: every stream against a CrossfeedKernel of its own.
+
+  ==============================================================================
+*/
+
+#include "CrossfeedBank.h"
+#include "CrossfeedTest.h"
+#include <cmath>
+
+//==============================================================================
+class BankTests  : public CrossfeedTest
+{
+public:
+    BankTests() : CrossfeedTest ("bank") {}
+
+    void runTest() override
+    {
+        beginTest ("Streams match separate kernels, float");
+        expectEquivalent<float>();
+
+        beginTest ("Streams match separate kernels, double");
+        expectEquivalent<double>();
+    }
+
+private:
+    //==============================================================================
+    static constexpr double sampleRate = 48000.0;
+    static constexpr int numStreams = 7;
+    static constexpr int numBlocks = 400;
+
+    /** Different settings per stream, changing every so often so that they ramp. */
+    static CrossfeedParameterSnapshot getParameters (int stream, int block) noexcept
+    {
+        const auto step = static_cast<float> ((block / 50 + stream) % 4);
+        return { .75f - .2f * step, step == 3.f ? 0.f : .1f, 100.f + 150.f * step, 50.f * step, 500.f + 700.f * step };
+    }
+
+    template <typename SampleType>
+    void expectEquivalent()
+    {
+        constexpr double tolerance = 1.0e-6;
+        static constexpr int sizes[] = { 1, 7, 64, 333, 512, 31, 32, 100 };
+
+        CrossfeedBank<SampleType> bank;
+        bank.prepare (sampleRate, numStreams);
+
+        std::vector<CrossfeedKernel<SampleType>> kernels (numStreams);
+        std::vector<std::vector<SampleType>> bankBuffers (2 * numStreams, std::vector<SampleType> (512));
+        std::vector<std::vector<SampleType>> kernelBuffers (2 * numStreams, std::vector<SampleType> (512));
+        std::vector<SampleType*> left (numStreams), right (numStreams);
+
+        for (auto& kernel : kernels)
+            kernel.prepare (sampleRate);
+
+        unsigned seed = 1;
+        double largest = 0.0;
+
+        for (int block = 0; block < numBlocks; block++)
+        {
+            const auto n = sizes[block % 8];
+
+            for (int stream = 0; stream < numStreams; stream++)
+            {
+                const auto s = static_cast<size_t> (stream);
+                const auto parameters = getParameters (stream, block);
+
+                bank.setParameters (stream, parameters);
+
+                // The kernel in its own units: delays in samples.
+                kernels[s].setParameters (static_cast<SampleType> (parameters.crossoverFrequency),
+                                          static_cast<SampleType> (sampleRate * (parameters.delayLow / 1000.f / 1000.f)),
+                                          static_cast<SampleType> (sampleRate * (parameters.delayHigh / 1000.f / 1000.f)),
+                                          static_cast<SampleType> (parameters.amplitudeLow),
+                                          static_cast<SampleType> (parameters.amplitudeHigh));
+
+                // Stream 0 goes quiet now and then, so its idle handling is compared too.
+                const auto silent = stream == 0 && block % 100 >= 60;
+
+                for (int i = 0; i < n; i++)
+                {
+                    for (size_t channel = 0; channel < 2; channel++)
+                    {
+                        seed = seed * 1664525u + 1013904223u;
+                        const auto x = silent ? SampleType() : static_cast<SampleType> (static_cast<int> (seed >> 8) - (1 << 23)) / (SampleType) (1 << 24);
+                        bankBuffers[2 * s + channel][(size_t) i] = kernelBuffers[2 * s + channel][(size_t) i] = x;
+                    }
+                }
+
+                left[s] = bankBuffers[2 * s].data();
+                right[s] = bankBuffers[2 * s + 1].data();
+                kernels[s].process (kernelBuffers[2 * s].data(), kernelBuffers[2 * s + 1].data(), n);
+            }
+
+            bank.process (left.data(), right.data(), n);
+
+            for (size_t buffer = 0; buffer < bankBuffers.size(); buffer++)
+                for (int i = 0; i < n; i++)
+                    largest = std::max (largest, std::abs (static_cast<double> (bankBuffers[buffer][(size_t) i] - kernelBuffers[buffer][(size_t) i])));
+        }
+
+        expectWithinAbsoluteError (largest, 0.0, tolerance, "largest difference");
+        expect (bank.isIdle (0) == kernels[0].isIdle(), "stream 0 idles with its kernel");
+    }
+};
+
+static BankTests bankTests;
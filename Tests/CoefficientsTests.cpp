@@ -0,0 +1,147 @@
+/*
+  ==============================================================================
+
+    CrossfeedCoefficients: parameter ramps and the crossover limit.
+
+  ==============================================================================
+*/
+
+#include "CrossfeedEngine.h"
+#include "CrossfeedTest.h"
+#include <cmath>
+
+//==============================================================================
+class CoefficientsTests  : public CrossfeedTest
+{
+public:
+    CoefficientsTests() : CrossfeedTest ("coefficients") {}
+
+    void runTest() override
+    {
+        beginTest ("Parameter changes are ramped, float");
+        expectContinuous<float>();
+
+        beginTest ("Parameter changes are ramped, double");
+        expectContinuous<double>();
+
+        beginTest ("The crossover is limited below Nyquist");
+        {
+            for (const auto rate : { 8000.0, 22050.0, 32000.0, 40000.0 })
+            {
+                const auto name = std::to_string (static_cast<int> (rate)) + " Hz: ";
+                const auto limit = CrossfeedCoefficients<double>::limitCrossoverFrequency (rate, 20000.0);
+                expect (limit < rate / 2, name + "limit " + std::to_string (limit));
+
+                const auto settling = CrossfeedCoefficients<double>::getSettlingSamples (rate, 20000.0, 1.0e-6);
+                expect (settling > 0 && settling < 1000, name + "settling " + std::to_string (settling));
+
+                expectStable<float> (rate, name + "float");
+                expectStable<double> (rate, name + "double");
+            }
+        }
+    }
+
+private:
+    //==============================================================================
+    static constexpr double sampleRate = 48000.0;
+
+    /** A 50 Hz sine on the left and its cosine on the right: the output can only
+        move by so much from one sample to the next unless a parameter steps.
+    */
+    template <typename SampleType>
+    static void fill (SampleType* left, SampleType* right, int numSamples, int& position)
+    {
+        const auto omega = 2.0 * CrossfeedCoefficients<double>::pi * 50.0 / sampleRate;
+
+        for (int i = 0; i < numSamples; i++, position++)
+        {
+            left[i] = static_cast<SampleType> (std::sin (omega * position));
+            right[i] = static_cast<SampleType> (std::cos (omega * position));
+        }
+    }
+
+    template <typename SampleType>
+    void expectContinuous()
+    {
+        // Every path, and switches between them.
+        const CrossfeedParameterSnapshot settings[] = { { .75f, .1f, 250.f, 100.f, 2000.f },    // general
+                                                        { .75f, 0.f, 250.f, 100.f, 300.f },     // noHighCrossfeed
+                                                        { .75f, .1f, 0.f,   0.f,   5000.f },    // noDelay
+                                                        { 0.f,  0.f, 250.f, 100.f, 700.f },     // bypass
+                                                        { .75f, 0.f, 0.f,   0.f,   300.f },
+                                                        { 0.f,  .1f, 900.f, 0.f,   2000.f } };
+
+        static constexpr int sizes[] = { 1, 7, 64, 333, 512, 31, 32, 100 };
+
+        CrossfeedEngine<SampleType> engine;
+        engine.prepare (sampleRate);
+
+        std::vector<SampleType> left (512), right (512);
+        SampleType previousLeft {}, previousRight {};
+        double largestStep = 0.0;
+        int position = 0;
+
+        for (int block = 0; block < 3000; block++)
+        {
+            engine.setParameters (settings[static_cast<size_t> (block / 40) % std::size (settings)]);
+
+            const auto n = sizes[block % 8];
+            fill (left.data(), right.data(), n, position);
+            engine.process (left.data(), right.data(), n);
+
+            for (int i = 0; i < n; i++)
+            {
+                // The first setting is applied at once; only the switches after it are measured.
+                if (block >= 40)
+                    largestStep = std::max ({ largestStep,
+                                              std::abs (static_cast<double> (left[(size_t) i] - previousLeft)),
+                                              std::abs (static_cast<double> (right[(size_t) i] - previousRight)) });
+
+                previousLeft = left[(size_t) i];
+                previousRight = right[(size_t) i];
+            }
+        }
+
+        // The sine moves by at most 2 pi 50 / 48000 = 0.0065 per sample, and
+        // crossfeed adds at most three quarters of that again; a step in the
+        // low band gain would be a hundred times more.
+        expect (largestStep < .03, "largest step " + std::to_string (largestStep));
+    }
+
+    /** Noise through crossovers ramping up to and past Nyquist stays finite and bounded. */
+    template <typename SampleType>
+    void expectStable (double rate, const std::string& name)
+    {
+        CrossfeedEngine<SampleType> engine;
+        engine.prepare (rate);
+
+        const auto tail = engine.getTailSamples (20000.0, 1.0e-6);
+        expect (tail > 0 && tail < static_cast<int> (rate), name + ": tail " + std::to_string (tail));
+
+        std::vector<SampleType> left (256), right (256);
+        unsigned seed = 1;
+        double peak = 0.0;
+
+        for (int block = 0; block < 400; block++)
+        {
+            engine.setParameters ({ .75f, .1f, 250.f, 100.f, block % 100 < 50 ? 20000.f : 700.f });
+
+            for (size_t i = 0; i < left.size(); i++)
+            {
+                seed = seed * 1664525u + 1013904223u;
+                left[i] = static_cast<SampleType> (static_cast<int> (seed >> 8) - (1 << 23)) / (SampleType) (1 << 23);
+                right[i] = -left[i];
+            }
+
+            engine.process (left.data(), right.data(), static_cast<int> (left.size()));
+
+            for (size_t i = 0; i < left.size(); i++)
+                peak = std::max ({ peak, std::abs (static_cast<double> (left[i])), std::abs (static_cast<double> (right[i])) });
+        }
+
+        // NaN fails the comparison too.
+        expect (peak < 4.0, name + ": peak " + std::to_string (peak));
+    }
+};
+
+static CoefficientsTests coefficientsTests;
@@ -0,0 +1,170 @@
+/*
+  ==============================================================================
+
+    Allocation and lock detection for code that runs on the audio thread.
+
+  ==============================================================================
+*/
+
+#include "CrossfeedRealtimeGuard.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+#if defined (__linux__)
+ #include <dlfcn.h>
+ #include <pthread.h>
+ #define CROSSFEED_INTERPOSE_LOCKS 1
+#endif
+
+//==============================================================================
+namespace
+{
+    // Plain thread-locals, so reading them neither allocates nor locks.
+    thread_local bool armed = false;
+    thread_local int allocations = 0, deallocations = 0, locks = 0;
+
+    void* allocate (std::size_t size, std::size_t alignment = 0)
+    {
+        if (armed)
+            allocations++;
+
+        if (alignment <= alignof (std::max_align_t))
+        {
+            if (auto* p = std::malloc (size == 0 ? 1 : size))
+                return p;
+
+            throw std::bad_alloc();
+        }
+
+        // Over-aligned: the block malloc returned is kept just below the aligned one.
+        auto* block = static_cast<char*> (std::malloc (size + alignment + sizeof (void*)));
+
+        if (block == nullptr)
+            throw std::bad_alloc();
+
+        const auto address = reinterpret_cast<std::uintptr_t> (block + sizeof (void*));
+        auto* aligned = block + sizeof (void*) + (alignment - address % alignment) % alignment;
+        reinterpret_cast<void**> (aligned)[-1] = block;
+        return aligned;
+    }
+
+    void* allocate (std::size_t size, std::size_t alignment, const std::nothrow_t&) noexcept
+    {
+        try
+        {
+            return allocate (size, alignment);
+        }
+        catch (const std::bad_alloc&)
+        {
+            return nullptr;
+        }
+    }
+
+    void deallocate (void* p, bool overAligned = false) noexcept
+    {
+        if (p == nullptr)
+            return;
+
+        if (armed)
+            deallocations++;
+
+        std::free (overAligned ? reinterpret_cast<void**> (p)[-1] : p);
+    }
+
+    void deallocate (void* p, std::align_val_t alignment) noexcept
+    {
+        deallocate (p, static_cast<std::size_t> (alignment) > alignof (std::max_align_t));
+    }
+}
+
+//==============================================================================
+// Every form of the global allocation functions, so that each delete matches its new.
+void* operator new (std::size_t size)                                           { return allocate (size); }
+void* operator new[] (std::size_t size)                                         { return allocate (size); }
+void* operator new (std::size_t size, std::align_val_t a)                       { return allocate (size, static_cast<std::size_t> (a)); }
+void* operator new[] (std::size_t size, std::align_val_t a)                     { return allocate (size, static_cast<std::size_t> (a)); }
+void* operator new (std::size_t size, const std::nothrow_t& t) noexcept        { return allocate (size, 0, t); }
+void* operator new[] (std::size_t size, const std::nothrow_t& t) noexcept      { return allocate (size, 0, t); }
+void* operator new (std::size_t size, std::align_val_t a, const std::nothrow_t& t) noexcept     { return allocate (size, static_cast<std::size_t> (a), t); }
+void* operator new[] (std::size_t size, std::align_val_t a, const std::nothrow_t& t) noexcept   { return allocate (size, static_cast<std::size_t> (a), t); }
+
+void operator delete (void* p) noexcept                                         { deallocate (p); }
+void operator delete[] (void* p) noexcept                                       { deallocate (p); }
+void operator delete (void* p, std::size_t) noexcept                            { deallocate (p); }
+void operator delete[] (void* p, std::size_t) noexcept                          { deallocate (p); }
+void operator delete (void* p, std::align_val_t a) noexcept                     { deallocate (p, a); }
+void operator delete[] (void* p, std::align_val_t a) noexcept                   { deallocate (p, a); }
+void operator delete (void* p, std::size_t, std::align_val_t a) noexcept        { deallocate (p, a); }
+void operator delete[] (void* p, std::size_t, std::align_val_t a) noexcept      { deallocate (p, a); }
+void operator delete (void* p, const std::nothrow_t&) noexcept                  { deallocate (p); }
+void operator delete[] (void* p, const std::nothrow_t&) noexcept                { deallocate (p); }
+void operator delete (void* p, std::align_val_t a, const std::nothrow_t&) noexcept      { deallocate (p, a); }
+void operator delete[] (void* p, std::align_val_t a, const std::nothrow_t&) noexcept    { deallocate (p, a); }
+
+//==============================================================================
+#if CROSSFEED_INTERPOSE_LOCKS
+namespace
+{
+    using MutexFunction = int (pthread_mutex_t*);
+
+    /** The C library's own function, looked up on first use. */
+    MutexFunction* findNext (std::atomic<MutexFunction*>& cache, const char* name) noexcept
+    {
+        auto* function = cache.load (std::memory_order_relaxed);
+
+        if (function == nullptr)
+        {
+            function = reinterpret_cast<MutexFunction*> (dlsym (RTLD_NEXT, name));
+            cache.store (function, std::memory_order_relaxed);
+        }
+
+        return function;
+    }
+
+    std::atomic<MutexFunction*> nextLock { nullptr }, nextTryLock { nullptr };
+}
+
+extern "C" int pthread_mutex_lock (pthread_mutex_t* mutex) noexcept
+{
+    if (armed)
+        locks++;
+
+    return findNext (nextLock, "pthread_mutex_lock") (mutex);
+}
+
+extern "C" int pthread_mutex_trylock (pthread_mutex_t* mutex) noexcept
+{
+    if (armed)
+        locks++;
+
+    return findNext (nextTryLock, "pthread_mutex_trylock") (mutex);
+}
+#endif
+
+//==============================================================================
+CrossfeedRealtimeGuard::CrossfeedRealtimeGuard() noexcept
+    : startAllocations (allocations), startDeallocations (deallocations), startLocks (locks), wasArmed (armed)
+{
+    armed = true;
+}
+
+CrossfeedRealtimeGuard::~CrossfeedRealtimeGuard()
+{
+    armed = wasArmed;
+}
+
+int CrossfeedRealtimeGuard::getNumAllocations() const noexcept      { return allocations - startAllocations; }
+int CrossfeedRealtimeGuard::getNumDeallocations() const noexcept    { return deallocations - startDeallocations; }
+int CrossfeedRealtimeGuard::getNumLocks() const noexcept            { return locks - startLocks; }
+
+bool CrossfeedRealtimeGuard::canDetectLocks() noexcept
+{
+   #if CROSSFEED_INTERPOSE_LOCKS
+    return true;
+   #else
+    return false;
+   #endif
+}
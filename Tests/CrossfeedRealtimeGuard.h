@@ -0,0 +1,44 @@
+/*
+  ==============================================================================
+
+    Allocation and lock detection for code that runs on the audio thread.
+
+    The test programs replace the global allocation functions and, on Linux,
+    interpose pthread_mutex_lock and pthread_mutex_trylock, which is where
+    std::mutex and juce::CriticalSection end up. Calls are only counted on a
+    thread while a CrossfeedRealtimeGuard is alive on it, so a loader thread
+    or the test itself can allocate freely while the audio thread is watched.
+
+    Spin locks never reach the system and are not seen; code that must not
+    wait on another thread should not use them either.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+//==============================================================================
+/**
+    Counts the allocations, deallocations and mutex locks made by the calling
+    thread from construction onwards.
+*/
+class CrossfeedRealtimeGuard
+{
+public:
+    CrossfeedRealtimeGuard() noexcept;
+    ~CrossfeedRealtimeGuard();
+
+    int getNumAllocations() const noexcept;
+    int getNumDeallocations() const noexcept;
+    int getNumLocks() const noexcept;
+
+    /** False where mutex locks cannot be intercepted; getNumLocks() is then always 0. */
+    static bool canDetectLocks() noexcept;
+
+private:
+    int startAllocations, startDeallocations, startLocks;
+    bool wasArmed;
+
+    CrossfeedRealtimeGuard (const CrossfeedRealtimeGuard&) = delete;
+    CrossfeedRealtimeGuard& operator= (const CrossfeedRealtimeGuard&) = delete;
+};
@@ -0,0 +1,132 @@
+/*
+  ==============================================================================
+
+    A small test harness in the style of juce::UnitTest.
+
+    The DSP core builds without JUCE, and so do its tests. Each test is a
+    CrossfeedTest subclass with one static instance, which registers itself.
+    A test program runs every registered test, or only the one named on the
+    command line, and exits with the number of failed checks, so every test
+    can be its own ctest entry.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+//==============================================================================
+/**
+*/
+class CrossfeedTest
+{
+public:
+    explicit CrossfeedTest (const char* testName) : name (testName)
+    {
+        getAllTests().push_back (this);
+    }
+
+    virtual ~CrossfeedTest() = default;
+
+    const char* getName() const noexcept     { return name; }
+
+    /** Runs the checks; report each group of them with beginTest(). */
+    virtual void runTest() = 0;
+
+    //==============================================================================
+    /** Runs the test named by the first argument, or all of them without one.
+        Returns the number of failed checks.
+    */
+    static int runAll (int argc, char* argv[])
+    {
+        const char* filter = argc > 1 ? argv[1] : nullptr;
+        auto failures = 0, numRun = 0;
+
+        for (auto* test : getAllTests())
+        {
+            if (filter != nullptr && std::strcmp (filter, test->getName()) != 0)
+                continue;
+
+            std::printf ("%s\n", test->getName());
+            test->runTest();
+            failures += test->failures;
+            numRun++;
+        }
+
+        if (numRun == 0)
+        {
+            std::fprintf (stderr, "No test called %s\n", filter != nullptr ? filter : "");
+            return 1;
+        }
+
+        std::printf (failures == 0 ? "All checks passed\n" : "%d checks failed\n", failures);
+        return failures;
+    }
+
+protected:
+    //==============================================================================
+    void beginTest (const std::string& testName)
+    {
+        currentTest = testName;
+        std::printf ("  %s\n", currentTest.c_str());
+    }
+
+    void expect (bool result, const std::string& failureMessage = {})
+    {
+        if (result)
+            return;
+
+        failures++;
+        std::fprintf (stderr, "FAILED: %s / %s%s%s\n", name, currentTest.c_str(),
+                      failureMessage.empty() ? "" : ": ", failureMessage.c_str());
+    }
+
+    template <typename ValueType>
+    void expectEquals (ValueType actual, ValueType expected, const std::string& failureMessage = {})
+    {
+        expect (actual == expected, failureMessage + describe (" expected ", expected) + describe (", got ", actual));
+    }
+
+    template <typename ValueType>
+    void expectWithinAbsoluteError (ValueType actual, ValueType expected, ValueType maxError,
+                                    const std::string& failureMessage = {})
+    {
+        // Also fails for NaN.
+        expect (std::abs (actual - expected) <= maxError,
+                failureMessage + describe (" expected ", expected) + describe (", got ", actual)
+                    + describe (", allowed error ", maxError));
+    }
+
+private:
+    //==============================================================================
+    static std::vector<CrossfeedTest*>& getAllTests()
+    {
+        static std::vector<CrossfeedTest*> tests;
+        return tests;
+    }
+
+    template <typename ValueType>
+    static std::string describe (const char* label, ValueType value)
+    {
+        if constexpr (std::is_floating_point_v<ValueType>)
+        {
+            char text[64];
+            std::snprintf (text, sizeof (text), "%.9g", static_cast<double> (value));
+            return label + std::string (text);
+        }
+        else
+        {
+            return label + std::to_string (value);
+        }
+    }
+
+    const char* name;
+    std::string currentTest;
+    int failures = 0;
+};
@@ -0,0 +1,117 @@
+/*
+  ==============================================================================
+
+    CrossfeedDelay: the three interpolators against the exact delayed signal.
+
+  ==============================================================================
+*/
+
+#include "CrossfeedDelay.h"
+#include "CrossfeedSIMD.h"
+#include "CrossfeedTest.h"
+#include <cmath>
+
+//==============================================================================
+class DelayTests  : public CrossfeedTest
+{
+public:
+    DelayTests() : CrossfeedTest ("delay") {}
+
+    void runTest() override
+    {
+        using namespace CrossfeedInterpolationTypes;
+
+        // Linear interpolation is off by about omega^2 f (1 - f) / 2 at this
+        // frequency, the allpass has a small phase error; Lagrange is close to
+        // exact. Whole-sample delays are exact in every case.
+        runInterpolator<Linear> ("Linear", 6.0e-4);
+        runInterpolator<Lagrange3rd> ("Lagrange", 1.0e-5);
+        runInterpolator<Thiran> ("Thiran", 1.0e-4);
+    }
+
+private:
+    //==============================================================================
+    static constexpr double omega = 2.0 * 3.141592653589793238 * 500.0 / 48000.0;
+    static constexpr int blockSize = 32;
+    static constexpr int maxDelay = 48;
+
+    /** The input lanes: four sines a quarter of a period apart. */
+    static double input (int lane, double time) noexcept
+    {
+        return std::sin (omega * time + lane * 3.141592653589793238 / 2);
+    }
+
+    template <typename Interpolation>
+    void runInterpolator (const std::string& name, double tolerance)
+    {
+        beginTest (name + ", float");
+        runDelays<float, typename CrossfeedLanes<float>::Type, Interpolation> (tolerance + 1.0e-5);
+        runDelays<float, CrossfeedScalarLanes<float>, Interpolation> (tolerance + 1.0e-5);
+
+        beginTest (name + ", double");
+        runDelays<double, typename CrossfeedLanes<double>::Type, Interpolation> (tolerance);
+        runDelays<double, CrossfeedScalarLanes<double>, Interpolation> (tolerance);
+    }
+
+    template <typename SampleType, typename Lanes, typename Interpolation>
+    void runDelays (double tolerance)
+    {
+        for (const auto delay : { 0.0, 1.0, 7.0, 0.25, 3.5, 12.75, 20.1, 47.9 })
+        {
+            const auto fractional = delay != std::floor (delay);
+            const auto error = measure<SampleType, Lanes, Interpolation> (delay, delay);
+            const auto maxError = fractional ? tolerance : 0.0;
+
+            expect (error <= maxError, "delay " + std::to_string (delay) + ": error " + std::to_string (error));
+        }
+
+        // The bands are read with their own delays.
+        const auto error = measure<SampleType, Lanes, Interpolation> (10.0, 3.0);
+        expect (error == 0.0, "separate band delays: error " + std::to_string (error));
+    }
+
+    /** Largest difference between what comes out of each lane and the
+        opposite channel's input, delayed exactly.
+    */
+    template <typename SampleType, typename Lanes, typename Interpolation>
+    static double measure (double delayLow, double delayHigh)
+    {
+        CrossfeedDelay<SampleType, Interpolation> delayLine;
+        delayLine.prepare (maxDelay, blockSize);
+
+        alignas (4 * sizeof (SampleType)) SampleType frames[blockSize * 4];
+        alignas (4 * sizeof (SampleType)) SampleType crossed[blockSize * 4];
+
+        // Crossed lane order: low R, low L, high R, high L.
+        static constexpr int source[] = { 1, 0, 3, 2 };
+        double largest = 0.0;
+
+        for (int block = 0; block < 64; block++)
+        {
+            for (int i = 0; i < blockSize; i++)
+                for (int lane = 0; lane < 4; lane++)
+                    frames[i * 4 + lane] = static_cast<SampleType> (input (lane, block * blockSize + i));
+
+            delayLine.write (frames, blockSize);
+            delayLine.template readCrossed<Lanes> ((SampleType) delayLow, {}, (SampleType) delayHigh, {}, crossed, blockSize);
+
+            // Skip the start, until the history and the allpass state are filled.
+            if (block < 8)
+                continue;
+
+            for (int i = 0; i < blockSize; i++)
+            {
+                for (int lane = 0; lane < 4; lane++)
+                {
+                    const auto time = block * blockSize + i - (lane < 2 ? delayLow : delayHigh);
+                    const auto expected = static_cast<double> (static_cast<SampleType> (input (source[lane], time)));
+                    largest = std::max (largest, std::abs (static_cast<double> (crossed[i * 4 + lane]) - expected));
+                }
+            }
+        }
+
+        return largest;
+    }
+};
+
+static DelayTests delayTests;
@@ -0,0 +1,358 @@
+/*
+  ==============================================================================
+
+    CrossfeedKernel: the vector lanes against the scalar reference, output
+    that does not depend on the host's block sizes, the specialised paths
+    against the general one, and skipping silence once the tail has rung out.
+
+  ==============================================================================
+*/
+
+#include "CrossfeedKernel.h"
+#include "CrossfeedTest.h"
+#include <cstring>
+#include <random>
+
+//==============================================================================
+class KernelTests  : public CrossfeedTest
+{
+public:
+    KernelTests() : CrossfeedTest ("kernel") {}
+
+    void runTest() override
+    {
+        using namespace CrossfeedInterpolationTypes;
+
+        for (const auto rate : { 44100.0, 96000.0, 192000.0 })
+        {
+            const auto suffix = ", " + std::to_string (static_cast<int> (rate)) + " Hz";
+
+            beginTest ("Vector and scalar lanes agree bit for bit, float" + suffix);
+            expectIdentical<float, Linear> (rate, "linear");
+            expectIdentical<float, Lagrange3rd> (rate, "lagrange");
+            expectIdentical<float, Thiran> (rate, "thiran");
+
+            beginTest ("Vector and scalar lanes agree bit for bit, double" + suffix);
+            expectIdentical<double, Linear> (rate, "linear");
+            expectIdentical<double, Lagrange3rd> (rate, "lagrange");
+            expectIdentical<double, Thiran> (rate, "thiran");
+        }
+
+        beginTest ("Host block sizes do not change the output, float");
+        expectBlockSizeInvariant<float>();
+
+        beginTest ("Host block sizes do not change the output, double");
+        expectBlockSizeInvariant<double>();
+
+        beginTest ("Specialised paths match the general path, float");
+        expectPathsMatch<float> (1.0e-6);
+
+        beginTest ("Specialised paths match the general path, double");
+        expectPathsMatch<double> (1.0e-12);
+
+        beginTest ("Silence goes idle after the tail, float");
+        expectIdle<float>();
+
+        beginTest ("Silence goes idle after the tail, double");
+        expectIdle<double>();
+    }
+
+private:
+    //==============================================================================
+    /** Renders noise through a schedule of settings that visits every path,
+        ramps between them and ends host blocks inside sub-blocks.
+    */
+    template <typename SampleType, typename Interpolation, bool scalar>
+    static std::vector<SampleType> render (double rate)
+    {
+        constexpr int numSamples = 1 << 15;
+        static constexpr int sizes[] = { 1, 7, 64, 333, 512, 31, 32, 100 };
+
+        std::mt19937 generator (1);
+        std::uniform_real_distribution<SampleType> noise (-1, 1);
+        std::vector<SampleType> output (2 * numSamples);
+
+        for (auto& sample : output)
+            sample = noise (generator);
+
+        auto* left = output.data();
+        auto* right = output.data() + numSamples;
+
+        CrossfeedKernel<SampleType, Interpolation> kernel;
+        kernel.prepare (rate);
+
+        for (int position = 0, block = 0; position < numSamples; block++)
+        {
+            const auto n = std::min (sizes[block % 8], numSamples - position);
+            const auto microseconds = static_cast<SampleType> (rate * 1.0e-6);
+
+            auto crossover = (SampleType) (block % 50 < 25 ? 2000 : 700);
+            auto delayLow = (block % 40 < 20 ? (SampleType) 250 : (SampleType) 503) * microseconds;
+            auto delayHigh = (SampleType) 100 * microseconds;
+            const auto amplitudeLow = (SampleType) (block % 60 < 30 ? .75 : 0);
+            const auto amplitudeHigh = (SampleType) (block % 30 < 15 ? .1 : 0);
+
+            if (block % 70 > 60)
+                delayLow = delayHigh = 0;
+
+            if (block % 90 > 80)
+                delayLow = 3;
+
+            if (block % 200 > 190)
+                crossover = 15000;
+
+            kernel.setParameters (crossover, delayLow, delayHigh, amplitudeLow, amplitudeHigh);
+
+            if constexpr (scalar)
+                kernel.processScalar (left + position, right + position, n);
+            else
+                kernel.process (left + position, right + position, n);
+
+            position += n;
+        }
+
+        return output;
+    }
+
+    template <typename SampleType, typename Interpolation>
+    void expectIdentical (double rate, const char* interpolation)
+    {
+        const auto vector = render<SampleType, Interpolation, false> (rate);
+        const auto scalar = render<SampleType, Interpolation, true> (rate);
+
+        auto firstDifference = vector.size();
+
+        for (size_t i = 0; i < vector.size() && firstDifference == vector.size(); i++)
+            if (std::memcmp (&vector[i], &scalar[i], sizeof (SampleType)) != 0)
+                firstDifference = i;
+
+        expect (firstDifference == vector.size(),
+                std::string (interpolation) + ": first difference at sample " + std::to_string (firstDifference));
+    }
+
+    //==============================================================================
+    template <typename SampleType>
+    static void fillNoise (std::vector<SampleType>& buffer, unsigned seed)
+    {
+        std::mt19937 generator (seed);
+        std::uniform_real_distribution<SampleType> noise (-1, 1);
+
+        for (auto& sample : buffer)
+            sample = noise (generator);
+    }
+
+    template <typename SampleType>
+    static size_t countDifferences (const std::vector<SampleType>& a, const std::vector<SampleType>& b)
+    {
+        size_t count = 0;
+
+        for (size_t i = 0; i < a.size(); i++)
+            if (std::memcmp (&a[i], &b[i], sizeof (SampleType)) != 0)
+                count++;
+
+        return count;
+    }
+
+    /** Renders noise in blocks of the given sizes, in turn. Settings change at
+        fixed sample positions, off the sub-block grid, whatever the blocks are.
+    */
+    template <typename SampleType>
+    static std::vector<SampleType> renderInBlocks (const std::vector<int>& sizes)
+    {
+        constexpr double rate = 48000.0;
+        constexpr int numSamples = 1 << 15;
+        constexpr int settingLength = 3001;
+
+        std::vector<SampleType> left (numSamples), right (numSamples);
+        fillNoise (left, 7);
+        fillNoise (right, 8);
+
+        CrossfeedKernel<SampleType> kernel;
+        kernel.prepare (rate);
+
+        const auto microseconds = static_cast<SampleType> (rate * 1.0e-6);
+
+        // Ramps between every path: general, noHighCrossfeed, noDelay, bypass.
+        const SampleType settings[][5] = { { 2000, 250, 100, (SampleType) .75, (SampleType) .1 },
+                                           { 700, 503, 100, (SampleType) .75, 0 },
+                                           { 700, 0, 0, (SampleType) .5, (SampleType) .2 },
+                                           { 15000, 250, 100, 0, 0 } };
+
+        for (int position = 0, block = 0; position < numSamples; block++)
+        {
+            const auto index = position / settingLength;
+            const auto& setting = settings[index % 4];
+            kernel.setParameters (setting[0], setting[1] * microseconds, setting[2] * microseconds, setting[3], setting[4]);
+
+            // Blocks end where the settings change, so every split sees them at the same sample.
+            const auto n = std::min ({ sizes[(size_t) block % sizes.size()], numSamples - position, (index + 1) * settingLength - position });
+            kernel.process (left.data() + position, right.data() + position, n);
+            position += n;
+        }
+
+        left.insert (left.end(), right.begin(), right.end());
+        return left;
+    }
+
+    template <typename SampleType>
+    void expectBlockSizeInvariant()
+    {
+        const auto reference = renderInBlocks<SampleType> ({ 512 });
+
+        for (const auto& sizes : { std::vector<int> { 1, 7, 333, 31, 100 }, std::vector<int> { 1 },
+                                   std::vector<int> { 32 }, std::vector<int> { 4096 }, std::vector<int> { 33, 64, 2, 1000 } })
+        {
+            const auto differences = countDifferences (renderInBlocks<SampleType> (sizes), reference);
+            expect (differences == 0, "blocks of " + std::to_string (sizes.front()) + "...: " + std::to_string (differences) + " samples differ");
+        }
+    }
+
+    /** Renders with steady settings on a fresh kernel, and reports the most general path it took. */
+    template <typename SampleType>
+    static void renderSteady (SampleType crossover, SampleType delayLow, SampleType delayHigh,
+                                SampleType amplitudeLow, SampleType amplitudeHigh,
+                                const std::vector<SampleType>& left, const std::vector<SampleType>& right,
+                                std::vector<SampleType>& outLeft, std::vector<SampleType>& outRight, CrossfeedPath& path)
+    {
+        CrossfeedKernel<SampleType> kernel;
+        kernel.prepare (48000.0);
+        kernel.setParameters (crossover, delayLow, delayHigh, amplitudeLow, amplitudeHigh);
+
+        outLeft = left;
+        outRight = right;
+        path = CrossfeedPath::idle;
+
+        for (size_t offset = 0; offset < left.size(); offset += 256)
+        {
+            kernel.process (outLeft.data() + offset, outRight.data() + offset, 256);
+            path = std::max (path, kernel.getLastPath());
+        }
+    }
+
+    /** Each shortcut against the general path with the value that selects it nudged off zero. */
+    template <typename SampleType>
+    void expectPathsMatch (double tolerance)
+    {
+        std::vector<SampleType> left (8192), right (8192);
+        fillNoise (left, 5);
+        fillNoise (right, 6);
+
+        const auto tiny = (SampleType) 1.0e-30;
+        const auto delaySamples = (SampleType) 12.3;
+
+        struct Case
+        {
+            const char* name;
+            CrossfeedPath path;
+            SampleType shortcut[4], general[4];     // delayLow, delayHigh, amplitudeLow, amplitudeHigh
+            double tolerance;
+        };
+
+        const Case cases[] = {
+            { "bypass", CrossfeedPath::bypass, { delaySamples, 4, 0, 0 }, { delaySamples, 4, tiny, tiny }, tolerance },
+            { "noHighCrossfeed", CrossfeedPath::noHighCrossfeed, { delaySamples, 4, .75, 0 }, { delaySamples, 4, .75, tiny }, tolerance },
+
+            // A millionth of a sample of delay moves the output by up to about a millionth of its slope.
+            { "noDelay", CrossfeedPath::noDelay, { 0, 0, .75, .1 }, { (SampleType) 1.0e-6, (SampleType) 1.0e-6, .75, .1 }, 4.0e-6 },
+        };
+
+        for (const auto& c : cases)
+        {
+            std::vector<SampleType> shortcutLeft, shortcutRight, generalLeft, generalRight;
+            CrossfeedPath shortcutPath, generalPath;
+
+            renderSteady<SampleType> (1000, c.shortcut[0], c.shortcut[1], c.shortcut[2], c.shortcut[3],
+                                      left, right, shortcutLeft, shortcutRight, shortcutPath);
+            renderSteady<SampleType> (1000, c.general[0], c.general[1], c.general[2], c.general[3],
+                                      left, right, generalLeft, generalRight, generalPath);
+
+            expect (shortcutPath == c.path, std::string (c.name) + ": took the " + getCrossfeedPathName (shortcutPath) + " path");
+            expect (generalPath == CrossfeedPath::general, std::string (c.name) + ": reference took the " + getCrossfeedPathName (generalPath) + " path");
+
+            double largest = 0.0;
+
+            for (size_t i = 0; i < left.size(); i++)
+                largest = std::max ({ largest, std::abs (static_cast<double> (shortcutLeft[i] - generalLeft[i])),
+                                      std::abs (static_cast<double> (shortcutRight[i] - generalRight[i])) });
+
+            expectWithinAbsoluteError (largest, 0.0, c.tolerance, std::string (c.name) + ": largest difference");
+        }
+    }
+
+    template <typename SampleType>
+    void expectIdle()
+    {
+        constexpr double rate = 48000.0;
+        constexpr int signalLength = 2000;
+
+        const auto microseconds = static_cast<SampleType> (rate * 1.0e-6);
+        const auto setUp = [&] (CrossfeedKernel<SampleType>& kernel, SampleType crossover)
+        {
+            kernel.setParameters (crossover, (SampleType) 250 * microseconds, (SampleType) 100 * microseconds, (SampleType) .75, (SampleType) .1);
+        };
+
+        CrossfeedKernel<SampleType> kernel;
+        kernel.prepare (rate);
+        setUp (kernel, 700);
+
+        const auto tail = kernel.getTailSamples (700.0, CrossfeedKernel<SampleType>::silenceThreshold);
+
+        // The reference hears the signal and the silence after it in one call, so it never counts silence.
+        std::vector<SampleType> left (signalLength + tail), right (signalLength + tail);
+        fillNoise (left, 1);
+        fillNoise (right, 2);
+        std::fill (left.begin() + signalLength, left.end(), SampleType());
+        std::fill (right.begin() + signalLength, right.end(), SampleType());
+
+        auto referenceLeft = left, referenceRight = right;
+        CrossfeedKernel<SampleType> reference;
+        reference.prepare (rate);
+        setUp (reference, 700);
+        reference.process (referenceLeft.data(), referenceRight.data(), signalLength + tail);
+
+        // The silence goes in a frame at a time; idle only once a whole tail of it has gone by.
+        kernel.process (left.data(), right.data(), signalLength);
+        int earlyIdle = 0;
+
+        for (int i = 0; i < tail; i++)
+        {
+            kernel.process (left.data() + signalLength + i, right.data() + signalLength + i, 1);
+
+            if (kernel.isIdle() != (i + 1 >= tail))
+                earlyIdle++;
+        }
+
+        expect (earlyIdle == 0, "frames where idle did not match the silence so far: " + std::to_string (earlyIdle));
+        expect (kernel.isIdle(), "idle after the tail");
+        expect (countDifferences (left, referenceLeft) == 0 && countDifferences (right, referenceRight) == 0,
+                "the tail rings out unchanged");
+        expect (std::abs (left[(size_t) signalLength + 10]) > (SampleType) 0, "the tail rings");
+
+        // New settings while idle apply at once, and signal resumes as on a freshly prepared kernel.
+        std::vector<SampleType> silence (256);
+        setUp (kernel, 2000);
+        kernel.process (silence.data(), silence.data(), 256);
+        expect (kernel.getLastPath() == CrossfeedPath::idle, "idle path");
+
+        std::vector<SampleType> resumedLeft (4096), resumedRight (4096);
+        fillNoise (resumedLeft, 3);
+        fillNoise (resumedRight, 4);
+        auto freshLeft = resumedLeft, freshRight = resumedRight;
+
+        CrossfeedKernel<SampleType> fresh;
+        fresh.prepare (rate);
+        setUp (fresh, 2000);
+
+        for (int offset = 0; offset < 4096; offset += 512)
+        {
+            kernel.process (resumedLeft.data() + offset, resumedRight.data() + offset, 512);
+            fresh.process (freshLeft.data() + offset, freshRight.data() + offset, 512);
+        }
+
+        expect (! kernel.isIdle(), "signal wakes it");
+        expect (countDifferences (resumedLeft, freshLeft) == 0 && countDifferences (resumedRight, freshRight) == 0,
+                "resumes as a fresh kernel would");
+    }
+};
+
+static KernelTests kernelTests;
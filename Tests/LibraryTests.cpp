@@ -0,0 +1,174 @@
+/*
+  ==============================================================================
+
+    libcrossfeed: argument checks, the crossover's limit at the sample rate,
+    and output against the engine it wraps.
+
+  ==============================================================================
+*/
+
+#include "CrossfeedEngine.h"
+#include "CrossfeedTest.h"
+#include "crossfeed.h"
+#include <cmath>
+#include <cstring>
+
+//==============================================================================
+class LibraryTests  : public CrossfeedTest
+{
+public:
+    LibraryTests() : CrossfeedTest ("library") {}
+
+    void runTest() override
+    {
+        beginTest ("Arguments are checked");
+        {
+            expectEquals (crossfeed_get_api_version(), CROSSFEED_API_VERSION);
+
+            auto* cf = crossfeed_create();
+            crossfeed_params params;
+            crossfeed_default_params (&params);
+            float left[4] = {}, right[4] = {}, frames[8] = {};
+
+            expectEquals<int> (crossfeed_process_planar (cf, left, right, 4), CROSSFEED_ERROR_NOT_PREPARED, "process before prepare");
+            expectEquals<int> (crossfeed_reset (cf), CROSSFEED_ERROR_NOT_PREPARED, "reset before prepare");
+            expectEquals (crossfeed_get_tail_frames (cf), 0, "tail before prepare");
+
+            expectEquals<int> (crossfeed_prepare (nullptr, 48000.0), CROSSFEED_ERROR_INVALID_ARGUMENT, "null handle");
+            expectEquals<int> (crossfeed_prepare (cf, 4000.0), CROSSFEED_ERROR_INVALID_ARGUMENT, "rate too low");
+            expectEquals<int> (crossfeed_prepare (cf, std::nan ("")), CROSSFEED_ERROR_INVALID_ARGUMENT, "NaN rate");
+            expectEquals<int> (crossfeed_prepare (cf, 48000.0), CROSSFEED_OK, "prepare");
+
+            expectEquals<int> (crossfeed_set_params (cf, nullptr), CROSSFEED_ERROR_INVALID_ARGUMENT, "null params");
+            expectEquals<int> (crossfeed_process_interleaved (cf, frames, -1), CROSSFEED_ERROR_INVALID_ARGUMENT, "negative count");
+            expectEquals<int> (crossfeed_process_interleaved (cf, nullptr, 4), CROSSFEED_ERROR_INVALID_ARGUMENT, "null frames");
+            expectEquals<int> (crossfeed_process_planar (cf, left, nullptr, 4), CROSSFEED_ERROR_INVALID_ARGUMENT, "null channel");
+            expectEquals<int> (crossfeed_process_interleaved (cf, nullptr, 0), CROSSFEED_OK, "empty block");
+
+            for (auto member : { &crossfeed_params::amplitude_low, &crossfeed_params::amplitude_high, &crossfeed_params::delay_low_us,
+                                 &crossfeed_params::delay_high_us, &crossfeed_params::crossover_hz })
+            {
+                for (auto value : { -1.f, 1.0e6f, std::nanf ("") })
+                {
+                    auto bad = params;
+                    bad.*member = value;
+                    expectEquals<int> (crossfeed_set_params (cf, &bad), CROSSFEED_ERROR_INVALID_ARGUMENT, "out of range");
+                }
+            }
+
+            crossfeed_destroy (cf);
+            crossfeed_destroy (nullptr);
+        }
+
+        beginTest ("Crossovers at or above Nyquist are rejected once prepared");
+        {
+            auto* cf = crossfeed_create();
+            crossfeed_params params;
+            crossfeed_default_params (&params);
+
+            // Before prepare only the fixed range applies.
+            params.crossover_hz = 20000.f;
+            expectEquals<int> (crossfeed_set_params (cf, &params), CROSSFEED_OK, "before prepare");
+
+            // Too high for this rate, so the filters hold it at 0.49 times the rate.
+            const auto sampleRate = 22050.0;
+            expectEquals<int> (crossfeed_prepare (cf, sampleRate), CROSSFEED_OK, "prepare below twice the crossover");
+
+            const auto limitedTail = crossfeed_get_tail_frames (cf);
+            expect (limitedTail > 0 && limitedTail < sampleRate, "tail at the limit: " + std::to_string (limitedTail));
+
+            std::vector<float> frames (2 * 4096);
+            unsigned seed = 1;
+
+            for (auto& x : frames)
+            {
+                seed = seed * 1664525u + 1013904223u;
+                x = static_cast<float> (static_cast<int> (seed >> 8) - (1 << 23)) / (float) (1 << 24);
+            }
+
+            expectEquals<int> (crossfeed_process_interleaved (cf, frames.data(), 4096), CROSSFEED_OK, "process");
+
+            float peak = 0.f;
+
+            for (auto x : frames)
+                peak = std::isfinite (x) ? std::max (peak, std::abs (x)) : INFINITY;
+
+            expect (peak < 4.f, "output stays bounded: " + std::to_string (peak));
+
+            for (auto crossover : { static_cast<float> (sampleRate / 2.0), 15000.f })
+            {
+                params.crossover_hz = crossover;
+                expectEquals<int> (crossfeed_set_params (cf, &params), CROSSFEED_ERROR_INVALID_ARGUMENT,
+                                   "crossover " + std::to_string (crossover));
+            }
+
+            expectEquals (crossfeed_get_tail_frames (cf), limitedTail, "a rejected crossover leaves the handle as it was");
+
+            params.crossover_hz = 11000.f;
+            expectEquals<int> (crossfeed_set_params (cf, &params), CROSSFEED_OK, "just below Nyquist");
+
+            // A higher rate takes the same value.
+            params.crossover_hz = 20000.f;
+            expectEquals<int> (crossfeed_prepare (cf, 48000.0), CROSSFEED_OK, "prepare at 48 kHz");
+            expectEquals<int> (crossfeed_set_params (cf, &params), CROSSFEED_OK, "20 kHz at 48 kHz");
+
+            crossfeed_destroy (cf);
+        }
+
+        beginTest ("Output matches the engine");
+        {
+            constexpr double sampleRate = 44100.0;
+            static constexpr int sizes[] = { 1, 7, 64, 333, 512, 31, 32, 100 };
+
+            auto* cf = crossfeed_create();
+            crossfeed_prepare (cf, sampleRate);
+
+            CrossfeedEngine<float> engine;
+            engine.prepare (sampleRate);
+
+            std::vector<float> interleaved (2 * 512), left (512), right (512);
+            unsigned seed = 1;
+            int numDifferent = 0;
+            float crossover = 0.f;
+
+            for (int block = 0; block < 400; block++)
+            {
+                const auto n = sizes[block % 8];
+                const auto step = static_cast<float> (block / 50 % 4);
+                const crossfeed_params params { .75f - .2f * step, .1f, 100.f + 150.f * step, 50.f * step, 500.f + 700.f * step };
+
+                crossfeed_set_params (cf, &params);
+                crossover = params.crossover_hz;
+                engine.setParameters ({ params.amplitude_low, params.amplitude_high, params.delay_low_us,
+                                        params.delay_high_us, params.crossover_hz });
+
+                for (int i = 0; i < n; i++)
+                {
+                    for (int channel = 0; channel < 2; channel++)
+                    {
+                        seed = seed * 1664525u + 1013904223u;
+                        interleaved[(size_t) (2 * i + channel)] = static_cast<float> (static_cast<int> (seed >> 8) - (1 << 23)) / (float) (1 << 24);
+                    }
+
+                    left[(size_t) i] = interleaved[(size_t) (2 * i)];
+                    right[(size_t) i] = interleaved[(size_t) (2 * i + 1)];
+                }
+
+                crossfeed_process_interleaved (cf, interleaved.data(), n);
+                engine.process (left.data(), right.data(), n);
+
+                for (int i = 0; i < n; i++)
+                    if (std::memcmp (&interleaved[(size_t) (2 * i)], &left[(size_t) i], sizeof (float)) != 0
+                        || std::memcmp (&interleaved[(size_t) (2 * i + 1)], &right[(size_t) i], sizeof (float)) != 0)
+                        numDifferent++;
+            }
+
+            expectEquals (numDifferent, 0, "frames that differ");
+            expectEquals (crossfeed_get_tail_frames (cf), engine.getTailSamples (crossover, 1.0e-6), "tail");
+
+            crossfeed_destroy (cf);
+        }
+    }
+};
+
+static LibraryTests libraryTests;
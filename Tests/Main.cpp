@@ -0,0 +1,15 @@
+/*
+  ==============================================================================
+
+    Runs the DSP core's tests: all of them, or the one named on the command line.
+
+  ==============================================================================
+*/
+
+#include "CrossfeedTest.h"
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    return CrossfeedTest::runAll (argc, argv);
+}
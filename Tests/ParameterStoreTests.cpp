@@ -0,0 +1,124 @@
+/*
+  ==============================================================================
+
+    CrossfeedParameterStore: snapshots handed over whole, with writers on
+    several threads and the reader never waiting.
+
+  ==============================================================================
+*/
+
+#include "CrossfeedParameters.h"
+#include "CrossfeedRealtimeGuard.h"
+#include "CrossfeedTest.h"
+#include <thread>
+
+//==============================================================================
+class ParameterStoreTests  : public CrossfeedTest
+{
+public:
+    ParameterStoreTests() : CrossfeedTest ("parameters") {}
+
+    void runTest() override
+    {
+        beginTest ("Published values are read back");
+        {
+            CrossfeedParameterStore store;
+            expect (store.read() == CrossfeedParameterSnapshot(), "defaults before the first publish");
+
+            const CrossfeedParameterSnapshot preset { .5f, .2f, 300.f, 50.f, 900.f };
+            store.publish (preset);
+            expect (store.read() == preset, "preset");
+            expect (store.read() == preset, "preset, read again");
+
+            store.publish (&CrossfeedParameterSnapshot::delayHigh, 75.f);
+            auto expected = preset;
+            expected.delayHigh = 75.f;
+            expect (store.read() == expected, "one value changed");
+            expect (store.getLastRead() == expected, "last read");
+        }
+
+        beginTest ("Publishing and reading neither allocate nor lock");
+        {
+            CrossfeedParameterStore store;
+            int numAllocations = 0, numLocks = 0;
+
+            {
+                CrossfeedRealtimeGuard guard;
+
+                for (int i = 0; i < 1000; i++)
+                {
+                    store.publish (&CrossfeedParameterSnapshot::crossoverFrequency, static_cast<float> (i));
+                    store.publish ({ .5f, .1f, 200.f, 100.f, static_cast<float> (i) });
+                    sink = store.read().crossoverFrequency;
+                }
+
+                numAllocations = guard.getNumAllocations();
+                numLocks = guard.getNumLocks();
+            }
+
+            expect (numAllocations == 0, "allocations: " + std::to_string (numAllocations));
+            expect (numLocks == 0, "locks: " + std::to_string (numLocks));
+        }
+
+        beginTest ("Presets are never seen half written");
+        {
+            CrossfeedParameterStore store;
+            store.publish ({ 0.f, 0.f, 0.f, 0.f, 0.f });
+            auto previous = store.read();    // a consistent start, before the writers run
+            std::atomic<bool> running { true };
+
+            // Presets carry their number in the first four values; a single-value
+            // writer moves the crossover at the same time.
+            std::thread presets ([&]
+            {
+                for (int i = 1; running; i++)
+                {
+                    const auto n = static_cast<float> (i % 1000000);
+                    store.publish ({ n, n, n, n, -n });
+                }
+            });
+
+            std::thread automation ([&]
+            {
+                for (int i = 1; running; i++)
+                    store.publish (&CrossfeedParameterSnapshot::crossoverFrequency, static_cast<float> (i % 1000000));
+            });
+
+            int numTorn = 0, numChanges = 0;
+
+            for (int i = 0; i < 2000000; i++)
+            {
+                const auto snapshot = store.read();
+
+                if (! (snapshot.amplitudeLow == snapshot.amplitudeHigh && snapshot.amplitudeLow == snapshot.delayLow
+                        && snapshot.amplitudeLow == snapshot.delayHigh))
+                    numTorn++;
+
+                if (! (snapshot == previous))
+                    numChanges++;
+
+                previous = snapshot;
+
+                // Give the writers a turn on machines with few cores.
+                if (i % 1000 == 0)
+                    std::this_thread::yield();
+            }
+
+            running = false;
+            presets.join();
+            automation.join();
+
+            expect (numTorn == 0, "torn snapshots: " + std::to_string (numTorn));
+            expect (numChanges > 0, "the reader never saw a new snapshot");
+
+            // Once the writers have stopped, the last values come through.
+            const auto final = store.read();
+            expect (final.amplitudeLow == final.delayHigh && final.amplitudeLow > 0.f, "final preset");
+        }
+    }
+
+private:
+    volatile float sink = 0.f;
+};
+
+static ParameterStoreTests parameterStoreTests;
@@ -0,0 +1,280 @@
+/*
+  ==============================================================================
+
+    CrossfeedConvolution against a direct convolution with the same responses,
+    resampling response files without aliasing, the latency the processor
+    reports around HRTF mode, and crossfading into and out of it with
+    surround input.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "PluginProcessor.h"
+#include "CrossfeedTest.h"
+
+//==============================================================================
+class ConvolutionTests  : public CrossfeedTest
+{
+public:
+    ConvolutionTests() : CrossfeedTest ("convolution") {}
+
+    void runTest() override
+    {
+        // Within the head partition, exactly one tail partition, and several with a partial last one.
+        for (auto length : { 40, CrossfeedConvolution::tailSize, 5000 })
+        {
+            beginTest ("Matches direct convolution, " + std::to_string (length) + " samples");
+            expectDirect (length);
+        }
+
+        beginTest ("Responses at four times the rate are read without aliasing");
+        expectBandLimited();
+
+        beginTest ("Latency is reported until the convolution has faded out");
+        {
+            juce::TemporaryFile file (".wav");
+            writeResponses (file.getFile(), makeResponses (3000, 1), 48000.0);
+
+            CrossfeedAudioProcessor processor;
+            processor.setPlayConfigDetails (2, 2, 48000.0, 512);
+            processor.prepareToPlay (48000.0, 512);
+            expect (processor.getLatencySamples() == 0, "two-band model");
+
+            const auto twoBandTail = processor.getTailLengthSeconds();
+
+            expect (processor.loadImpulseResponse (file.getFile()).wasOk());
+            expect (processor.getLatencySamples() == CrossfeedConvolution::getLatencySamples(), "HRTF mode");
+            expect (processor.getTailLengthSeconds() > twoBandTail, "the responses add to the tail");
+
+            // Nothing has been processed since, so the convolution is still playing.
+            processor.clearImpulseResponse();
+            expect (processor.getLatencySamples() == CrossfeedConvolution::getLatencySamples(), "fading out");
+
+            // A new prepareToPlay starts without any fade.
+            processor.prepareToPlay (48000.0, 512);
+            expect (processor.getLatencySamples() == 0, "prepared again");
+            expectWithinAbsoluteError (processor.getTailLengthSeconds(), twoBandTail, 1.0e-12, "two-band tail");
+        }
+
+        beginTest ("Surround input crossfades into and out of HRTF mode without a jump");
+        expectSmoothSurroundCrossfade();
+    }
+
+private:
+    //==============================================================================
+    static juce::AudioBuffer<float> makeResponses (int length, int seed)
+    {
+        juce::AudioBuffer<float> responses (CrossfeedConvolution::numPaths, length);
+        juce::Random random (seed);
+
+        for (int path = 0; path < responses.getNumChannels(); path++)
+            for (int i = 0; i < length; i++)
+                responses.setSample (path, i, (random.nextFloat() - .5f) * std::exp (-4.f * static_cast<float> (i) / static_cast<float> (length)));
+
+        return responses;
+    }
+
+    static void writeResponses (const juce::File& file, const juce::AudioBuffer<float>& responses, double sampleRate)
+    {
+        file.deleteFile();
+        juce::WavAudioFormat wav;
+        std::unique_ptr<juce::OutputStream> stream (file.createOutputStream());
+        std::unique_ptr<juce::AudioFormatWriter> writer (wav.createWriterFor (stream.get(), sampleRate,
+                                                                              CrossfeedConvolution::numPaths, 32, {}, 0));
+
+        if (writer != nullptr)
+        {
+            stream.release();   // the writer owns it now
+            writer->writeFromAudioSampleBuffer (responses, 0, responses.getNumSamples());
+        }
+    }
+
+    /** 5.1 input held at constant, unequal levels while responses are loaded
+        and cleared again. Any step in the output is a discontinuity in the
+        crossfade: with the two-band side rendering the downmix through the
+        stereo kernel, the surround crossfeed took over from a cleared state as
+        the fade-out ended, a step of about half the level.
+    */
+    void expectSmoothSurroundCrossfade()
+    {
+        constexpr double rate = 48000.0;
+        constexpr int blockSize = 512;
+
+        // A short smooth pulse on every path, so the convolution has no sharp edges of its own.
+        juce::AudioBuffer<float> responses (CrossfeedConvolution::numPaths, 16);
+
+        for (int path = 0; path < responses.getNumChannels(); path++)
+            for (int i = 0; i < responses.getNumSamples(); i++)
+                responses.setSample (path, i, (path % 3 == 0 ? 1.f : .5f) * std::sin (juce::MathConstants<float>::pi * (float) (i + 1) / 17.f));
+
+        juce::TemporaryFile file (".wav");
+        writeResponses (file.getFile(), responses, rate);
+
+        CrossfeedAudioProcessor processor;
+        juce::AudioProcessor::BusesLayout layout;
+        layout.inputBuses.add (juce::AudioChannelSet::create5point1());
+        layout.outputBuses.add (juce::AudioChannelSet::stereo());
+        expect (processor.setBusesLayout (layout), "5.1 in, stereo out");
+        processor.setRateAndBufferSizeDetails (rate, blockSize);
+        processor.prepareToPlay (rate, blockSize);
+
+        juce::AudioBuffer<float> buffer (6, blockSize);
+        juce::MidiBuffer midi;
+        std::vector<float> output[2];
+
+        const auto render = [&] (int numBlocks)
+        {
+            for (int block = 0; block < numBlocks; block++)
+            {
+                // L R C LFE Ls Rs; equal levels everywhere would hide the crossfeed.
+                static constexpr float levels[] { .5f, 0.f, .1f, 0.f, .3f, -.2f };
+
+                for (int channel = 0; channel < buffer.getNumChannels(); channel++)
+                    juce::FloatVectorOperations::fill (buffer.getWritePointer (channel), levels[channel], blockSize);
+
+                processor.processBlock (buffer, midi);
+
+                for (int channel = 0; channel < 2; channel++)
+                    output[channel].insert (output[channel].end(), buffer.getReadPointer (channel), buffer.getReadPointer (channel) + blockSize);
+            }
+        };
+
+        // Long enough for the filters to settle and for each 50 ms fade to finish.
+        render (40);
+        const float twoBand[2] { output[0].back(), output[1].back() };
+
+        expect (processor.loadImpulseResponse (file.getFile()).wasOk());
+
+        for (int wait = 0; processor.isLoadingImpulseResponse() && wait < 5000; wait++)
+            juce::Thread::sleep (1);
+
+        // The first block in HRTF mode starts delaying the two-band output by the
+        // new latency, from silence; that is a change of latency, not of model.
+        render (1);
+        const auto start = output[0].size();
+
+        render (39);
+        processor.clearImpulseResponse();
+        render (40);
+
+        for (int channel = 0; channel < 2; channel++)
+        {
+            float largest = 0.f;
+
+            for (auto i = start; i < output[channel].size(); i++)
+                largest = juce::jmax (largest, std::abs (output[channel][i] - output[channel][i - 1]));
+
+            // The compensation starts from silence again as the fade-out begins,
+            // a step of about latency / fade length of the level.
+            const auto message = "channel " + std::to_string (channel);
+            expect (largest < .05f, message + ": step of " + std::to_string (largest));
+            expectWithinAbsoluteError (output[channel].back(), twoBand[channel], 1.0e-5f, message + ", back to the two-band level");
+        }
+    }
+
+    /** Magnitude of one frequency in a signal, Hann-windowed so that the ends do not leak. */
+    static double getMagnitude (const float* samples, int numSamples, double frequency, double sampleRate)
+    {
+        constexpr auto pi = juce::MathConstants<double>::pi;
+        std::complex<double> sum;
+
+        for (int i = 0; i < numSamples; i++)
+            sum += (double) samples[i] * (.5 - .5 * std::cos (2.0 * pi * i / numSamples))
+                 * std::polar (1.0, -2.0 * pi * frequency * i / sampleRate);
+
+        return std::abs (sum);
+    }
+
+    /** Responses at 192 kHz holding 1 kHz and, just as loud, 40 kHz, which a
+        plain resampler to 48 kHz would fold down to 8 kHz.
+    */
+    void expectBandLimited()
+    {
+        constexpr double fileRate = 192000.0, rate = 48000.0;
+        constexpr int length = 4096;
+
+        juce::AudioBuffer<float> responses (CrossfeedConvolution::numPaths, length);
+
+        for (int path = 0; path < responses.getNumChannels(); path++)
+            for (int i = 0; i < length; i++)
+                responses.setSample (path, i, static_cast<float> (std::sin (2.0 * juce::MathConstants<double>::pi * 1000.0 * i / fileRate)
+                                                                + std::sin (2.0 * juce::MathConstants<double>::pi * 40000.0 * i / fileRate)));
+
+        juce::TemporaryFile file (".wav");
+        writeResponses (file.getFile(), responses, fileRate);
+
+        juce::String error;
+        const auto resampled = CrossfeedConvolution::readResponses (file.getFile(), rate, length / 4, error);
+        expect (error.isEmpty(), error.toStdString());
+        expect (resampled.getNumSamples() == length / 4, "length at the new rate");
+
+        for (int path = 0; path < resampled.getNumChannels(); path++)
+        {
+            const auto* samples = resampled.getReadPointer (path);
+            const auto wanted = getMagnitude (samples, resampled.getNumSamples(), 1000.0, rate);
+            const auto alias = getMagnitude (samples, resampled.getNumSamples(), 8000.0, rate);
+
+            expect (wanted > 0.0, "1 kHz survives");
+            expect (alias < wanted * 1.0e-3, "alias at " + std::to_string (juce::Decibels::gainToDecibels (alias / wanted)) + " dB");
+        }
+    }
+
+    void expectDirect (int length)
+    {
+        constexpr int numSamples = 8000;
+        static constexpr int sizes[] = { 1, 7, 64, 333, 512, 31, 32, 100 };
+
+        const auto responses = makeResponses (length, length);
+
+        CrossfeedConvolution convolution;
+        convolution.prepare (5000);
+        convolution.setFilter (std::make_unique<CrossfeedConvolution::Filter> (responses));
+        expect (convolution.isReady(), "the first filter is picked up straight away");
+
+        juce::AudioBuffer<float> input (2, numSamples);
+        juce::Random random (7);
+
+        for (int channel = 0; channel < 2; channel++)
+            for (int i = 0; i < numSamples; i++)
+                input.setSample (channel, i, random.nextFloat() * 2.f - 1.f);
+
+        juce::AudioBuffer<float> output (input);
+
+        for (int offset = 0, block = 0; offset < numSamples; block++)
+        {
+            const auto n = juce::jmin (sizes[block % 8], numSamples - offset);
+            convolution.process (output.getWritePointer (0, offset), output.getWritePointer (1, offset), n);
+            offset += n;
+        }
+
+        // Each ear hears both speakers: left from leftToLeft and rightToLeft, right from the other two.
+        const auto* h = responses.getArrayOfReadPointers();
+        const auto* x = input.getArrayOfReadPointers();
+        const auto latency = CrossfeedConvolution::getLatencySamples();
+        double largest = 0.0, peak = 0.0;
+
+        for (int n = 0; n < numSamples; n++)
+        {
+            double expected[2] = {};
+
+            for (int k = 0; k < length && k <= n - latency; k++)
+            {
+                const auto i = n - latency - k;
+                expected[0] += (double) h[CrossfeedConvolution::leftToLeft][k] * x[0][i] + (double) h[CrossfeedConvolution::rightToLeft][k] * x[1][i];
+                expected[1] += (double) h[CrossfeedConvolution::leftToRight][k] * x[0][i] + (double) h[CrossfeedConvolution::rightToRight][k] * x[1][i];
+            }
+
+            for (int channel = 0; channel < 2; channel++)
+            {
+                largest = std::max (largest, std::abs (output.getSample (channel, n) - expected[channel]));
+                peak = std::max (peak, std::abs (expected[channel]));
+            }
+        }
+
+        expect (peak > 0.0, "silent reference");
+        expectWithinAbsoluteError (largest / peak, 0.0, 1.0e-4, "largest difference, relative to the peak");
+    }
+};
+
+static ConvolutionTests convolutionTests;
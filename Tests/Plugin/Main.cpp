@@ -0,0 +1,17 @@
+/*
+  ==============================================================================
+
+    Runs the plugin's tests: all of them, or the one named on the command line.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "CrossfeedTest.h"
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    return CrossfeedTest::runAll (argc, argv);
+}
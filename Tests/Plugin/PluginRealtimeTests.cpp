@@ -0,0 +1,306 @@
+/*
+  ==============================================================================
+
+    processBlock under a CrossfeedRealtimeGuard, the way a host calls it.
+
+    The test thread plays both the audio thread and the message thread: only
+    the processBlock calls, and the automation the host delivers with them,
+    are guarded. Every kernel path, both precisions, the surround layouts and
+    HRTF mode (loading, crossfading in, swapping responses, crossfading out)
+    are run, and the processor's own path statistics confirm that each of
+    them actually did.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "PluginProcessor.h"
+#include "CrossfeedRealtimeGuard.h"
+#include "CrossfeedTest.h"
+
+//==============================================================================
+class PluginRealtimeTests  : public CrossfeedTest
+{
+public:
+    PluginRealtimeTests() : CrossfeedTest ("realtime") {}
+
+    void runTest() override
+    {
+        beginTest ("JUCE's own cost of a parameter notification");
+        {
+            // What sendValueChangedMessageToListeners() locks by itself, with a listener that does nothing.
+            struct NullListener  : public juce::AudioProcessorParameter::Listener
+            {
+                void parameterValueChanged (int, float) override {}
+                void parameterGestureChanged (int, bool) override {}
+            };
+
+            juce::AudioParameterFloat probe ({ "probe", 1 }, "Probe", 0.f, 1.f, 0.f);
+            NullListener listener;
+            probe.addListener (&listener);
+
+            CrossfeedRealtimeGuard guard;
+            probe.sendValueChangedMessageToListeners (.5f);
+            locksPerNotification = guard.getNumLocks();
+        }
+
+        runStereo<float> ("float");
+        runStereo<double> ("double");
+
+        runSurround ("5.1", juce::AudioChannelSet::create5point1());
+        runSurround ("7.1", juce::AudioChannelSet::create7point1());
+        runSurround ("7.1.4", juce::AudioChannelSet::create7point1point4());
+
+        runConvolution<float> ("float");
+        runConvolution<double> ("double");
+    }
+
+private:
+    //==============================================================================
+    static constexpr double sampleRate = 48000.0;
+    static constexpr int maxBlockSize = 512;
+
+    // One setting per kernel path: general, noHighCrossfeed, noDelay, bypass.
+    static constexpr CrossfeedParameterSnapshot settings[] = { { .75f, .1f, 250.f, 100.f, 2000.f },
+                                                               { .75f, 0.f, 250.f, 100.f, 700.f },
+                                                               { .75f, .1f, 0.f,   0.f,   700.f },
+                                                               { 0.f,  0.f, 250.f, 100.f, 700.f } };
+
+    int locksPerNotification = 0;
+
+    static int getBlockSize (int block) noexcept
+    {
+        static constexpr int sizes[] = { 1, 7, 32, 33, 64, 100, 256, 511, 512 };
+        return sizes[static_cast<size_t> (block) % std::size (sizes)];
+    }
+
+    /** Noise, with a stretch of silence every few hundred blocks so the kernel goes idle. */
+    template <typename SampleType>
+    static void fill (juce::AudioBuffer<SampleType>& buffer, int block, juce::Random& random)
+    {
+        const auto silent = block % 300 >= 220;
+
+        for (int channel = 0; channel < buffer.getNumChannels(); channel++)
+            for (int i = 0; i < buffer.getNumSamples(); i++)
+                buffer.setSample (channel, i, silent ? SampleType() : static_cast<SampleType> (random.nextFloat() * .5f - .25f));
+    }
+
+    //==============================================================================
+    /** Counts of what the audio thread did, summed over all guarded blocks. */
+    struct Counts
+    {
+        int allocations = 0, deallocations = 0, locks = 0, notifications = 0;
+    };
+
+    /** Host automation as the plugin wrappers deliver it on the audio thread:
+        the value is set, then the listeners are told.
+    */
+    static void automate (juce::AudioProcessorParameter& parameter, float value, Counts& counts)
+    {
+        const auto normalised = parameter.convertTo0to1 (value);
+
+        if (normalised == parameter.getValue())
+            return;
+
+        parameter.setValue (normalised);
+        parameter.sendValueChangedMessageToListeners (normalised);
+        counts.notifications++;
+    }
+
+    template <typename SampleType>
+    void processGuarded (CrossfeedAudioProcessor& processor, juce::AudioBuffer<SampleType>& buffer,
+                         const CrossfeedParameterSnapshot* setting, Counts& counts)
+    {
+        juce::MidiBuffer midi;
+        CrossfeedRealtimeGuard guard;
+
+        if (setting != nullptr)
+        {
+            automate (*processor.amplitudeLow, setting->amplitudeLow, counts);
+            automate (*processor.amplitudeHigh, setting->amplitudeHigh, counts);
+            automate (*processor.delayLow, setting->delayLow, counts);
+            automate (*processor.delayHigh, setting->delayHigh, counts);
+            automate (*processor.crossoverFrequency, setting->crossoverFrequency, counts);
+        }
+
+        processor.processBlock (buffer, midi);
+
+        counts.allocations += guard.getNumAllocations();
+        counts.deallocations += guard.getNumDeallocations();
+        counts.locks += guard.getNumLocks();
+    }
+
+    void expectRealtimeSafe (const Counts& counts)
+    {
+        expectEquals (counts.allocations, 0, "allocations");
+        expectEquals (counts.deallocations, 0, "deallocations");
+
+        // JUCE locks its listener list for every notification; anything beyond
+        // that was taken by the plugin.
+        if (CrossfeedRealtimeGuard::canDetectLocks())
+            expectEquals (counts.locks, counts.notifications * locksPerNotification, "locks");
+    }
+
+    void expectPathsRan (CrossfeedAudioProcessor& processor, CrossfeedPerformanceStats& stats,
+                         std::initializer_list<CrossfeedPath> paths)
+    {
+        stats.addAll (processor.getPerformanceMonitor());
+
+        for (auto path : paths)
+            expect (stats.pathBlocks[static_cast<size_t> (path)] > 0,
+                    std::string ("never ran the ") + getCrossfeedPathName (path) + " path");
+    }
+
+    //==============================================================================
+    template <typename SampleType>
+    void runStereo (const juce::String& precision)
+    {
+        beginTest ("Stereo, " + precision.toStdString());
+
+        CrossfeedAudioProcessor processor;
+        processor.setPlayConfigDetails (2, 2, sampleRate, maxBlockSize);
+        processor.prepareToPlay (sampleRate, maxBlockSize);
+
+        juce::AudioBuffer<SampleType> buffer (2, maxBlockSize);
+        juce::Random random (1);
+        CrossfeedPerformanceStats stats;
+        Counts counts;
+
+        for (int block = 0; block < 4000; block++)
+        {
+            juce::AudioBuffer<SampleType> view (buffer.getArrayOfWritePointers(), 2, getBlockSize (block));
+            fill (view, block, random);
+
+            // Settings change every 50 blocks, ramping between paths and then holding.
+            processGuarded (processor, view, &settings[static_cast<size_t> (block / 50) % std::size (settings)], counts);
+            stats.addAll (processor.getPerformanceMonitor());
+        }
+
+        expectRealtimeSafe (counts);
+        expectPathsRan (processor, stats, { CrossfeedPath::idle, CrossfeedPath::bypass, CrossfeedPath::noDelay,
+                                            CrossfeedPath::noHighCrossfeed, CrossfeedPath::general });
+    }
+
+    void runSurround (const char* name, const juce::AudioChannelSet& layout)
+    {
+        beginTest (juce::String (name).toStdString() + " surround");
+
+        CrossfeedAudioProcessor processor;
+        juce::AudioProcessor::BusesLayout buses;
+        buses.inputBuses.add (layout);
+        buses.outputBuses.add (juce::AudioChannelSet::stereo());
+
+        expect (processor.setBusesLayout (buses), "layout not accepted");
+        processor.setRateAndBufferSizeDetails (sampleRate, maxBlockSize);
+        processor.prepareToPlay (sampleRate, maxBlockSize);
+
+        juce::AudioBuffer<float> buffer (layout.size(), maxBlockSize);
+        juce::Random random (2);
+        CrossfeedPerformanceStats stats;
+        Counts counts;
+
+        for (int block = 0; block < 2000; block++)
+        {
+            juce::AudioBuffer<float> view (buffer.getArrayOfWritePointers(), layout.size(), getBlockSize (block));
+            fill (view, block, random);
+
+            processGuarded (processor, view, &settings[static_cast<size_t> (block / 50) % std::size (settings)], counts);
+            stats.addAll (processor.getPerformanceMonitor());
+        }
+
+        expectRealtimeSafe (counts);
+        expectPathsRan (processor, stats, { CrossfeedPath::idle, CrossfeedPath::bypass, CrossfeedPath::general });
+    }
+
+    //==============================================================================
+    /** A four-channel response file: decaying noise, different per path. */
+    static void writeResponses (const juce::File& file, int length, int seed)
+    {
+        juce::AudioBuffer<float> responses (CrossfeedConvolution::numPaths, length);
+        juce::Random random (seed);
+
+        for (int path = 0; path < responses.getNumChannels(); path++)
+            for (int i = 0; i < length; i++)
+                responses.setSample (path, i, (random.nextFloat() - .5f) * std::exp (-8.f * static_cast<float> (i) / static_cast<float> (length)));
+
+        file.deleteFile();
+        juce::WavAudioFormat wav;
+        std::unique_ptr<juce::OutputStream> stream (file.createOutputStream());
+        std::unique_ptr<juce::AudioFormatWriter> writer (wav.createWriterFor (stream.get(), sampleRate,
+                                                                              CrossfeedConvolution::numPaths, 32, {}, 0));
+
+        if (writer != nullptr)
+        {
+            stream.release();   // the writer owns it now
+            writer->writeFromAudioSampleBuffer (responses, 0, length);
+        }
+    }
+
+    template <typename SampleType>
+    void runConvolution (const juce::String& precision)
+    {
+        beginTest ("HRTF mode, " + precision.toStdString());
+
+        juce::TemporaryFile first (".wav"), second (".wav");
+        writeResponses (first.getFile(), 12000, 3);
+        writeResponses (second.getFile(), 3000, 4);
+
+        CrossfeedAudioProcessor processor;
+        processor.setPlayConfigDetails (2, 2, sampleRate, maxBlockSize);
+        processor.prepareToPlay (sampleRate, maxBlockSize);
+
+        juce::AudioBuffer<SampleType> buffer (2, maxBlockSize);
+        juce::Random random (5);
+        CrossfeedPerformanceStats stats;
+        Counts counts;
+
+        auto run = [&] (int numBlocks)
+        {
+            for (int block = 0; block < numBlocks; block++)
+            {
+                juce::AudioBuffer<SampleType> view (buffer.getArrayOfWritePointers(), 2, getBlockSize (block));
+                fill (view, block % 200, random);
+                processGuarded (processor, view, nullptr, counts);
+                stats.addAll (processor.getPerformanceMonitor());
+
+                // The loader thread picks up freed filters whenever it hands over a new one.
+                if (block % 64 == 0)
+                    juce::Thread::yield();
+            }
+        };
+
+        // Loading runs while the audio thread carries on with the two-band model.
+        expect (processor.loadImpulseResponse (first.getFile()).wasOk());
+        run (200);
+
+        while (processor.isLoadingImpulseResponse())
+            run (16);
+
+        // Fade in, run, then swap to the second response with its own crossfade.
+        run (1000);
+        expect (processor.loadImpulseResponse (second.getFile()).wasOk());
+
+        while (processor.isLoadingImpulseResponse())
+            run (16);
+
+        run (1000);
+
+        // A third load while the second swap may still be fading queues a filter for freeing.
+        expect (processor.loadImpulseResponse (first.getFile()).wasOk());
+
+        while (processor.isLoadingImpulseResponse())
+            run (16);
+
+        run (1000);
+
+        // Back to the two-band model: the convolution fades out.
+        processor.clearImpulseResponse();
+        run (1000);
+
+        expect (processor.getImpulseResponseError().isEmpty(), processor.getImpulseResponseError().toStdString());
+        expectRealtimeSafe (counts);
+        expectPathsRan (processor, stats, { CrossfeedPath::convolution, CrossfeedPath::general });
+    }
+};
+
+static PluginRealtimeTests pluginRealtimeTests;
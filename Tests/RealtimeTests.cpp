@@ -0,0 +1,251 @@
+/*
+  ==============================================================================
+
+    Everything the DSP core does per block, run under a CrossfeedRealtimeGuard:
+    every kernel path, parameter ramps, silence, the surround layouts, the
+    bank and the C API. Block sizes vary, so sub-blocks get split across calls as well.
+
+  ==============================================================================
+*/
+
+#include "CrossfeedBank.h"
+#include "CrossfeedRealtimeGuard.h"
+#include "CrossfeedTest.h"
+#include "crossfeed.h"
+#include <iterator>
+#include <mutex>
+
+//==============================================================================
+class RealtimeTests  : public CrossfeedTest
+{
+public:
+    RealtimeTests() : CrossfeedTest ("realtime") {}
+
+    void runTest() override
+    {
+        beginTest ("The guard sees allocations and locks");
+        {
+            volatile int size = 100;
+            int numAllocations = 0, numLocks = 0;
+
+            {
+                CrossfeedRealtimeGuard guard;
+                std::vector<float> v (static_cast<size_t> (size));
+                v[0] = 1.f;
+                sink = v[0];
+
+                std::mutex mutex;
+                mutex.lock();
+                mutex.unlock();
+
+                numAllocations = guard.getNumAllocations();
+                numLocks = guard.getNumLocks();
+            }
+
+            expect (numAllocations == 1, "allocations: " + std::to_string (numAllocations));
+            expect (numLocks == (CrossfeedRealtimeGuard::canDetectLocks() ? 1 : 0), "locks: " + std::to_string (numLocks));
+        }
+
+        runEngine<float> ("float");
+        runEngine<double> ("double");
+
+        beginTest ("C API");
+        {
+            auto* cf = crossfeed_create();
+            crossfeed_prepare (cf, 48000.0);
+
+            crossfeed_params params;
+            crossfeed_default_params (&params);
+
+            std::vector<float> interleaved (2 * maxBlockSize), left (maxBlockSize), right (maxBlockSize);
+
+            expectRealtimeSafe ([&]
+            {
+                for (int block = 0; block < numBlocks; block++)
+                {
+                    params.crossover_hz = 300.f + static_cast<float> (block % 50) * 100.f;
+                    params.amplitude_high = block % 200 < 100 ? .1f : 0.f;
+                    crossfeed_set_params (cf, &params);
+
+                    const auto n = getBlockSize (block);
+                    fill (interleaved.data(), 2 * n, block);
+                    crossfeed_process_interleaved (cf, interleaved.data(), n);
+
+                    fill (left.data(), n, block);
+                    fill (right.data(), n, block + 1);
+                    crossfeed_process_planar (cf, left.data(), right.data(), n);
+
+                    if (block % 500 == 499)
+                        crossfeed_reset (cf);
+
+                    sink = static_cast<float> (crossfeed_get_tail_frames (cf));
+                }
+            });
+
+            crossfeed_destroy (cf);
+        }
+    }
+
+private:
+    //==============================================================================
+    static constexpr int maxBlockSize = 1024;
+    static constexpr int numBlocks = 2000;
+
+    volatile float sink = 0.f;
+
+    /** Mostly small and odd sizes, so host blocks end inside sub-blocks. */
+    static int getBlockSize (int block) noexcept
+    {
+        static constexpr int sizes[] = { 1, 7, 32, 33, 64, 100, 256, 511, 1024 };
+        return sizes[static_cast<size_t> (block) % std::size (sizes)];
+    }
+
+    /** Noise, or silence for long enough stretches that the kernel goes idle. */
+    template <typename SampleType>
+    static void fill (SampleType* data, int numSamples, int block) noexcept
+    {
+        const auto silent = block % 300 >= 200;
+        auto seed = static_cast<unsigned> (block) * 2654435761u;
+
+        for (int i = 0; i < numSamples; i++)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            data[i] = silent ? SampleType() : static_cast<SampleType> (static_cast<int> (seed >> 8) - (1 << 23)) / (SampleType) (1 << 24);
+        }
+    }
+
+    template <typename Function>
+    void expectRealtimeSafe (Function&& function)
+    {
+        int numAllocations = 0, numDeallocations = 0, numLocks = 0;
+
+        {
+            CrossfeedRealtimeGuard guard;
+            function();
+
+            numAllocations = guard.getNumAllocations();
+            numDeallocations = guard.getNumDeallocations();
+            numLocks = guard.getNumLocks();
+        }
+
+        expect (numAllocations == 0, "allocations: " + std::to_string (numAllocations));
+        expect (numDeallocations == 0, "deallocations: " + std::to_string (numDeallocations));
+        expect (numLocks == 0, "locks: " + std::to_string (numLocks));
+    }
+
+    //==============================================================================
+    template <typename SampleType>
+    void runEngine (const std::string& precision)
+    {
+        // One setting per kernel path; switching between them ramps through the general path.
+        const CrossfeedParameterSnapshot settings[] = { { .75f, .1f, 250.f, 100.f, 2000.f },     // general
+                                                        { .75f, 0.f, 250.f, 100.f, 700.f },      // noHighCrossfeed
+                                                        { .75f, .1f, 0.f,   0.f,   700.f },      // noDelay
+                                                        { 0.f,  0.f, 250.f, 100.f, 700.f } };    // bypass
+
+        std::vector<SampleType> left (maxBlockSize), right (maxBlockSize), interleaved (2 * maxBlockSize);
+
+        beginTest ("Stereo engine, " + precision);
+        {
+            CrossfeedEngine<SampleType> engine;
+            engine.prepare (48000.0);
+
+            expectRealtimeSafe ([&]
+            {
+                for (int block = 0; block < numBlocks; block++)
+                {
+                    // Each setting holds for a while, so the steady paths run too.
+                    engine.setParameters (settings[static_cast<size_t> (block / 50) % std::size (settings)]);
+
+                    const auto n = getBlockSize (block);
+                    fill (left.data(), n, block);
+                    fill (right.data(), n, block + 1);
+                    engine.process (left.data(), right.data(), n);
+
+                    fill (interleaved.data(), 2 * n, block);
+                    engine.processInterleaved (interleaved.data(), n);
+
+                    if (block % 700 == 699)
+                        engine.reset();
+                }
+            });
+        }
+
+        beginTest ("Bank, " + precision);
+        {
+            constexpr int numStreams = 5;
+
+            CrossfeedBank<SampleType> bank;
+            bank.prepare (48000.0, numStreams);
+
+            std::vector<std::vector<SampleType>> channels (2 * numStreams, std::vector<SampleType> (maxBlockSize));
+            std::vector<SampleType*> lefts, rights;
+
+            for (size_t stream = 0; stream < numStreams; stream++)
+            {
+                lefts.push_back (channels[2 * stream].data());
+                rights.push_back (channels[2 * stream + 1].data());
+            }
+
+            expectRealtimeSafe ([&]
+            {
+                for (int block = 0; block < numBlocks; block++)
+                {
+                    const auto n = getBlockSize (block);
+
+                    for (int stream = 0; stream < numStreams; stream++)
+                    {
+                        bank.setParameters (stream, settings[static_cast<size_t> (block / 50 + stream) % std::size (settings)]);
+                        fill (lefts[(size_t) stream], n, block + stream);
+                        fill (rights[(size_t) stream], n, block + stream + 1);
+                    }
+
+                    bank.process (lefts.data(), rights.data(), n);
+
+                    if (block % 700 == 699)
+                        bank.reset();
+                }
+            });
+        }
+
+        for (const auto numChannels : { 6, 8, 12 })
+        {
+            beginTest (std::to_string (numChannels) + "-channel surround, " + precision);
+
+            std::vector<CrossfeedSpeaker> speakers;
+
+            for (int channel = 0; channel < numChannels; channel++)
+                speakers.push_back ({ -135.f + 270.f * static_cast<float> (channel) / static_cast<float> (numChannels - 1),
+                                      channel >= 8 ? 45.f : 0.f, channel == 3 ? 0.f : 1.f });
+
+            CrossfeedEngine<SampleType> engine;
+            engine.prepare (48000.0, CrossfeedEngine<SampleType>::defaultMaxDelayMicroseconds, speakers);
+
+            std::vector<std::vector<SampleType>> channels (static_cast<size_t> (numChannels), std::vector<SampleType> (maxBlockSize));
+            std::vector<const SampleType*> inputs;
+
+            for (auto& channel : channels)
+                inputs.push_back (channel.data());
+
+            expectRealtimeSafe ([&]
+            {
+                for (int block = 0; block < numBlocks; block++)
+                {
+                    engine.setParameters (settings[static_cast<size_t> (block / 50) % std::size (settings)]);
+
+                    const auto n = getBlockSize (block);
+
+                    for (size_t channel = 0; channel < channels.size(); channel++)
+                        fill (channels[channel].data(), n, block + static_cast<int> (channel));
+
+                    if (block % 400 < 300)
+                        engine.processSurround (inputs.data(), channels[0].data(), channels[1].data(), n);
+                    else
+                        engine.downmixSurround (inputs.data(), channels[0].data(), channels[1].data(), n);
+                }
+            });
+        }
+    }
+};
+
+static RealtimeTests realtimeTests;
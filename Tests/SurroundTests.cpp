@@ -0,0 +1,257 @@
+/*
+  ==============================================================================
+
+    CrossfeedSurround: the channel matrix per speaker, with and without state,
+    a front pair against the stereo kernel, and silence.
+
+  ==============================================================================
+*/
+
+#include "CrossfeedEngine.h"
+#include "CrossfeedTest.h"
+#include <cmath>
+
+//==============================================================================
+class SurroundTests  : public CrossfeedTest
+{
+public:
+    SurroundTests() : CrossfeedTest ("surround") {}
+
+    void runTest() override
+    {
+        beginTest ("Downmix matrix, 7.1.4");
+        expectMatrix();
+
+        beginTest ("Crossfeed at DC, 7.1.4");
+        expectCrossfeedAtDC();
+
+        beginTest ("A front pair matches the stereo kernel, float");
+        expectFrontPair<float>();
+
+        beginTest ("A front pair matches the stereo kernel, double");
+        expectFrontPair<double>();
+
+        beginTest ("Silence goes idle");
+        expectIdle();
+    }
+
+private:
+    //==============================================================================
+    static constexpr double sampleRate = 48000.0;
+    static constexpr float side = 0.70710678f;
+
+    /** The processor's 7.1.4 table: L R C LFE Ls Rs Lrs Rrs Ltf Rtf Ltr Rtr. */
+    static std::vector<CrossfeedSpeaker> getSpeakers()
+    {
+        return { { -30.f, 0.f, 1.f }, { 30.f, 0.f, 1.f }, { 0.f, 0.f, 1.f }, { 0.f, 0.f, 0.f },
+                 { -90.f, 0.f, side }, { 90.f, 0.f, side }, { -135.f, 0.f, side }, { 135.f, 0.f, side },
+                 { -45.f, 45.f, side }, { 45.f, 45.f, side }, { -135.f, 45.f, side }, { 135.f, 45.f, side } };
+    }
+
+    /** What each speaker contributes to the left and right ear before any crossfeed. */
+    static void getDirectGains (const CrossfeedSpeaker& speaker, double& left, double& right)
+    {
+        const auto centred = speaker.azimuth == 0.f;
+        left = centred ? speaker.gain * 0.70710678118654752 : (speaker.azimuth < 0.f ? speaker.gain : 0.0);
+        right = centred ? speaker.gain * 0.70710678118654752 : (speaker.azimuth > 0.f ? speaker.gain : 0.0);
+    }
+
+    /** Feeds value to one channel, nothing to the others, and returns the last output frame. */
+    template <typename Render>
+    static void renderOneChannel (int numChannels, int channel, int numSamples, Render&& render, double& left, double& right)
+    {
+        std::vector<std::vector<float>> channels (static_cast<size_t> (numChannels), std::vector<float> (static_cast<size_t> (numSamples)));
+        std::vector<const float*> inputs;
+        std::vector<float> l (static_cast<size_t> (numSamples)), r (static_cast<size_t> (numSamples));
+
+        std::fill (channels[static_cast<size_t> (channel)].begin(), channels[static_cast<size_t> (channel)].end(), 1.f);
+
+        for (auto& c : channels)
+            inputs.push_back (c.data());
+
+        for (int offset = 0; offset < numSamples; offset += 100)
+        {
+            const auto n = std::min (100, numSamples - offset);
+            std::vector<const float*> block;
+
+            for (auto* input : inputs)
+                block.push_back (input + offset);
+
+            render (block.data(), l.data() + offset, r.data() + offset, n);
+        }
+
+        left = l.back();
+        right = r.back();
+    }
+
+    void expectMatrix()
+    {
+        const auto speakers = getSpeakers();
+        const auto numChannels = static_cast<int> (speakers.size());
+
+        for (int channel = 0; channel < numChannels; channel++)
+        {
+            CrossfeedEngine<float> engine;
+            engine.prepare (sampleRate, CrossfeedEngine<float>::defaultMaxDelayMicroseconds, speakers);
+            engine.setParameters ({});
+
+            double left = 0.0, right = 0.0, expectedLeft = 0.0, expectedRight = 0.0;
+            renderOneChannel (numChannels, channel, 1000, [&] (auto inputs, auto l, auto r, int n) { engine.downmixSurround (inputs, l, r, n); },
+                              left, right);
+
+            getDirectGains (speakers[static_cast<size_t> (channel)], expectedLeft, expectedRight);
+
+            const auto message = "channel " + std::to_string (channel);
+            expectWithinAbsoluteError (left, expectedLeft, 1.0e-6, message + ", left");
+            expectWithinAbsoluteError (right, expectedRight, 1.0e-6, message + ", right");
+
+            // The stateless matrix the processor's crossfades use gives the same sums.
+            double mixedLeft = 0.0, mixedRight = 0.0;
+            renderOneChannel (numChannels, channel, 1000, [&] (auto inputs, auto l, auto r, int n) { engine.mixSurround (inputs, l, r, n); },
+                              mixedLeft, mixedRight);
+
+            expect (mixedLeft == left && mixedRight == right, message + ": mixSurround differs from downmixSurround");
+        }
+    }
+
+    void expectCrossfeedAtDC()
+    {
+        // At DC only the low band passes: the near ear keeps 1 - amplitudeLow
+        // of a speaker and the far ear gets amplitudeLow, whatever the delay.
+        const auto speakers = getSpeakers();
+        const auto numChannels = static_cast<int> (speakers.size());
+        const CrossfeedParameterSnapshot parameters { .6f, .2f, 250.f, 100.f, 700.f };
+
+        for (int channel = 0; channel < numChannels; channel++)
+        {
+            CrossfeedEngine<float> engine;
+            engine.prepare (sampleRate, CrossfeedEngine<float>::defaultMaxDelayMicroseconds, speakers);
+            engine.setParameters (parameters);
+
+            double left = 0.0, right = 0.0, directLeft = 0.0, directRight = 0.0;
+            renderOneChannel (numChannels, channel, 20000, [&] (auto inputs, auto l, auto r, int n) { engine.processSurround (inputs, l, r, n); },
+                              left, right);
+
+            getDirectGains (speakers[static_cast<size_t> (channel)], directLeft, directRight);
+
+            const double amount = parameters.amplitudeLow;
+            const auto message = "channel " + std::to_string (channel);
+            expectWithinAbsoluteError (left, directLeft * (1.0 - amount) + directRight * amount, 1.0e-4, message + ", left");
+            expectWithinAbsoluteError (right, directRight * (1.0 - amount) + directLeft * amount, 1.0e-4, message + ", right");
+        }
+    }
+
+    template <typename SampleType>
+    void expectFrontPair()
+    {
+        // Delays on whole samples at 48 kHz, where the kernel's interpolator
+        // and the surround matrix's linear one agree. While the delays ramp
+        // they read fractional positions, so the blocks after a change are
+        // left out of the comparison.
+        static constexpr int sizes[] = { 1, 7, 64, 333, 512, 31, 32, 100 };
+        const std::vector<CrossfeedSpeaker> speakers { { -30.f, 0.f, 1.f }, { 30.f, 0.f, 1.f } };
+        const CrossfeedParameterSnapshot settings[] = { { .75f, .1f, 250.f, 125.f, 1000.f },
+                                                        { .5f, .3f, 125.f, 62.5f, 3000.f },
+                                                        { .75f, 0.f, 500.f, 0.f, 700.f } };
+
+        CrossfeedEngine<SampleType> stereo, surround;
+        stereo.prepare (sampleRate);
+        surround.prepare (sampleRate, CrossfeedEngine<SampleType>::defaultMaxDelayMicroseconds, speakers);
+
+        std::vector<SampleType> left (512), right (512), l (512), r (512);
+        unsigned seed = 1;
+        double largest = 0.0;
+
+        for (int block = 0; block < 600; block++)
+        {
+            const auto n = sizes[block % 8];
+            const auto& parameters = settings[block / 200];
+            stereo.setParameters (parameters);
+            surround.setParameters (parameters);
+
+            for (int i = 0; i < n; i++)
+            {
+                for (auto* channel : { &left, &right })
+                {
+                    seed = seed * 1664525u + 1013904223u;
+                    (*channel)[(size_t) i] = static_cast<SampleType> (static_cast<int> (seed >> 8) - (1 << 23)) / (SampleType) (1 << 24);
+                }
+            }
+
+            const SampleType* inputs[] = { left.data(), right.data() };
+            surround.processSurround (inputs, l.data(), r.data(), n);
+            stereo.process (left.data(), right.data(), n);
+
+            if (block >= 200 && block % 200 < 20)
+                continue;
+
+            for (int i = 0; i < n; i++)
+                largest = std::max ({ largest, std::abs (static_cast<double> (l[(size_t) i] - left[(size_t) i])),
+                                      std::abs (static_cast<double> (r[(size_t) i] - right[(size_t) i])) });
+        }
+
+        expectWithinAbsoluteError (largest, 0.0, std::is_same_v<SampleType, float> ? 1.0e-5 : 1.0e-9, "largest difference");
+    }
+
+    void expectIdle()
+    {
+        const auto speakers = getSpeakers();
+        const auto numChannels = speakers.size();
+
+        CrossfeedEngine<float> engine;
+        engine.prepare (sampleRate, CrossfeedEngine<float>::defaultMaxDelayMicroseconds, speakers);
+        engine.setParameters ({});
+
+        std::vector<std::vector<float>> channels (numChannels, std::vector<float> (256));
+        std::vector<const float*> inputs;
+        std::vector<float> left (256), right (256);
+
+        for (auto& c : channels)
+            inputs.push_back (c.data());
+
+        auto run = [&] (bool signal, int numBlocks)
+        {
+            unsigned seed = 1;
+
+            for (int block = 0; block < numBlocks; block++)
+            {
+                for (size_t channel = 0; channel < numChannels; channel++)
+                {
+                    for (auto& x : channels[channel])
+                    {
+                        seed = seed * 1664525u + 1013904223u;
+                        const auto noise = static_cast<float> (static_cast<int> (seed >> 8) - (1 << 23)) / (float) (1 << 24);
+
+                        // The LFE channel is left out of the downmix, so its signal does not count.
+                        x = signal || channel == 3 ? noise : 0.f;
+                    }
+                }
+
+                engine.processSurround (inputs.data(), left.data(), right.data(), 256);
+            }
+        };
+
+        run (true, 20);
+        expect (! engine.isIdle(), "not idle with signal");
+
+        const auto tail = engine.getTailSamples (2000.0, CrossfeedSurround<float>::silenceThreshold);
+        run (false, (tail + 255) / 256 + 1);
+        expect (engine.isIdle(), "idle after the tail");
+
+        run (false, 1);
+        expect (engine.getLastPath() == CrossfeedPath::idle, "idle path");
+
+        auto peak = 0.f;
+
+        for (size_t i = 0; i < left.size(); i++)
+            peak = std::max ({ peak, std::abs (left[i]), std::abs (right[i]) });
+
+        expectEquals (peak, 0.f, "idle output");
+
+        run (true, 1);
+        expect (! engine.isIdle(), "signal wakes it");
+        expect (engine.getLastPath() == CrossfeedPath::general, "general path");
+    }
+};
+
+static SurroundTests surroundTests;
@@ -0,0 +1,426 @@
+/*
+  ==============================================================================
+
+    Interaural level and time differences over a grid of crossfeed settings.
+
+  ==============================================================================
+*/
+
+#include "CrossfeedAnalyzer.h"
+#include "CrossfeedWorkStealingPool.h"
+#include <complex>
+#include <cstdio>
+
+//==============================================================================
+static bool isNumber (const juce::String& text)
+{
+    return text.isNotEmpty() && text.containsOnly ("0123456789.-+eE");
+}
+
+juce::Result CrossfeedAnalysisGrid::parseAxis (const juce::String& text, float start, float end, bool logarithmic,
+                                               std::vector<float>& axis)
+{
+    std::vector<float> values;
+
+    if (text.containsChar (':'))
+    {
+        const auto parts = juce::StringArray::fromTokens (text, ":", {});
+
+        if (parts.size() != 3 || ! isNumber (parts[0].trim()) || ! isNumber (parts[1].trim())
+            || ! parts[2].trim().containsOnly ("0123456789") || parts[2].getIntValue() < 1)
+            return juce::Result::fail ("Expected start:end:count, got " + text);
+
+        const auto first = static_cast<double> (parts[0].getFloatValue());
+        const auto last = static_cast<double> (parts[1].getFloatValue());
+        const auto count = parts[2].getIntValue();
+
+        // Checked before spacing them out, so a bad end point is reported as such.
+        for (auto value : { first, last })
+            if (! (value >= start && value <= end))
+                return juce::Result::fail (juce::String (value) + " is outside " + juce::String (start) + ".." + juce::String (end));
+
+        for (int i = 0; i < count; i++)
+        {
+            const auto t = count > 1 ? static_cast<double> (i) / (count - 1) : 0.0;
+            const auto value = i == count - 1 && count > 1 ? last
+                             : logarithmic ? first * std::pow (last / first, t)
+                                           : first + (last - first) * t;
+            values.push_back (static_cast<float> (value));
+        }
+    }
+    else
+    {
+        for (auto token : juce::StringArray::fromTokens (text, ",", {}))
+        {
+            token = token.trim();
+
+            if (! isNumber (token))
+                return juce::Result::fail ("Invalid value: " + token);
+
+            values.push_back (token.getFloatValue());
+        }
+    }
+
+    if (values.empty())
+        return juce::Result::fail ("No values given");
+
+    for (auto value : values)
+        if (! (value >= start && value <= end))
+            return juce::Result::fail (juce::String (value) + " is outside " + juce::String (start) + ".." + juce::String (end));
+
+    axis = std::move (values);
+    return juce::Result::ok();
+}
+
+juce::Result CrossfeedAnalysisGrid::getNumPoints (size_t maxPoints, size_t& numPoints) const
+{
+    numPoints = 1;
+
+    for (const auto* axis : { &amplitudeLow, &amplitudeHigh, &delayLow, &delayHigh, &crossoverFrequency })
+    {
+        if (axis->empty())
+            return juce::Result::fail ("Empty grid axis");
+
+        // Checked step by step, so the product cannot overflow before it is caught.
+        if (axis->size() > maxPoints / numPoints)
+            return juce::Result::fail ("The grid has more than " + juce::String (static_cast<juce::int64> (maxPoints)) + " settings");
+
+        numPoints *= axis->size();
+    }
+
+    return juce::Result::ok();
+}
+
+CrossfeedParameterSnapshot CrossfeedAnalysisGrid::getPoint (size_t index) const noexcept
+{
+    const auto take = [&index] (const std::vector<float>& axis)
+    {
+        const auto value = axis[index % axis.size()];
+        index /= axis.size();
+        return value;
+    };
+
+    CrossfeedParameterSnapshot point;
+    point.crossoverFrequency = take (crossoverFrequency);
+    point.delayHigh = take (delayHigh);
+    point.delayLow = take (delayLow);
+    point.amplitudeHigh = take (amplitudeHigh);
+    point.amplitudeLow = take (amplitudeLow);
+    return point;
+}
+
+//==============================================================================
+struct CrossfeedAnalyzer::Worker
+{
+    Worker (int order, int impulseResponseLength)
+        : fft (order),
+          left (static_cast<size_t> (impulseResponseLength)),
+          right (static_cast<size_t> (impulseResponseLength))
+    {
+        for (auto* buffer : { &packed, &packedRamped, &spectrum, &spectrumRamped })
+            buffer->resize (static_cast<size_t> (fft.getSize()));
+    }
+
+    juce::dsp::FFT fft;
+    CrossfeedEngine<float> engine;
+    std::vector<float> left, right;
+
+    // Same side in the real part, opposite side in the imaginary part: h[n], then n h[n].
+    std::vector<std::complex<float>> packed, packedRamped, spectrum, spectrumRamped;
+};
+
+//==============================================================================
+CrossfeedAnalyzer::CrossfeedAnalyzer (double rate, int bandsPerOctave)
+    : sampleRate (rate)
+{
+    const auto perOctave = juce::jmax (1, bandsPerOctave);
+    const auto halfBand = std::pow (2.0, 0.5 / perOctave);
+    const auto nyquist = sampleRate / 2.0;
+
+    // Centres on the base-two series through 1 kHz, as in IEC 61260.
+    for (int k = -5 * perOctave;; k++)
+    {
+        CrossfeedAnalysisBand band;
+        band.centre = 1000.0 * std::pow (2.0, static_cast<double> (k) / perOctave);
+        band.low = band.centre / halfBand;
+        band.high = band.centre * halfBand;
+
+        if (band.high >= nyquist)
+            break;
+
+        bands.push_back (band);
+    }
+}
+
+juce::Result CrossfeedAnalyzer::run (const CrossfeedAnalysisGrid& grid, int numWorkers)
+{
+    if (bands.empty())
+        return juce::Result::fail ("The sample rate is too low for any analysis band");
+
+    const auto counted = grid.getNumPoints (5000000, numPoints);
+
+    if (counted.failed())
+        return counted;
+
+    // The filters cannot be designed at or above Nyquist, and the response length would be meaningless.
+    for (auto crossover : grid.crossoverFrequency)
+        if (! (crossover < sampleRate / 2.0))
+            return juce::Result::fail ("Crossover " + juce::String (crossover) + " Hz is not below Nyquist ("
+                                       + juce::String (sampleRate / 2.0) + " Hz)");
+
+    // The impulse response has to ring out at the lowest crossover in the grid,
+    // and the spectrum needs a few bins across the narrowest (lowest) band.
+    {
+        CrossfeedEngine<float> probe;
+        probe.prepare (sampleRate);
+
+        const auto lowestCrossover = *std::min_element (grid.crossoverFrequency.begin(), grid.crossoverFrequency.end());
+        impulseResponseLength = probe.getTailSamples (lowestCrossover, 1.0e-6) + 1;
+
+        if (impulseResponseLength <= 1)
+            return juce::Result::fail ("Cannot size the impulse response for a crossover of " + juce::String (lowestCrossover) + " Hz");
+
+        const auto minBins = 8.0 * sampleRate / (bands.front().high - bands.front().low);
+        fftSize = juce::nextPowerOfTwo (juce::jmax (impulseResponseLength, static_cast<int> (std::ceil (minBins))));
+        fftOrder = juce::roundToInt (std::log2 (fftSize));
+    }
+
+    currentGrid = &grid;
+
+    bandBins.clear();
+
+    for (const auto& band : bands)
+    {
+        const auto first = static_cast<int> (std::ceil (band.low * fftSize / sampleRate));
+        const auto last = juce::jmin (static_cast<int> (std::floor (band.high * fftSize / sampleRate)), fftSize / 2);
+        bandBins.emplace_back (first, juce::jmax (first, last));
+    }
+
+    parameters.assign (5, std::vector<float> (numPoints));
+    ild.assign (bands.size(), std::vector<float> (numPoints));
+    itd.assign (bands.size(), std::vector<float> (numPoints));
+
+    // Chunks small enough to balance, large enough that the queues are not the bottleneck.
+    struct Chunk { size_t begin, end; };
+
+    CrossfeedWorkStealingPool<Chunk> pool (numWorkers);
+    const auto chunkSize = juce::jlimit<size_t> (1, 256, numPoints / (static_cast<size_t> (pool.getNumWorkers()) * 16));
+
+    std::vector<Chunk> chunks;
+
+    for (size_t begin = 0; begin < numPoints; begin += chunkSize)
+        chunks.push_back ({ begin, juce::jmin (begin + chunkSize, numPoints) });
+
+    std::vector<std::unique_ptr<Worker>> workers;
+
+    for (int i = 0; i < pool.getNumWorkers(); i++)
+        workers.push_back (std::make_unique<Worker> (fftOrder, impulseResponseLength));
+
+    pool.run (chunks, [&] (int worker, Chunk& chunk)
+    {
+        analyse (*workers[static_cast<size_t> (worker)], chunk.begin, chunk.end);
+    });
+
+    currentGrid = nullptr;
+    return juce::Result::ok();
+}
+
+void CrossfeedAnalyzer::analyse (Worker& worker, size_t begin, size_t end)
+{
+    using Complex = std::complex<float>;
+
+    for (auto point = begin; point < end; point++)
+    {
+        const auto setting = currentGrid->getPoint (point);
+
+        parameters[0][point] = setting.amplitudeLow;
+        parameters[1][point] = setting.amplitudeHigh;
+        parameters[2][point] = setting.delayLow;
+        parameters[3][point] = setting.delayHigh;
+        parameters[4][point] = setting.crossoverFrequency;
+
+        // Prepared afresh, so the setting applies from the first sample without a ramp.
+        worker.engine.prepare (sampleRate);
+        worker.engine.setParameters (setting);
+
+        std::fill (worker.left.begin(), worker.left.end(), 0.f);
+        std::fill (worker.right.begin(), worker.right.end(), 0.f);
+        worker.left[0] = 1.f;
+
+        worker.engine.process (worker.left.data(), worker.right.data(), impulseResponseLength);
+
+        // Both sides go through one complex transform, and are told apart by symmetry below.
+        std::fill (worker.packed.begin(), worker.packed.end(), Complex());
+        std::fill (worker.packedRamped.begin(), worker.packedRamped.end(), Complex());
+
+        for (int n = 0; n < impulseResponseLength; n++)
+        {
+            const auto i = static_cast<size_t> (n);
+            worker.packed[i] = { worker.left[i], worker.right[i] };
+            worker.packedRamped[i] = static_cast<float> (n) * worker.packed[i];
+        }
+
+        worker.fft.perform (worker.packed.data(), worker.spectrum.data(), false);
+        worker.fft.perform (worker.packedRamped.data(), worker.spectrumRamped.data(), false);
+
+        // For Z = FFT (a + jb): A[k] = (Z[k] + conj Z[N-k]) / 2, B[k] = (Z[k] - conj Z[N-k]) / 2j.
+        const auto separate = [this] (const std::vector<Complex>& z, int k, Complex& same, Complex& opposite)
+        {
+            const auto mirrored = std::conj (z[static_cast<size_t> ((fftSize - k) % fftSize)]);
+            same = (z[static_cast<size_t> (k)] + mirrored) * 0.5f;
+            opposite = (z[static_cast<size_t> (k)] - mirrored) * Complex (0.f, -0.5f);
+        };
+
+        for (size_t band = 0; band < bands.size(); band++)
+        {
+            double sameEnergy = 0.0, oppositeEnergy = 0.0;
+            double weightedDelay = 0.0, totalWeight = 0.0;
+
+            for (int k = bandBins[band].first; k <= bandBins[band].second; k++)
+            {
+                Complex same, opposite, sameRamped, oppositeRamped;
+                separate (worker.spectrum, k, same, opposite);
+                separate (worker.spectrumRamped, k, sameRamped, oppositeRamped);
+
+                const auto samePower = static_cast<double> (std::norm (same));
+                const auto oppositePower = static_cast<double> (std::norm (opposite));
+
+                sameEnergy += samePower;
+                oppositeEnergy += oppositePower;
+
+                // Below about -240 dB the group delay is only rounding noise.
+                if (samePower < 1.0e-24 || oppositePower < 1.0e-24)
+                    continue;
+
+                const auto sameDelay = static_cast<double> ((sameRamped * std::conj (same)).real()) / samePower;
+                const auto oppositeDelay = static_cast<double> ((oppositeRamped * std::conj (opposite)).real()) / oppositePower;
+                const auto weight = std::sqrt (samePower * oppositePower);
+
+                weightedDelay += weight * (oppositeDelay - sameDelay);
+                totalWeight += weight;
+            }
+
+            ild[band][point] = sameEnergy > 0.0 && oppositeEnergy > 0.0
+                                 ? static_cast<float> (10.0 * std::log10 (sameEnergy / oppositeEnergy))
+                                 : std::numeric_limits<float>::quiet_NaN();
+            itd[band][point] = totalWeight > 0.0 ? static_cast<float> (weightedDelay / totalWeight * 1.0e6 / sampleRate)
+                                                 : std::numeric_limits<float>::quiet_NaN();
+        }
+    }
+}
+
+//==============================================================================
+juce::StringArray CrossfeedAnalyzer::getColumnNames() const
+{
+    juce::StringArray names { "amplitude_low", "amplitude_high", "delay_low_us", "delay_high_us", "crossover_hz" };
+
+    for (const auto& band : bands)
+        names.add ("ild_" + juce::String (juce::roundToInt (band.centre)) + "hz_db");
+
+    for (const auto& band : bands)
+        names.add ("itd_" + juce::String (juce::roundToInt (band.centre)) + "hz_us");
+
+    return names;
+}
+
+const float* CrossfeedAnalyzer::getColumn (int index) const noexcept
+{
+    const auto numBands = static_cast<int> (bands.size());
+
+    if (index < 5)
+        return parameters[static_cast<size_t> (index)].data();
+
+    if (index < 5 + numBands)
+        return ild[static_cast<size_t> (index - 5)].data();
+
+    return itd[static_cast<size_t> (index - 5 - numBands)].data();
+}
+
+juce::Result CrossfeedAnalyzer::write (const juce::File& file) const
+{
+    if (parameters.empty())
+        return juce::Result::fail ("Nothing has been analysed");
+
+    if (file.hasFileExtension ("npz"))
+        return writeNpz (file);
+
+    if (file.hasFileExtension ("csv"))
+        return writeCsv (file);
+
+    return juce::Result::fail ("Unknown output format, expected .npz or .csv: " + file.getFileName());
+}
+
+juce::Result CrossfeedAnalyzer::writeNpz (const juce::File& file) const
+{
+    // An .npz is a zip of .npy files, one per column: a magic string, version
+    // 1.0, a little-endian header length and a Python dict literal padded so
+    // the data starts on a 64-byte boundary, then the raw float32 values.
+    const auto names = getColumnNames();
+    juce::ZipFile::Builder zip;
+
+    for (int column = 0; column < names.size(); column++)
+    {
+        auto header = "{'descr': '<f4', 'fortran_order': False, 'shape': ("
+                    + juce::String (static_cast<juce::int64> (numPoints)) + ",), }";
+
+        const auto headerLength = (10 + header.length() + 1 + 63) / 64 * 64 - 10;
+        header = header.paddedRight (' ', headerLength - 1) + "\n";
+
+        juce::MemoryOutputStream npy;
+        npy.write ("\x93NUMPY\x01\x00", 8);
+        npy.writeShort (static_cast<short> (headerLength));
+        npy.write (header.toRawUTF8(), static_cast<size_t> (headerLength));
+
+        const auto* values = getColumn (column);
+
+        for (size_t i = 0; i < numPoints; i++)
+            npy.writeFloat (values[i]);
+
+        zip.addEntry (new juce::MemoryInputStream (npy.getMemoryBlock(), true), 6,
+                      names[column] + ".npy", juce::Time::getCurrentTime());
+    }
+
+    file.deleteFile();
+    juce::FileOutputStream out (file);
+
+    if (! out.openedOk() || ! zip.writeToStream (out, nullptr))
+        return juce::Result::fail ("Cannot write " + file.getFullPathName());
+
+    return juce::Result::ok();
+}
+
+juce::Result CrossfeedAnalyzer::writeCsv (const juce::File& file) const
+{
+    file.deleteFile();
+    juce::FileOutputStream out (file);
+
+    if (! out.openedOk())
+        return juce::Result::fail ("Cannot write " + file.getFullPathName());
+
+    const auto names = getColumnNames();
+    out << names.joinIntoString (",") << "\n";
+
+    std::string row;
+    char number[32];
+
+    for (size_t i = 0; i < numPoints; i++)
+    {
+        row.clear();
+
+        for (int column = 0; column < names.size(); column++)
+        {
+            std::snprintf (number, sizeof (number), column == 0 ? "%.6g" : ",%.6g", static_cast<double> (getColumn (column)[i]));
+            row += number;
+        }
+
+        row += '\n';
+        out.write (row.data(), row.size());
+    }
+
+    out.flush();
+
+    if (out.getStatus().failed())
+        return juce::Result::fail ("Cannot write " + file.getFullPathName());
+
+    return juce::Result::ok();
+}
@@ -0,0 +1,121 @@
+/*
+  ==============================================================================
+
+    Interaural level and time differences over a grid of crossfeed settings.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "CrossfeedEngine.h"
+
+//==============================================================================
+/**
+    The settings to analyse: every combination of the values on each axis.
+    Axes hold the plugin's units (delays in microseconds, crossover in Hz).
+*/
+struct CrossfeedAnalysisGrid
+{
+    std::vector<float> amplitudeLow { CrossfeedParameterSnapshot().amplitudeLow };
+    std::vector<float> amplitudeHigh { CrossfeedParameterSnapshot().amplitudeHigh };
+    std::vector<float> delayLow { CrossfeedParameterSnapshot().delayLow };
+    std::vector<float> delayHigh { CrossfeedParameterSnapshot().delayHigh };
+    std::vector<float> crossoverFrequency { CrossfeedParameterSnapshot().crossoverFrequency };
+
+    /** Parses "value", "a,b,c" or "start:end:count" into an axis. Ranges are
+        spaced linearly, or geometrically with logarithmic set (for frequencies).
+        Values outside start..end fail.
+    */
+    static juce::Result parseAxis (const juce::String& text, float start, float end, bool logarithmic,
+                                   std::vector<float>& axis);
+
+    /** Fails if the grid has more than maxPoints settings. */
+    juce::Result getNumPoints (size_t maxPoints, size_t& numPoints) const;
+
+    /** The setting at index; amplitudeLow varies slowest, crossoverFrequency fastest. */
+    CrossfeedParameterSnapshot getPoint (size_t index) const noexcept;
+};
+
+//==============================================================================
+/** One analysis band, edges at half a band either side of the centre on a log scale. */
+struct CrossfeedAnalysisBand
+{
+    double centre = 1000.0, low = 707.0, high = 1414.0;
+};
+
+//==============================================================================
+/**
+    Runs the crossfeed's impulse response for every setting of a grid and
+    reduces it to an interaural level and time difference per band.
+
+    An impulse into the left input gives the same-side response at the left
+    output and the opposite-side response at the right. Per band:
+
+      - ILD is the energy at the same-side ear over that at the opposite ear,
+        in dB; NaN where either ear gets nothing, as when nothing crosses
+        over, rather than an infinity that breaks averages and plots.
+      - ITD is the opposite-side group delay minus the same-side group delay,
+        in microseconds, averaged over the band's bins weighted by both
+        magnitudes; NaN where nothing crosses over.
+
+    Group delay comes straight from the spectra as Re (FFT (n h[n]) / FFT (h[n])),
+    so no phase unwrapping is involved. The two ears share one complex
+    transform for h and one for n h.
+
+    Settings are dealt to workers in chunks through a CrossfeedWorkStealingPool.
+    Each worker prepares its own engine per setting, so every response starts
+    from the setting itself rather than ramping from the previous one.
+*/
+class CrossfeedAnalyzer
+{
+public:
+    /** Octave bands (bandsPerOctave = 1) or fractions of an octave from 31.25 Hz
+        up to the last band that ends below Nyquist.
+    */
+    CrossfeedAnalyzer (double sampleRate, int bandsPerOctave);
+
+    const std::vector<CrossfeedAnalysisBand>& getBands() const noexcept     { return bands; }
+
+    /** Analyses every setting; results replace those of any previous run.
+        Fails if a crossover in the grid is not below Nyquist.
+    */
+    juce::Result run (const CrossfeedAnalysisGrid& grid, int numWorkers);
+
+    /** Writes the last run's results, one column per parameter and per band's
+        ILD and ITD: as .npz (one float32 .npy array per column, for
+        numpy.load or pandas) or as .csv, chosen by the file extension.
+    */
+    juce::Result write (const juce::File& file) const;
+
+    size_t getNumPoints() const noexcept            { return numPoints; }
+    int getFftSize() const noexcept                 { return fftSize; }
+    int getImpulseResponseLength() const noexcept   { return impulseResponseLength; }
+
+private:
+    //==============================================================================
+    struct Worker;
+
+    void analyse (Worker&, size_t begin, size_t end);
+
+    juce::StringArray getColumnNames() const;
+    const float* getColumn (int index) const noexcept;
+
+    juce::Result writeNpz (const juce::File&) const;
+    juce::Result writeCsv (const juce::File&) const;
+
+    //==============================================================================
+    double sampleRate;
+    std::vector<CrossfeedAnalysisBand> bands;
+    std::vector<std::pair<int, int>> bandBins;
+
+    const CrossfeedAnalysisGrid* currentGrid = nullptr;
+    int fftOrder = 0, fftSize = 0, impulseResponseLength = 0;
+    size_t numPoints = 0;
+
+    // Column-major: parameters[column][point], ild[band][point], itd[band][point].
+    std::vector<std::vector<float>> parameters, ild, itd;
+
+    JUCE_DECLARE_NON_COPYABLE (CrossfeedAnalyzer)
+};
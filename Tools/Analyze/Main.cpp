@@ -0,0 +1,142 @@
+/*
+  ==============================================================================
+
+    crossfeed-analyze: interaural level and time differences over a grid of
+    crossfeed settings.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include <iostream>
+#include "CrossfeedAnalyzer.h"
+
+//==============================================================================
+static const char* const usage =
+    "Usage: crossfeed-analyze [options] <output.npz|output.csv>\n"
+    "\n"
+    "Runs the crossfeed's impulse response for every combination of the given\n"
+    "settings and writes, per setting, the interaural level difference (dB) and\n"
+    "time difference (us) in each band. Each setting takes a single value, a list\n"
+    "(a,b,c) or a range (start:end:count); crossover ranges are spaced\n"
+    "logarithmically, the others linearly. Unset ones keep the plugin defaults.\n"
+    "Where an ear gets nothing in a band, as with no crossfeed, ILD and ITD are NaN.\n"
+    "\n"
+    ".npz output has one float32 column per parameter and per band, for\n"
+    "numpy.load or pandas.DataFrame (dict (numpy.load (file))).\n"
+    "\n"
+    "  --amplitude-low=<grid>      crossfeed amount below the crossover, 0..1\n"
+    "  --amplitude-high=<grid>     crossfeed amount above the crossover, 0..1\n"
+    "  --delay-low=<grid>          cross delay below the crossover, 0..1000 us\n"
+    "  --delay-high=<grid>         cross delay above the crossover, 0..1000 us\n"
+    "  --crossover=<grid>          crossover frequency, 20..20000 Hz and below rate / 2\n"
+    "  --rate=<Hz>                 sample rate (default 48000)\n"
+    "  --bands=<octave|third>      analysis bands (default octave)\n"
+    "  --jobs=<n>                  workers (default: number of cores)\n"
+    "\n"
+    "For example:\n"
+    "  crossfeed-analyze --amplitude-low=0.3:0.9:7 --delay-low=100:600:6 --crossover=300:3000:12 sweep.npz\n";
+
+static void parseAxis (const juce::ArgumentList& args, juce::StringRef option, float start, float end,
+                       bool logarithmic, std::vector<float>& axis)
+{
+    if (! args.containsOption (option))
+        return;
+
+    const auto result = CrossfeedAnalysisGrid::parseAxis (args.getValueForOption (option), start, end, logarithmic, axis);
+
+    if (result.failed())
+        juce::ConsoleApplication::fail (juce::String (option) + ": " + result.getErrorMessage());
+}
+
+static CrossfeedAnalysisGrid parseGrid (const juce::ArgumentList& args, double sampleRate)
+{
+    const auto maxDelay = CrossfeedEngine<float>::defaultMaxDelayMicroseconds;
+
+    CrossfeedAnalysisGrid grid;
+    parseAxis (args, "--amplitude-low", 0.f, 1.f, false, grid.amplitudeLow);
+    parseAxis (args, "--amplitude-high", 0.f, 1.f, false, grid.amplitudeHigh);
+    parseAxis (args, "--delay-low", 0.f, maxDelay, false, grid.delayLow);
+    parseAxis (args, "--delay-high", 0.f, maxDelay, false, grid.delayHigh);
+    parseAxis (args, "--crossover", 20.f, 20000.f, true, grid.crossoverFrequency);
+
+    // Checked against the rate as well, the default crossover included.
+    for (auto crossover : grid.crossoverFrequency)
+        if (! (crossover < sampleRate / 2.0))
+            juce::ConsoleApplication::fail ("--crossover: " + juce::String (crossover) + " is not below half of --rate ("
+                                            + juce::String (sampleRate / 2.0) + " Hz)");
+
+    return grid;
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    juce::ArgumentList args (argc, argv);
+
+    return juce::ConsoleApplication::invokeCatchingFailures ([&args]
+    {
+        if (args.containsOption ("--help|-h"))
+        {
+            std::cout << usage;
+            return 0;
+        }
+
+        juce::StringArray positional;
+
+        // Option values are always given as --name=value, so anything else is positional.
+        for (int i = 0; i < args.size(); i++)
+            if (! args[i].isOption())
+                positional.add (args[i].text);
+
+        if (positional.size() != 1)
+        {
+            std::cerr << usage;
+            return 1;
+        }
+
+        const auto output = juce::File::getCurrentWorkingDirectory().getChildFile (positional[0].unquoted());
+
+        if (! output.hasFileExtension ("npz;csv"))
+            juce::ConsoleApplication::fail ("The output must be a .npz or .csv file");
+
+        const auto rateText = args.getValueForOption ("--rate");
+        const auto sampleRate = args.containsOption ("--rate") ? rateText.getDoubleValue() : 48000.0;
+
+        if (! (sampleRate >= 8000.0 && sampleRate <= 768000.0) || ! rateText.containsOnly ("0123456789.eE+"))
+            juce::ConsoleApplication::fail ("--rate must be between 8000 and 768000");
+
+        const auto bandsOption = args.getValueForOption ("--bands");
+
+        if (bandsOption.isNotEmpty() && bandsOption != "octave" && bandsOption != "third")
+            juce::ConsoleApplication::fail ("Unknown --bands: " + bandsOption);
+
+        const auto jobsOption = args.getValueForOption ("--jobs").getIntValue();
+        const auto numWorkers = jobsOption > 0 ? jobsOption : juce::SystemStats::getNumCpus();
+
+        const auto grid = parseGrid (args, sampleRate);
+        CrossfeedAnalyzer analyzer (sampleRate, bandsOption == "third" ? 3 : 1);
+
+        const auto startTime = juce::Time::getMillisecondCounterHiRes();
+        const auto result = analyzer.run (grid, numWorkers);
+
+        if (result.failed())
+            juce::ConsoleApplication::fail (result.getErrorMessage());
+
+        const auto seconds = (juce::Time::getMillisecondCounterHiRes() - startTime) / 1000.0;
+        const auto written = analyzer.write (output);
+
+        if (written.failed())
+            juce::ConsoleApplication::fail (written.getErrorMessage());
+
+        std::cout << analyzer.getNumPoints() << " settings x " << analyzer.getBands().size() << " bands ("
+                  << analyzer.getImpulseResponseLength() << "-sample responses, " << analyzer.getFftSize() << "-point FFT) in "
+                  << juce::String (seconds, 2) << " s on " << numWorkers << " workers, "
+                  << juce::String (static_cast<double> (analyzer.getNumPoints()) / juce::jmax (seconds, 1.0e-6), 0)
+                  << " settings/s" << std::endl
+                  << "Wrote " << output.getFullPathName() << std::endl;
+
+        return 0;
+    });
+}
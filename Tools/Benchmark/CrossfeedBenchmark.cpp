@@ -0,0 +1,599 @@
+/*
+  ==============================================================================
+
+    Micro-benchmarks for the crossfeed DSP.
+
+  ==============================================================================
+*/
+
+#include "CrossfeedBenchmark.h"
+#include "PluginProcessor.h"
+#include "CrossfeedBank.h"
+#include "CrossfeedConvolution.h"
+#include <cstdlib>
+#include <iomanip>
+#include <map>
+#include <new>
+#include <ostream>
+
+#if JUCE_INTEL && JUCE_MSVC
+ #include <intrin.h>
+#elif JUCE_INTEL
+ #include <x86intrin.h>
+#endif
+
+//==============================================================================
+// Counting replacements for the global allocation functions. Only allocations
+// made between startCountingAllocations() and stopCountingAllocations() are
+// counted, from any thread.
+
+static std::atomic<bool> countingAllocations { false };
+static std::atomic<int> allocationCount { 0 };
+
+static void* countedAllocation (std::size_t size)
+{
+    if (countingAllocations.load (std::memory_order_relaxed))
+        allocationCount.fetch_add (1, std::memory_order_relaxed);
+
+    if (auto* p = std::malloc (size == 0 ? 1 : size))
+        return p;
+
+    throw std::bad_alloc();
+}
+
+void* operator new (std::size_t size)                       { return countedAllocation (size); }
+void* operator new[] (std::size_t size)                     { return countedAllocation (size); }
+void operator delete (void* p) noexcept                     { std::free (p); }
+void operator delete[] (void* p) noexcept                   { std::free (p); }
+void operator delete (void* p, std::size_t) noexcept        { std::free (p); }
+void operator delete[] (void* p, std::size_t) noexcept      { std::free (p); }
+
+void CrossfeedBenchmark::startCountingAllocations() noexcept
+{
+    allocationCount = 0;
+    countingAllocations = true;
+}
+
+int CrossfeedBenchmark::stopCountingAllocations() noexcept
+{
+    countingAllocations = false;
+    return allocationCount.load();
+}
+
+juce::int64 CrossfeedBenchmark::readCycleCounter() noexcept
+{
+   #if JUCE_INTEL
+    return static_cast<juce::int64> (__rdtsc());
+   #else
+    return 0;
+   #endif
+}
+
+//==============================================================================
+namespace
+{
+    enum class Input { silence, noise, denormal };
+
+    const char* getInputName (Input input)
+    {
+        switch (input)
+        {
+            case Input::silence:    return "silence";
+            case Input::noise:      return "noise";
+            case Input::denormal:   return "denormal";
+        }
+
+        return "";
+    }
+
+    void fillInput (juce::AudioBuffer<float>& buffer, Input input)
+    {
+        juce::Random random (0x5eed);
+
+        // Denormal-prone input keeps every product in the filters near the bottom of the float range.
+        const auto level = input == Input::silence ? 0.f : (input == Input::noise ? 0.5f : 1.0e-38f);
+
+        // That alone would count as silence and let the kernel go idle, so a
+        // -140 dBFS tick comes in more often than the shortest tail lasts.
+        const auto keepAliveInterval = 32;
+
+        for (int channel = 0; channel < buffer.getNumChannels(); channel++)
+        {
+            auto* data = buffer.getWritePointer (channel);
+
+            for (int i = 0; i < buffer.getNumSamples(); i++)
+                data[i] = input == Input::denormal && i % keepAliveInterval == 0 ? 1.0e-7f
+                                                                                 : level * (random.nextFloat() * 2.f - 1.f);
+        }
+    }
+}
+
+//==============================================================================
+CrossfeedBenchmark::CrossfeedBenchmark (const Settings& settings)
+    : filter (settings.filter), passes (juce::jmax (1, settings.passes)), fullSweep (settings.fullSweep)
+{
+}
+
+std::vector<int> CrossfeedBenchmark::getBlockSizes() const
+{
+    if (! fullSweep)
+        return { 1, 8, 32, 64, 256, 1024, 8192 };
+
+    std::vector<int> sizes;
+
+    for (int size = 1; size <= 8192; size *= 2)
+        sizes.push_back (size);
+
+    return sizes;
+}
+
+void CrossfeedBenchmark::runProcessBlockSuite()
+{
+    const double sampleRates[] = { 44100.0, 48000.0, 96000.0, 192000.0, 384000.0 };
+
+    for (auto sampleRate : sampleRates)
+    {
+        for (auto blockSize : getBlockSizes())
+        {
+            for (auto automated : { false, true })
+            {
+                for (auto input : { Input::silence, Input::noise, Input::denormal })
+                {
+                    const auto name = "processBlock/" + juce::String (juce::roundToInt (sampleRate)) + "/" + juce::String (blockSize)
+                                    + (automated ? "/automated/" : "/static/") + getInputName (input);
+
+                    if (filter.isNotEmpty() && ! name.contains (filter))
+                        continue;
+
+                    const auto numBlocks = juce::jmax (8, 16384 / blockSize);
+                    const auto numSamples = numBlocks * blockSize;
+
+                    CrossfeedAudioProcessor processor;
+                    processor.setPlayConfigDetails (2, 2, sampleRate, blockSize);
+                    processor.prepareToPlay (sampleRate, blockSize);
+
+                    juce::AudioBuffer<float> source (2, numSamples), work (2, numSamples);
+                    fillInput (source, input);
+
+                    juce::AudioProcessorParameter* parameters[] = { processor.amplitudeLow, processor.amplitudeHigh,
+                                                                    processor.delayLow, processor.delayHigh,
+                                                                    processor.crossoverFrequency };
+
+                    // Host-style automation: every parameter moves on every block, from a precomputed table,
+                    // and the listeners are told, which is what hands the values to the audio thread.
+                    std::vector<float> automation (static_cast<size_t> (numBlocks) * 5);
+
+                    for (int block = 0; block < numBlocks; block++)
+                        for (int p = 0; p < 5; p++)
+                            automation[static_cast<size_t> (block * 5 + p)] = 0.5f + 0.4f * std::sin (0.05f * static_cast<float> (block) + static_cast<float> (p));
+
+                    juce::MidiBuffer midi;
+
+                    measure (name, numSamples,
+                             [&] { work.makeCopyOf (source, true); },
+                             [&]
+                             {
+                                 for (int block = 0; block < numBlocks; block++)
+                                 {
+                                     if (automated)
+                                         for (int p = 0; p < 5; p++)
+                                             parameters[p]->setValueNotifyingHost (automation[static_cast<size_t> (block * 5 + p)]);
+
+                                     juce::AudioBuffer<float> view (work.getArrayOfWritePointers(), 2, block * blockSize, blockSize);
+                                     processor.processBlock (view, midi);
+                                 }
+                             });
+
+                    // The last block must have run with the last automated values.
+                    if (automated && ! results.empty() && results.back().name == name)
+                    {
+                        const CrossfeedParameterSnapshot automatedValues { processor.amplitudeLow->get(), processor.amplitudeHigh->get(),
+                                                                           processor.delayLow->get(), processor.delayHigh->get(),
+                                                                           processor.crossoverFrequency->get() };
+
+                        results.back().automationIgnored = ! (processor.getProcessedParameters() == automatedValues)
+                                                            || automatedValues == CrossfeedParameterSnapshot();
+                    }
+                }
+            }
+        }
+    }
+}
+
+void CrossfeedBenchmark::runPathSuite()
+{
+    struct Preset
+    {
+        const char* name;
+        float amplitudeLow, amplitudeHigh, delayLow, delayHigh;
+    };
+
+    const Preset presets[] = { { "general",         .75f, .1f, 250.f, 100.f },
+                               { "noHighCrossfeed", .75f, 0.f, 250.f, 100.f },
+                               { "noDelay",         .75f, .1f, 0.f,   0.f },
+                               { "bypass",          0.f,  0.f, 250.f, 100.f } };
+
+    const auto sampleRate = 48000.0;
+
+    for (const auto& preset : presets)
+    {
+        for (auto blockSize : getBlockSizes())
+        {
+            const auto numBlocks = juce::jmax (8, 16384 / blockSize);
+            const auto numSamples = numBlocks * blockSize;
+
+            CrossfeedAudioProcessor processor;
+            processor.setPlayConfigDetails (2, 2, sampleRate, blockSize);
+            processor.prepareToPlay (sampleRate, blockSize);
+
+            *processor.amplitudeLow = preset.amplitudeLow;
+            *processor.amplitudeHigh = preset.amplitudeHigh;
+            *processor.delayLow = preset.delayLow;
+            *processor.delayHigh = preset.delayHigh;
+
+            juce::AudioBuffer<float> source (2, numSamples), work (2, numSamples);
+            fillInput (source, Input::noise);
+
+            juce::MidiBuffer midi;
+
+            measure ("path/" + juce::String (preset.name) + "/" + juce::String (blockSize), numSamples,
+                     [&] { work.makeCopyOf (source, true); },
+                     [&]
+                     {
+                         for (int block = 0; block < numBlocks; block++)
+                         {
+                             juce::AudioBuffer<float> view (work.getArrayOfWritePointers(), 2, block * blockSize, blockSize);
+                             processor.processBlock (view, midi);
+                         }
+                     });
+        }
+    }
+}
+
+void CrossfeedBenchmark::runScheduleSuite()
+{
+    struct Schedule
+    {
+        const char* name;
+        int minimumSize, maximumSize;
+    };
+
+    const Schedule schedules[] = { { "1",        1,    1 },
+                                   { "3",        3,    3 },
+                                   { "8",        8,    8 },
+                                   { "17",       17,   17 },
+                                   { "32",       32,   32 },
+                                   { "100",      100,  100 },
+                                   { "512",      512,  512 },
+                                   { "8192",     8192, 8192 },
+                                   { "1-32",     1,    32 },
+                                   { "1-8192",   1,    8192 } };
+
+    const auto sampleRate = 48000.0;
+    const auto numSamples = 65536;
+
+    for (const auto& schedule : schedules)
+    {
+        // Block sizes are drawn up front, so every pass sees the same sequence.
+        std::vector<int> blockSizes;
+        juce::Random random (42);
+
+        for (int total = 0; total < numSamples;)
+        {
+            const auto size = juce::jmin (numSamples - total,
+                                          schedule.minimumSize + random.nextInt (schedule.maximumSize - schedule.minimumSize + 1));
+            blockSizes.push_back (size);
+            total += size;
+        }
+
+        CrossfeedAudioProcessor processor;
+        processor.setPlayConfigDetails (2, 2, sampleRate, schedule.maximumSize);
+        processor.prepareToPlay (sampleRate, schedule.maximumSize);
+
+        juce::AudioBuffer<float> source (2, numSamples), work (2, numSamples);
+        fillInput (source, Input::noise);
+
+        juce::MidiBuffer midi;
+
+        measure ("schedule/" + juce::String (schedule.name), numSamples,
+                 [&] { work.makeCopyOf (source, true); },
+                 [&]
+                 {
+                     auto offset = 0;
+                     auto step = -1;
+
+                     for (auto size : blockSizes)
+                     {
+                         // Automation moves once per 256 samples, whatever the block size.
+                         if (offset / 256 != step)
+                         {
+                             step = offset / 256;
+                             *processor.crossoverFrequency = 1500.f + 500.f * std::sin (0.01f * static_cast<float> (step));
+                         }
+
+                         juce::AudioBuffer<float> view (work.getArrayOfWritePointers(), 2, offset, size);
+                         processor.processBlock (view, midi);
+                         offset += size;
+                     }
+                 });
+    }
+}
+
+//==============================================================================
+void CrossfeedBenchmark::printResults (std::ostream& out) const
+{
+    out << std::left << std::setw (56) << "case" << std::right
+        << std::setw (12) << "ns/sample" << std::setw (14) << "cycles/sample" << std::setw (8) << "allocs" << std::endl;
+
+    for (const auto& result : results)
+    {
+        out << std::left << std::setw (56) << result.name.toStdString() << std::right << std::fixed << std::setprecision (2)
+            << std::setw (12) << result.nsPerSample << std::setw (14) << result.cyclesPerSample
+            << std::setw (8) << result.allocations << std::endl;
+    }
+}
+
+juce::var CrossfeedBenchmark::toJSON() const
+{
+    juce::Array<juce::var> cases;
+
+    for (const auto& result : results)
+    {
+        auto* entry = new juce::DynamicObject();
+        entry->setProperty ("name", result.name);
+        entry->setProperty ("nsPerSample", result.nsPerSample);
+        entry->setProperty ("cyclesPerSample", result.cyclesPerSample);
+        entry->setProperty ("allocations", result.allocations);
+        cases.add (juce::var (entry));
+    }
+
+    auto* root = new juce::DynamicObject();
+    root->setProperty ("cpu", juce::SystemStats::getCpuModel());
+    root->setProperty ("cpuMHz", juce::SystemStats::getCpuSpeedInMegahertz());
+    root->setProperty ("cases", cases);
+    return juce::var (root);
+}
+
+int CrossfeedBenchmark::compare (const juce::var& baseline, double threshold, std::ostream& out) const
+{
+    std::map<juce::String, double> reference;
+
+    if (auto* cases = baseline["cases"].getArray())
+        for (const auto& entry : *cases)
+            reference[entry["name"].toString()] = static_cast<double> (entry["nsPerSample"]);
+
+    int failures = 0;
+
+    for (const auto& result : results)
+    {
+        if (result.allocations > 0)
+        {
+            out << "ALLOCATES: " << result.name << " (" << result.allocations << " allocations)" << std::endl;
+            failures++;
+        }
+
+        if (result.automationIgnored)
+        {
+            out << "NOT AUTOMATED: " << result.name << " (parameter changes never reached the audio thread)" << std::endl;
+            failures++;
+        }
+
+        const auto found = reference.find (result.name);
+
+        if (found == reference.end() || found->second <= 0.0)
+            continue;
+
+        const auto change = result.nsPerSample / found->second - 1.0;
+
+        if (change > threshold)
+        {
+            out << "REGRESSION: " << result.name << " " << juce::String (found->second, 2) << " -> "
+                << juce::String (result.nsPerSample, 2) << " ns/sample (+" << juce::String (change * 100.0, 1) << "%)" << std::endl;
+            failures++;
+        }
+    }
+
+    return failures;
+}
+
+//==============================================================================
+void CrossfeedBenchmark::runBankSuite()
+{
+    const auto sampleRate = 48000.0;
+    const auto blockSize = 256;
+    const auto numBlocks = 16;
+    const auto numSamples = blockSize * numBlocks;
+
+    for (int numStreams = 1; numStreams <= 256; numStreams *= 2)
+    {
+        std::vector<juce::AudioBuffer<float>> source, work;
+
+        for (int stream = 0; stream < numStreams; stream++)
+        {
+            source.emplace_back (2, numSamples);
+            work.emplace_back (2, numSamples);
+            fillInput (source.back(), Input::noise);
+        }
+
+        std::vector<float*> left (static_cast<size_t> (numStreams)), right (static_cast<size_t> (numStreams));
+
+        auto copyInput = [&]
+        {
+            for (size_t stream = 0; stream < source.size(); stream++)
+                work[stream].makeCopyOf (source[stream], true);
+        };
+
+        // Per-sample figures count stream-frames, so flat numbers mean linear scaling.
+        CrossfeedBank<> bank;
+        bank.prepare (sampleRate, numStreams);
+
+        for (int stream = 0; stream < numStreams; stream++)
+            bank.setParameters (stream, { .75f, .1f, 250.f, 100.f, 500.f + 10.f * static_cast<float> (stream) });
+
+        measure ("bank/" + juce::String (numStreams), numSamples * numStreams, copyInput, [&]
+        {
+            for (int block = 0; block < numBlocks; block++)
+            {
+                for (size_t stream = 0; stream < left.size(); stream++)
+                {
+                    left[stream] = work[stream].getWritePointer (0, block * blockSize);
+                    right[stream] = work[stream].getWritePointer (1, block * blockSize);
+                }
+
+                bank.process (left.data(), right.data(), blockSize);
+            }
+        });
+
+        std::vector<CrossfeedKernel<>> kernels (static_cast<size_t> (numStreams));
+
+        for (size_t stream = 0; stream < kernels.size(); stream++)
+        {
+            kernels[stream].prepare (sampleRate);
+            kernels[stream].setParameters (500.f + 10.f * static_cast<float> (stream), 12.f, 4.8f, .75f, .1f);
+        }
+
+        measure ("kernels/" + juce::String (numStreams), numSamples * numStreams, copyInput, [&]
+        {
+            for (int block = 0; block < numBlocks; block++)
+                for (size_t stream = 0; stream < kernels.size(); stream++)
+                    kernels[stream].process (work[stream].getWritePointer (0, block * blockSize),
+                                             work[stream].getWritePointer (1, block * blockSize), blockSize);
+        });
+    }
+}
+
+//==============================================================================
+void CrossfeedBenchmark::runConvolutionSuite()
+{
+    const auto sampleRate = 48000.0;
+    const int lengths[] = { 256, 2048, 16384 };
+
+    for (auto blockSize : getBlockSizes())
+    {
+        const auto numBlocks = juce::jmax (8, 16384 / blockSize);
+        const auto numSamples = numBlocks * blockSize;
+
+        juce::AudioBuffer<float> source (2, numSamples), work (2, numSamples);
+        fillInput (source, Input::noise);
+
+        CrossfeedKernel<> kernel;
+        kernel.prepare (sampleRate);
+        kernel.setParameters (2000.f, 12.f, 4.8f, .75f, .1f);
+
+        measure ("iir/" + juce::String (blockSize), numSamples, [&] { work.makeCopyOf (source, true); }, [&]
+        {
+            for (int block = 0; block < numBlocks; block++)
+                kernel.process (work.getWritePointer (0, block * blockSize), work.getWritePointer (1, block * blockSize), blockSize);
+        });
+
+        for (auto length : lengths)
+        {
+            // Exponentially decaying noise, roughly the energy envelope of a measured response.
+            juce::AudioBuffer<float> responses (CrossfeedConvolution::numPaths, length);
+            juce::Random random (length);
+
+            for (int path = 0; path < responses.getNumChannels(); path++)
+                for (int i = 0; i < length; i++)
+                    responses.setSample (path, i, (random.nextFloat() * 2.f - 1.f) * std::exp (-6.f * static_cast<float> (i) / static_cast<float> (length)));
+
+            CrossfeedConvolution convolution;
+            convolution.prepare (length);
+            convolution.setFilter (std::make_unique<CrossfeedConvolution::Filter> (responses));
+            convolution.isReady();
+
+            measure ("hrtf/" + juce::String (length) + "/" + juce::String (blockSize), numSamples,
+                     [&] { work.makeCopyOf (source, true); },
+                     [&]
+                     {
+                         for (int block = 0; block < numBlocks; block++)
+                             convolution.process (work.getWritePointer (0, block * blockSize), work.getWritePointer (1, block * blockSize), blockSize);
+                     });
+        }
+    }
+}
+
+//==============================================================================
+void CrossfeedBenchmark::runSurroundSuite()
+{
+    struct Layout
+    {
+        const char* name;
+        juce::AudioChannelSet channels;
+    };
+
+    const Layout layouts[] = { { "5.1",   juce::AudioChannelSet::create5point1() },
+                               { "7.1",   juce::AudioChannelSet::create7point1() },
+                               { "7.1.4", juce::AudioChannelSet::create7point1point4() } };
+
+    const auto sampleRate = 48000.0;
+
+    for (const auto& layout : layouts)
+    {
+        const auto numChannels = layout.channels.size();
+        const auto speakers = CrossfeedAudioProcessor::getSurroundSpeakers (layout.channels);
+
+        for (auto blockSize : getBlockSizes())
+        {
+            const auto numBlocks = juce::jmax (8, 16384 / blockSize);
+            const auto numSamples = numBlocks * blockSize;
+
+            juce::AudioBuffer<float> source (numChannels, numSamples), work (numChannels, numSamples);
+            fillInput (source, Input::noise);
+
+            juce::MidiBuffer midi;
+
+            // Downmix and per-speaker crossfeed in the processor's single pass.
+            CrossfeedAudioProcessor processor;
+            juce::AudioProcessor::BusesLayout buses;
+            buses.inputBuses.add (layout.channels);
+            buses.outputBuses.add (juce::AudioChannelSet::stereo());
+
+            if (! processor.setBusesLayout (buses))
+                continue;
+
+            processor.setRateAndBufferSizeDetails (sampleRate, blockSize);
+            processor.prepareToPlay (sampleRate, blockSize);
+
+            measure ("surround/" + juce::String (layout.name) + "/" + juce::String (blockSize), numSamples,
+                     [&] { work.makeCopyOf (source, true); },
+                     [&]
+                     {
+                         for (int block = 0; block < numBlocks; block++)
+                         {
+                             juce::AudioBuffer<float> view (work.getArrayOfWritePointers(), numChannels, block * blockSize, blockSize);
+                             processor.processBlock (view, midi);
+                         }
+                     });
+
+            // What it replaces: a separate downmix pass with the same gains, then the stereo processor.
+            CrossfeedAudioProcessor stereo;
+            stereo.setPlayConfigDetails (2, 2, sampleRate, blockSize);
+            stereo.prepareToPlay (sampleRate, blockSize);
+
+            juce::AudioBuffer<float> downmix (2, blockSize);
+
+            measure ("downmix+stereo/" + juce::String (layout.name) + "/" + juce::String (blockSize), numSamples,
+                     [&] { work.makeCopyOf (source, true); },
+                     [&]
+                     {
+                         for (int block = 0; block < numBlocks; block++)
+                         {
+                             downmix.clear();
+
+                             for (int channel = 0; channel < numChannels; channel++)
+                             {
+                                 const auto& speaker = speakers[static_cast<size_t> (channel)];
+                                 const auto* input = work.getReadPointer (channel, block * blockSize);
+                                 const auto toLeft = speaker.azimuth < 0.f ? speaker.gain : (speaker.azimuth > 0.f ? 0.f : 0.70710678f * speaker.gain);
+                                 const auto toRight = speaker.azimuth > 0.f ? speaker.gain : (speaker.azimuth < 0.f ? 0.f : 0.70710678f * speaker.gain);
+
+                                 juce::FloatVectorOperations::addWithMultiply (downmix.getWritePointer (0), input, toLeft, blockSize);
+                                 juce::FloatVectorOperations::addWithMultiply (downmix.getWritePointer (1), input, toRight, blockSize);
+                             }
+
+                             stereo.processBlock (downmix, midi);
+                         }
+                     });
+        }
+    }
+}
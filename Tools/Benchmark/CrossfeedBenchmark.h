@@ -0,0 +1,144 @@
+/*
+  ==============================================================================
+
+    Micro-benchmarks for the crossfeed DSP.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <iosfwd>
+
+//==============================================================================
+/** One measured configuration. name is the key used to match against a baseline. */
+struct CrossfeedBenchmarkResult
+{
+    juce::String name;
+    double nsPerSample = 0.0;
+    double cyclesPerSample = 0.0;
+    int allocations = 0;
+    bool automationIgnored = false;     // automated parameters never reached the audio thread
+};
+
+//==============================================================================
+/**
+    Runs the benchmark suites and compares them against a stored baseline.
+
+    Each case is timed as the best of several passes over a pre-generated
+    signal; per-sample figures count stereo frames. Heap allocations made
+    while a case is being timed are counted too, and any at all is reported
+    as a failure, since none of the measured code may run on the allocator.
+    So is an automated case whose parameter changes the audio thread never
+    saw, which would time the static path under the wrong name.
+*/
+class CrossfeedBenchmark
+{
+public:
+    struct Settings
+    {
+        bool fullSweep = false;     // every power of two block size instead of a selection
+        int passes = 5;
+        juce::String filter;        // only run cases whose name contains this
+    };
+
+    explicit CrossfeedBenchmark (const Settings&);
+
+    /** CrossfeedAudioProcessor::processBlock across block sizes, sample rates,
+        static and automated parameters, and silent, noise and denormal-prone input.
+    */
+    void runProcessBlockSuite();
+
+    /** processBlock with settings that select each of the specialised kernel paths. */
+    void runPathSuite();
+
+    /** processBlock over the same signal with fixed, odd and randomly varying host
+        block sizes, with automated parameters. The per-sample cost should be flat.
+    */
+    void runScheduleSuite();
+
+    /** CrossfeedBank with 1 to 256 streams, against the same number of separate kernels. */
+    void runBankSuite();
+
+    /** CrossfeedConvolution (HRTF mode) with short to long responses, against the
+        two-band kernel, across block sizes.
+    */
+    void runConvolutionSuite();
+
+    /** processBlock with 5.1, 7.1 and 7.1.4 input, downmixed and crossfed in one
+        pass, against a separate downmix pass followed by the stereo processor.
+        Per-sample figures count input frames.
+    */
+    void runSurroundSuite();
+
+    const std::vector<CrossfeedBenchmarkResult>& getResults() const noexcept    { return results; }
+
+    //==============================================================================
+    /** Times pass() (which processes samplesPerPass frames) the given number of times
+        and records the best run. prepare() is called untimed before every pass.
+    */
+    template <typename PrepareFunction, typename PassFunction>
+    void measure (const juce::String& name, int samplesPerPass, PrepareFunction&& prepare, PassFunction&& pass)
+    {
+        if (filter.isNotEmpty() && ! name.contains (filter))
+            return;
+
+        prepare();
+        pass(); // warm-up
+
+        CrossfeedBenchmarkResult result;
+        result.name = name;
+        result.nsPerSample = std::numeric_limits<double>::max();
+        result.cyclesPerSample = std::numeric_limits<double>::max();
+
+        for (int i = 0; i < passes; i++)
+        {
+            prepare();
+
+            startCountingAllocations();
+            const auto startTicks = juce::Time::getHighResolutionTicks();
+            const auto startCycles = readCycleCounter();
+
+            pass();
+
+            const auto cycles = readCycleCounter() - startCycles;
+            const auto ticks = juce::Time::getHighResolutionTicks() - startTicks;
+            result.allocations += stopCountingAllocations();
+
+            const auto ns = juce::Time::highResolutionTicksToSeconds (ticks) * 1.0e9 / samplesPerPass;
+            result.nsPerSample = juce::jmin (result.nsPerSample, ns);
+            result.cyclesPerSample = juce::jmin (result.cyclesPerSample,
+                                                 cycles > 0 ? static_cast<double> (cycles) / samplesPerPass
+                                                            : ns * juce::SystemStats::getCpuSpeedInMegahertz() / 1000.0);
+        }
+
+        results.push_back (result);
+    }
+
+    //==============================================================================
+    /** Writes the results as a table. */
+    void printResults (std::ostream&) const;
+
+    /** The results as JSON, suitable as a baseline for later runs. */
+    juce::var toJSON() const;
+
+    /** Reports every case that is more than threshold (e.g. 0.1 = 10%) slower than
+        in baseline, and every case that allocated. Returns the number of failures.
+    */
+    int compare (const juce::var& baseline, double threshold, std::ostream&) const;
+
+    /** Block sizes covered by the suites. */
+    std::vector<int> getBlockSizes() const;
+
+    static juce::int64 readCycleCounter() noexcept;
+    static void startCountingAllocations() noexcept;
+    static int stopCountingAllocations() noexcept;
+
+private:
+    juce::String filter;
+    int passes;
+    bool fullSweep;
+
+    std::vector<CrossfeedBenchmarkResult> results;
+};
@@ -0,0 +1,99 @@
+/*
+  ==============================================================================
+
+    crossfeed-bench: measures the cost of the crossfeed DSP.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include <iostream>
+#include "CrossfeedBenchmark.h"
+
+//==============================================================================
+static const char* const usage =
+    "Usage: crossfeed-bench [options]\n"
+    "\n"
+    "  --suite=<name>              processBlock, paths, schedule, bank, hrtf or surround\n"
+    "                              (default: all)\n"
+    "  --full                      every power of two block size from 1 to 8192\n"
+    "  --passes=<n>                timed passes per case, the best is kept (default 5)\n"
+    "  --filter=<text>             only run cases whose name contains text\n"
+    "  --output=<file>             write the results as JSON\n"
+    "  --baseline=<file>           compare against earlier JSON results\n"
+    "  --threshold=<fraction>      allowed slowdown against the baseline (default 0.1)\n"
+    "\n"
+    "Exits with 1 if a case regressed beyond the threshold or allocated memory.\n";
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    juce::ArgumentList args (argc, argv);
+
+    return juce::ConsoleApplication::invokeCatchingFailures ([&args]
+    {
+        if (args.containsOption ("--help|-h"))
+        {
+            std::cout << usage;
+            return 0;
+        }
+
+        CrossfeedBenchmark::Settings settings;
+        settings.fullSweep = args.containsOption ("--full");
+        settings.filter = args.getValueForOption ("--filter");
+
+        if (args.containsOption ("--passes"))
+            settings.passes = args.getValueForOption ("--passes").getIntValue();
+
+        CrossfeedBenchmark benchmark (settings);
+        const auto suite = args.getValueForOption ("--suite");
+
+        if (suite.isEmpty() || suite == "processBlock")
+            benchmark.runProcessBlockSuite();
+
+        if (suite.isEmpty() || suite == "paths")
+            benchmark.runPathSuite();
+
+        if (suite.isEmpty() || suite == "schedule")
+            benchmark.runScheduleSuite();
+
+        if (suite.isEmpty() || suite == "bank")
+            benchmark.runBankSuite();
+
+        if (suite.isEmpty() || suite == "hrtf")
+            benchmark.runConvolutionSuite();
+
+        if (suite.isEmpty() || suite == "surround")
+            benchmark.runSurroundSuite();
+
+        benchmark.printResults (std::cout);
+
+        const auto cwd = juce::File::getCurrentWorkingDirectory();
+
+        if (args.containsOption ("--output"))
+        {
+            const auto file = cwd.getChildFile (args.getValueForOption ("--output"));
+
+            if (! file.replaceWithText (juce::JSON::toString (benchmark.toJSON())))
+                juce::ConsoleApplication::fail ("Cannot write " + file.getFullPathName());
+        }
+
+        juce::var baseline;
+
+        if (args.containsOption ("--baseline"))
+        {
+            const auto file = cwd.getChildFile (args.getValueForOption ("--baseline"));
+            const auto parsed = juce::JSON::parse (file.loadFileAsString(), baseline);
+
+            if (parsed.failed())
+                juce::ConsoleApplication::fail ("Cannot parse " + file.getFullPathName() + ": " + parsed.getErrorMessage());
+        }
+
+        const auto threshold = args.containsOption ("--threshold")
+                             ? args.getValueForOption ("--threshold").getDoubleValue()
+                             : 0.1;
+
+        return benchmark.compare (baseline, threshold, std::cout) > 0 ? 1 : 0;
+    });
+}
@@ -0,0 +1,281 @@
+/*
+  ==============================================================================
+
+    Streams raw interleaved PCM through CrossfeedAudioProcessor.
+
+  ==============================================================================
+*/
+
+#include "CrossfeedPipe.h"
+#include <thread>
+
+//==============================================================================
+namespace
+{
+    template <typename SampleFormat>
+    using InterleavedPointer = juce::AudioData::Pointer<SampleFormat, juce::AudioData::LittleEndian,
+                                                        juce::AudioData::Interleaved, juce::AudioData::Const>;
+
+    template <typename SampleFormat>
+    using InterleavedDestination = juce::AudioData::Pointer<SampleFormat, juce::AudioData::LittleEndian,
+                                                            juce::AudioData::Interleaved, juce::AudioData::NonConst>;
+
+    using FloatPointer = juce::AudioData::Pointer<juce::AudioData::Float32, juce::AudioData::NativeEndian,
+                                                  juce::AudioData::NonInterleaved, juce::AudioData::Const>;
+
+    using FloatDestination = juce::AudioData::Pointer<juce::AudioData::Float32, juce::AudioData::NativeEndian,
+                                                      juce::AudioData::NonInterleaved, juce::AudioData::NonConst>;
+
+    template <typename SampleFormat>
+    void deinterleave (const char* data, int bytesPerSample, juce::AudioBuffer<float>& buffer, int numFrames)
+    {
+        for (int channel = 0; channel < 2; channel++)
+            FloatDestination (buffer.getWritePointer (channel))
+                .convertSamples (InterleavedPointer<SampleFormat> (data + channel * bytesPerSample, 2), numFrames);
+    }
+
+    template <typename SampleFormat>
+    void interleave (const juce::AudioBuffer<float>& buffer, char* data, int bytesPerSample, int numFrames)
+    {
+        for (int channel = 0; channel < 2; channel++)
+            InterleavedDestination<SampleFormat> (data + channel * bytesPerSample, 2)
+                .convertSamples (FloatPointer (buffer.getReadPointer (channel)), numFrames);
+    }
+
+    template <typename Queue>
+    int take (Queue& queue, juce::WaitableEvent& ready)
+    {
+        int index;
+
+        while (queue.pop (&index, 1) == 0)
+            ready.wait();
+
+        return index;
+    }
+
+    template <typename Queue>
+    void give (Queue& queue, juce::WaitableEvent& ready, int index)
+    {
+        // Never full: there are only as many indices as slots.
+        queue.push (index);
+        ready.signal();
+    }
+}
+
+//==============================================================================
+CrossfeedPipe::CrossfeedPipe (const CrossfeedRenderOptions& o, double rate, CrossfeedPipeFormat f)
+    : options (o), sampleRate (rate), format (f), bytesPerFrame (2 * getBytesPerSample (f))
+{
+    for (auto& slot : slots)
+        slot.data.calloc (static_cast<size_t> (options.blockSize * bytesPerFrame));
+
+    buffer.setSize (2, options.blockSize);
+}
+
+int CrossfeedPipe::getBytesPerSample (CrossfeedPipeFormat f) noexcept
+{
+    switch (f)
+    {
+        case CrossfeedPipeFormat::s16:  return 2;
+        case CrossfeedPipeFormat::s24:  return 3;
+        case CrossfeedPipeFormat::s32:
+        case CrossfeedPipeFormat::f32:  break;
+    }
+
+    return 4;
+}
+
+std::optional<CrossfeedPipeFormat> CrossfeedPipe::parseFormat (const juce::String& text)
+{
+    if (text == "s16")  return CrossfeedPipeFormat::s16;
+    if (text == "s24")  return CrossfeedPipeFormat::s24;
+    if (text == "s32")  return CrossfeedPipeFormat::s32;
+    if (text == "f32")  return CrossfeedPipeFormat::f32;
+
+    return {};
+}
+
+//==============================================================================
+juce::Result CrossfeedPipe::run (const Source& source, const Sink& sink, CrossfeedPipeStats* stats)
+{
+    const auto startTime = juce::Time::getMillisecondCounterHiRes();
+
+    processor.setNonRealtime (false);
+    processor.setPlayConfigDetails (2, 2, sampleRate, options.blockSize);
+
+    const auto applied = CrossfeedFileRenderer::applyOptions (processor, options);
+
+    if (applied.failed())
+        return applied;
+
+    processor.prepareToPlay (sampleRate, options.blockSize);
+
+    const auto loaded = CrossfeedFileRenderer::waitForImpulseResponse (processor);
+
+    if (loaded.failed())
+        return loaded;
+
+    latency = processor.getLatencySamples();
+
+    for (int index = 0; index < numSlots; index++)
+        freeSlots.push (index);
+
+    std::thread reader ([this, &source] { readLoop (source); });
+    std::thread writer ([this, &sink] { writeLoop (sink); });
+
+    juce::MidiBuffer midi;
+    CrossfeedPerformanceStats performance;
+    juce::int64 frames = 0;
+    auto toSkip = latency;
+
+    for (;;)
+    {
+        const auto index = take (filledSlots, filledReady);
+        auto& slot = slots[static_cast<size_t> (index)];
+        const auto numFrames = slot.numBytes / bytesPerFrame;
+
+        if (numFrames > 0 && ! failed)
+        {
+            decode (slot.data, format, buffer, numFrames);
+
+            juce::AudioBuffer<float> view (buffer.getArrayOfWritePointers(), 2, numFrames);
+            processor.processBlock (view, midi);
+            performance.addAll (processor.getPerformanceMonitor());
+
+            encode (buffer, format, slot.data, numFrames);
+
+            const auto skipped = juce::jmin (toSkip, numFrames);
+            slot.skipBytes = skipped * bytesPerFrame;
+            toSkip -= skipped;
+            frames += numFrames - skipped;
+        }
+
+        give (processedSlots, processedReady, index);
+
+        if (numFrames == 0)
+            break;
+    }
+
+    reader.join();
+    writer.join();
+
+    processor.releaseResources();
+
+    if (stats != nullptr)
+    {
+        stats->frames = frames;
+        stats->wallSeconds = (juce::Time::getMillisecondCounterHiRes() - startTime) / 1000.0;
+        stats->sampleRate = sampleRate;
+        stats->bytesPerFrame = bytesPerFrame;
+        stats->performance = performance;
+    }
+
+    return failed ? juce::Result::fail (error) : juce::Result::ok();
+}
+
+//==============================================================================
+void CrossfeedPipe::readLoop (const Source& source)
+{
+    const auto capacity = options.blockSize * bytesPerFrame;
+    auto flushFrames = latency;
+    auto ended = false;
+
+    for (;;)
+    {
+        const auto index = take (freeSlots, freeReady);
+        auto& slot = slots[static_cast<size_t> (index)];
+        slot.numBytes = 0;
+        slot.skipBytes = 0;
+
+        // Hand on whatever arrived as soon as it is whole frames.
+        while (! ended && (slot.numBytes == 0 || slot.numBytes % bytesPerFrame != 0))
+        {
+            const auto numRead = failed ? 0 : source (slot.data + slot.numBytes, capacity - slot.numBytes);
+
+            if (numRead < 0)
+                fail ("Read error on input");
+
+            if (numRead > 0)
+                slot.numBytes += numRead;
+            else
+                ended = true;
+        }
+
+        if (ended)
+        {
+            // A trailing partial frame is dropped.
+            slot.numBytes -= slot.numBytes % bytesPerFrame;
+
+            if (slot.numBytes == 0 && flushFrames > 0 && ! failed)
+            {
+                // Zero bytes are silence in every format.
+                const auto numFrames = juce::jmin (flushFrames, options.blockSize);
+                std::fill (slot.data.get(), slot.data + numFrames * bytesPerFrame, 0);
+                slot.numBytes = numFrames * bytesPerFrame;
+                flushFrames -= numFrames;
+            }
+        }
+
+        const auto isEnd = slot.numBytes == 0;
+        give (filledSlots, filledReady, index);
+
+        if (isEnd)
+            return;
+    }
+}
+
+void CrossfeedPipe::writeLoop (const Sink& sink)
+{
+    for (;;)
+    {
+        const auto index = take (processedSlots, processedReady);
+        const auto& slot = slots[static_cast<size_t> (index)];
+
+        if (slot.numBytes == 0)
+            return;
+
+        // After a failure the slots keep circulating until the end, but nothing more is written.
+        if (slot.numBytes > slot.skipBytes && ! failed)
+            if (! sink (slot.data + slot.skipBytes, slot.numBytes - slot.skipBytes))
+                fail ("Write error on output");
+
+        give (freeSlots, freeReady, index);
+    }
+}
+
+void CrossfeedPipe::fail (const juce::String& message)
+{
+    const juce::ScopedLock lock (errorLock);
+
+    if (! failed)
+        error = message;
+
+    failed = true;
+}
+
+//==============================================================================
+void CrossfeedPipe::decode (const char* data, CrossfeedPipeFormat f, juce::AudioBuffer<float>& buffer, int numFrames)
+{
+    const auto bytesPerSample = getBytesPerSample (f);
+
+    switch (f)
+    {
+        case CrossfeedPipeFormat::s16:  deinterleave<juce::AudioData::Int16> (data, bytesPerSample, buffer, numFrames); break;
+        case CrossfeedPipeFormat::s24:  deinterleave<juce::AudioData::Int24> (data, bytesPerSample, buffer, numFrames); break;
+        case CrossfeedPipeFormat::s32:  deinterleave<juce::AudioData::Int32> (data, bytesPerSample, buffer, numFrames); break;
+        case CrossfeedPipeFormat::f32:  deinterleave<juce::AudioData::Float32> (data, bytesPerSample, buffer, numFrames); break;
+    }
+}
+
+void CrossfeedPipe::encode (const juce::AudioBuffer<float>& buffer, CrossfeedPipeFormat f, char* data, int numFrames)
+{
+    const auto bytesPerSample = getBytesPerSample (f);
+
+    switch (f)
+    {
+        case CrossfeedPipeFormat::s16:  interleave<juce::AudioData::Int16> (buffer, data, bytesPerSample, numFrames); break;
+        case CrossfeedPipeFormat::s24:  interleave<juce::AudioData::Int24> (buffer, data, bytesPerSample, numFrames); break;
+        case CrossfeedPipeFormat::s32:  interleave<juce::AudioData::Int32> (buffer, data, bytesPerSample, numFrames); break;
+        case CrossfeedPipeFormat::f32:  interleave<juce::AudioData::Float32> (buffer, data, bytesPerSample, numFrames); break;
+    }
+}
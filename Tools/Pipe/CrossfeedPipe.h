@@ -0,0 +1,130 @@
+/*
+  ==============================================================================
+
+    Streams raw interleaved PCM through CrossfeedAudioProcessor.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <functional>
+#include "CrossfeedFileRenderer.h"
+
+//==============================================================================
+/** Raw sample encodings the pipe reads and writes, all little-endian and interleaved. */
+enum class CrossfeedPipeFormat
+{
+    s16,
+    s24,    // packed, three bytes per sample
+    s32,
+    f32
+};
+
+//==============================================================================
+/** What a pipe run moved and what it cost. */
+struct CrossfeedPipeStats
+{
+    juce::int64 frames = 0;
+    double wallSeconds = 0.0;
+    double sampleRate = 44100.0;
+    int bytesPerFrame = 4;
+
+    /** Block timings from the processor's instrumentation. */
+    CrossfeedPerformanceStats performance;
+
+    double getRealtimeFactor() const noexcept       { return wallSeconds > 0.0 ? static_cast<double> (frames) / sampleRate / wallSeconds : 0.0; }
+    double getMegabytesPerSecond() const noexcept   { return wallSeconds > 0.0 ? static_cast<double> (frames * bytesPerFrame) / (1024.0 * 1024.0) / wallSeconds : 0.0; }
+};
+
+//==============================================================================
+/**
+    Runs stereo PCM from a byte source to a byte sink through the processor.
+
+    Reading, processing and writing run on three threads. Reads and writes
+    block on the pipes at either end, so on one thread the processor would
+    sit idle during both; on their own threads the three stages overlap and
+    the slowest of them alone sets the rate.
+
+    The raw blocks themselves circulate between the threads: the reader
+    fills a slot straight from the source, the processing thread converts it
+    in place, and the writer hands the same memory to the sink before the
+    slot goes back to the reader. Only slot indices cross threads, through
+    wait-free queues. Three slots are one per stage, so the reader can fill
+    one while another is processed and a third is drained; with fewer, one
+    stage would always wait for another, and more would only buffer more,
+    since no stage can run ahead of the slowest for long. The price is
+    latency: a block that has been read may wait for the one before it to be
+    processed, which adds up to one block of buffering on top of the
+    processor's own latency.
+
+    The reader passes on whatever the source delivered as soon as it holds
+    whole frames, without waiting to fill a block, so a slow upstream is not
+    held back by the block size. Processor latency (HRTF mode) is
+    compensated: the first latency frames out are dropped and as many frames
+    of silence are pushed through at the end, so output and input have the
+    same length.
+*/
+class CrossfeedPipe
+{
+public:
+    /** Reads up to numBytes into destination; returns the count read, 0 at the end, or -1 on error. */
+    using Source = std::function<int (void* destination, int numBytes)>;
+
+    /** Writes all of numBytes; returns false on error. */
+    using Sink = std::function<bool (const void* data, int numBytes)>;
+
+    CrossfeedPipe (const CrossfeedRenderOptions&, double sampleRate, CrossfeedPipeFormat);
+
+    /** Processes the source until it ends, then returns once everything is written. */
+    juce::Result run (const Source&, const Sink&, CrossfeedPipeStats* stats = nullptr);
+
+    static int getBytesPerSample (CrossfeedPipeFormat) noexcept;
+
+    /** Parses "s16", "s24", "s32" or "f32". */
+    static std::optional<CrossfeedPipeFormat> parseFormat (const juce::String&);
+
+    /** Converts numFrames interleaved stereo frames to the first numFrames samples of a stereo buffer. */
+    static void decode (const char* data, CrossfeedPipeFormat, juce::AudioBuffer<float>&, int numFrames);
+
+    /** The reverse of decode(); the integer formats clip. */
+    static void encode (const juce::AudioBuffer<float>&, CrossfeedPipeFormat, char* data, int numFrames);
+
+private:
+    //==============================================================================
+    struct Slot
+    {
+        juce::HeapBlock<char> data;
+        int numBytes = 0;       // 0 marks the end of the stream
+        int skipBytes = 0;      // leading output bytes that are latency, not signal
+    };
+
+    static constexpr int numSlots = 3;
+
+    void readLoop (const Source&);
+    void writeLoop (const Sink&);
+    void fail (const juce::String&);
+
+    //==============================================================================
+    CrossfeedRenderOptions options;
+    double sampleRate;
+    CrossfeedPipeFormat format;
+    int bytesPerFrame;
+
+    CrossfeedAudioProcessor processor;
+    juce::AudioBuffer<float> buffer;
+
+    std::array<Slot, numSlots> slots;
+
+    // Slot indices on their way round: free -> filled -> processed -> free.
+    CrossfeedSPSCQueue<int, numSlots + 1> freeSlots, filledSlots, processedSlots;
+    juce::WaitableEvent freeReady, filledReady, processedReady;
+
+    int latency = 0;
+    std::atomic<bool> failed { false };
+    juce::CriticalSection errorLock;
+    juce::String error;
+
+    JUCE_DECLARE_NON_COPYABLE (CrossfeedPipe)
+};
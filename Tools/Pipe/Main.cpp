@@ -0,0 +1,246 @@
+/*
+  ==============================================================================
+
+    crossfeed-pipe: applies the crossfeed to raw PCM from stdin to stdout.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include "CrossfeedPipe.h"
+
+#if JUCE_WINDOWS
+ #include <fcntl.h>
+ #include <io.h>
+#else
+ #include <unistd.h>
+#endif
+
+//==============================================================================
+static const char* const usage =
+    "Usage: crossfeed-pipe [options] < input.raw > output.raw\n"
+    "       crossfeed-pipe [options] --throughput[=<seconds>]\n"
+    "\n"
+    "Reads interleaved stereo PCM on stdin and writes the processed PCM, in the\n"
+    "same format and of the same length, to stdout. For example:\n"
+    "  ffmpeg -i in.flac -f s16le -ac 2 -ar 48000 - | crossfeed-pipe --rate=48000 | aplay -f S16_LE -c 2 -r 48000\n"
+    "\n"
+    "  --rate=<Hz>                 sample rate (default 48000)\n"
+    "  --format=<s16|s24|s32|f32>  little-endian sample format, s24 packed (default s16)\n"
+    "  --block-size=<frames>       largest block processed at once (default 256); the\n"
+    "                              pipeline buffers up to one extra block, so latency\n"
+    "                              grows with it\n"
+    "  --amplitude-low=<0..1>      crossfeed amount below the crossover\n"
+    "  --amplitude-high=<0..1>     crossfeed amount above the crossover\n"
+    "  --delay-low=<us>            cross delay below the crossover\n"
+    "  --delay-high=<us>           cross delay above the crossover\n"
+    "  --crossover=<Hz>            crossover frequency\n"
+    "  --hrir=<file>               HRTF mode with measured responses (2 or 4 channels)\n"
+    "  --state=<file>              load parameters from a saved plugin state\n"
+    "  --throughput[=<seconds>]    process generated noise instead of stdin, discard the\n"
+    "                              output and report the throughput (default 600 s of audio)\n"
+    "  --stats                     print processBlock timing statistics at the end\n"
+    "                              (to stderr when piping)\n";
+
+static std::optional<float> getFloatOption (const juce::ArgumentList& args, juce::StringRef option)
+{
+    if (! args.containsOption (option))
+        return {};
+
+    const auto text = args.getValueForOption (option);
+
+    if (! text.containsOnly ("0123456789.-+eE") || text.isEmpty())
+        juce::ConsoleApplication::fail ("Invalid value for " + juce::String (option) + ": " + text);
+
+    return text.getFloatValue();
+}
+
+static CrossfeedRenderOptions parseOptions (const juce::ArgumentList& args)
+{
+    CrossfeedRenderOptions options;
+    options.blockSize = 256;
+
+    if (args.containsOption ("--state"))
+    {
+        const auto file = juce::File::getCurrentWorkingDirectory().getChildFile (args.getValueForOption ("--state").unquoted());
+
+        if (! file.loadFileAsData (options.state))
+            juce::ConsoleApplication::fail ("Cannot read state from " + file.getFullPathName());
+    }
+
+    options.amplitudeLow       = getFloatOption (args, "--amplitude-low");
+    options.amplitudeHigh      = getFloatOption (args, "--amplitude-high");
+    options.delayLow           = getFloatOption (args, "--delay-low");
+    options.delayHigh          = getFloatOption (args, "--delay-high");
+    options.crossoverFrequency = getFloatOption (args, "--crossover");
+
+    if (args.containsOption ("--hrir"))
+        options.impulseResponse = juce::File::getCurrentWorkingDirectory().getChildFile (args.getValueForOption ("--hrir").unquoted());
+
+    if (args.containsOption ("--block-size"))
+        options.blockSize = args.getValueForOption ("--block-size").getIntValue();
+
+    if (options.blockSize <= 0)
+        juce::ConsoleApplication::fail ("--block-size must be positive");
+
+    return options;
+}
+
+//==============================================================================
+static int readStandardInput (void* destination, int numBytes)
+{
+    for (;;)
+    {
+       #if JUCE_WINDOWS
+        const auto numRead = _read (0, destination, static_cast<unsigned int> (numBytes));
+       #else
+        const auto numRead = ::read (0, destination, static_cast<size_t> (numBytes));
+
+        if (numRead < 0 && errno == EINTR)
+            continue;
+       #endif
+
+        return static_cast<int> (numRead);
+    }
+}
+
+static bool writeStandardOutput (const void* data, int numBytes)
+{
+    auto* bytes = static_cast<const char*> (data);
+
+    while (numBytes > 0)
+    {
+       #if JUCE_WINDOWS
+        const auto numWritten = _write (1, bytes, static_cast<unsigned int> (numBytes));
+       #else
+        const auto numWritten = ::write (1, bytes, static_cast<size_t> (numBytes));
+
+        if (numWritten < 0 && errno == EINTR)
+            continue;
+       #endif
+
+        if (numWritten <= 0)
+            return false;
+
+        bytes += numWritten;
+        numBytes -= static_cast<int> (numWritten);
+    }
+
+    return true;
+}
+
+//==============================================================================
+/** Stands in for stdin with a loop of pre-generated noise, so only the pipe itself is measured. */
+static int runThroughput (const CrossfeedRenderOptions& options, double sampleRate, CrossfeedPipeFormat format,
+                          double seconds, bool printStats)
+{
+    const auto bytesPerFrame = 2 * CrossfeedPipe::getBytesPerSample (format);
+
+    // One second of noise at -6 dBFS, encoded through the same converters as the pipe uses.
+    juce::MemoryBlock noise;
+    {
+        const auto numFrames = juce::roundToInt (sampleRate);
+        juce::AudioBuffer<float> buffer (2, numFrames);
+        juce::Random random (42);
+
+        for (int channel = 0; channel < 2; channel++)
+            for (int i = 0; i < numFrames; i++)
+                buffer.setSample (channel, i, 0.5f * (random.nextFloat() * 2.f - 1.f));
+
+        noise.setSize (static_cast<size_t> (numFrames * bytesPerFrame));
+        CrossfeedPipe::encode (buffer, format, static_cast<char*> (noise.getData()), numFrames);
+    }
+
+    auto remaining = static_cast<juce::int64> (seconds * sampleRate) * bytesPerFrame;
+    size_t position = 0;
+
+    const auto source = [&] (void* destination, int numBytes)
+    {
+        const auto numToCopy = static_cast<int> (juce::jmin (static_cast<juce::int64> (numBytes), remaining,
+                                                             static_cast<juce::int64> (noise.getSize() - position)));
+
+        std::memcpy (destination, static_cast<const char*> (noise.getData()) + position, static_cast<size_t> (numToCopy));
+        position = (position + static_cast<size_t> (numToCopy)) % noise.getSize();
+        remaining -= numToCopy;
+        return numToCopy;
+    };
+
+    const auto sink = [] (const void*, int) { return true; };
+
+    CrossfeedPipe pipe (options, sampleRate, format);
+    CrossfeedPipeStats stats;
+    const auto result = pipe.run (source, sink, &stats);
+
+    if (result.failed())
+        juce::ConsoleApplication::fail (result.getErrorMessage());
+
+    std::cout << stats.frames << " frames in " << juce::String (stats.wallSeconds, 3) << " s: "
+              << juce::String (stats.getRealtimeFactor(), 1) << "x realtime, "
+              << juce::String (stats.getMegabytesPerSecond(), 1) << " MB/s" << std::endl;
+
+    if (printStats)
+        std::cout << stats.performance.toString();
+
+    return 0;
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    juce::ArgumentList args (argc, argv);
+
+    return juce::ConsoleApplication::invokeCatchingFailures ([&args]
+    {
+        if (args.containsOption ("--help|-h"))
+        {
+            std::cout << usage;
+            return 0;
+        }
+
+        const auto options = parseOptions (args);
+        const auto sampleRate = getFloatOption (args, "--rate").value_or (48000.f);
+
+        if (sampleRate < 8000.f || sampleRate > 768000.f)
+            juce::ConsoleApplication::fail ("--rate must be between 8000 and 768000");
+
+        auto format = CrossfeedPipeFormat::s16;
+
+        if (args.containsOption ("--format"))
+        {
+            const auto parsed = CrossfeedPipe::parseFormat (args.getValueForOption ("--format"));
+
+            if (! parsed.has_value())
+                juce::ConsoleApplication::fail ("Unknown --format: " + args.getValueForOption ("--format"));
+
+            format = *parsed;
+        }
+
+        if (args.containsOption ("--throughput"))
+        {
+            const auto seconds = args.getValueForOption ("--throughput").getDoubleValue();
+            return runThroughput (options, sampleRate, format, seconds > 0.0 ? seconds : 600.0, args.containsOption ("--stats"));
+        }
+
+       #if JUCE_WINDOWS
+        _setmode (0, _O_BINARY);
+        _setmode (1, _O_BINARY);
+       #endif
+
+        // stdout carries the audio, so everything else goes to stderr.
+        CrossfeedPipe pipe (options, sampleRate, format);
+        CrossfeedPipeStats stats;
+        const auto result = pipe.run (readStandardInput, writeStandardOutput, &stats);
+
+        if (result.failed())
+            juce::ConsoleApplication::fail (result.getErrorMessage());
+
+        if (args.containsOption ("--stats"))
+            std::cerr << stats.performance.toString();
+
+        return 0;
+    });
+}
@@ -0,0 +1,169 @@
+/*
+  ==============================================================================
+
+    Renders many files in parallel, one processor per worker.
+
+  ==============================================================================
+*/
+
+#include "CrossfeedBatchRenderer.h"
+#include "CrossfeedWorkStealingPool.h"
+#include <ostream>
+
+//==============================================================================
+static juce::String formatStats (const CrossfeedRenderStats& stats)
+{
+    return juce::String (stats.audioSeconds, 1) + " s audio, "
+         + juce::String (stats.wallSeconds, 2) + " s wall, "
+         + juce::String (stats.getRealtimeFactor(), 1) + "x realtime, "
+         + juce::String (stats.getMegabytesPerSecond(), 1) + " MB/s, worst block "
+         + juce::String (stats.performance.worstLoad * 100.0, 2) + "% of realtime";
+}
+
+static juce::File makeOutputFile (const juce::File& input, const juce::File& base,
+                                  const juce::File& outputDirectory, const juce::String& extension)
+{
+    auto output = outputDirectory.getChildFile (input.getRelativePathFrom (base));
+    return extension.isEmpty() ? output : output.withFileExtension (extension);
+}
+
+//==============================================================================
+CrossfeedBatchRenderer::CrossfeedBatchRenderer (const CrossfeedRenderOptions& o, int workers)
+    : options (o), numWorkers (juce::jmax (1, workers))
+{
+    // Every worker pipelines its own I/O; keep a few chunks in flight each way.
+    if (options.ioBufferSize <= 0)
+        options.ioBufferSize = 4 * options.blockSize;
+}
+
+juce::Result CrossfeedBatchRenderer::collectJobs (const juce::File& source,
+                                                  const juce::File& outputDirectory,
+                                                  const juce::String& extension,
+                                                  std::vector<CrossfeedBatchJob>& jobs)
+{
+    if (source.isDirectory())
+    {
+        juce::AudioFormatManager formats;
+        formats.registerBasicFormats();
+
+        for (const auto& entry : juce::RangedDirectoryIterator (source, true, formats.getWildcardForAllFormats()))
+        {
+            CrossfeedBatchJob job;
+            job.input = entry.getFile();
+            job.output = makeOutputFile (job.input, source, outputDirectory, extension);
+            jobs.push_back (job);
+        }
+    }
+    else if (source.existsAsFile())
+    {
+        juce::StringArray lines;
+        source.readLines (lines);
+
+        const auto base = source.getParentDirectory();
+
+        for (auto line : lines)
+        {
+            line = line.trim();
+
+            if (line.isEmpty() || line.startsWithChar ('#'))
+                continue;
+
+            CrossfeedBatchJob job;
+            job.input = base.getChildFile (line.upToFirstOccurrenceOf ("\t", false, false).trim());
+            job.output = line.containsChar ('\t')
+                       ? base.getChildFile (line.fromFirstOccurrenceOf ("\t", false, false).trim())
+                       : makeOutputFile (job.input, base, outputDirectory, extension);
+            jobs.push_back (job);
+        }
+    }
+    else
+    {
+        return juce::Result::fail ("No such file or directory: " + source.getFullPathName());
+    }
+
+    for (auto& job : jobs)
+    {
+        if (job.input == job.output)
+            return juce::Result::fail ("Refusing to overwrite the input " + job.input.getFullPathName());
+
+        job.inputSize = job.input.getSize();
+    }
+
+    return juce::Result::ok();
+}
+
+//==============================================================================
+juce::Result CrossfeedBatchRenderer::run (std::vector<CrossfeedBatchJob>& jobs, std::ostream& report)
+{
+    // Largest files first, so the tail of the batch is made of short jobs that
+    // idle workers can steal.
+    std::sort (jobs.begin(), jobs.end(), [] (const auto& a, const auto& b) { return a.inputSize > b.inputSize; });
+
+    struct Worker
+    {
+        explicit Worker (const CrossfeedRenderOptions& o, int index)
+            : ioThread ("crossfeed I/O " + juce::String (index)), renderer (o)
+        {
+            ioThread.startThread();
+            renderer.setIOThread (&ioThread);
+        }
+
+        ~Worker()
+        {
+            ioThread.stopThread (10000);
+        }
+
+        juce::TimeSliceThread ioThread;
+        CrossfeedFileRenderer renderer;
+    };
+
+    CrossfeedWorkStealingPool<CrossfeedBatchJob> pool (numWorkers);
+
+    std::vector<std::unique_ptr<Worker>> workers;
+
+    for (int i = 0; i < pool.getNumWorkers(); i++)
+        workers.push_back (std::make_unique<Worker> (options, i));
+
+    std::mutex reportLock;
+    const auto startTime = juce::Time::getMillisecondCounterHiRes();
+
+    pool.run (jobs, [&] (int worker, CrossfeedBatchJob& job)
+    {
+        job.output.getParentDirectory().createDirectory();
+        job.result = workers[static_cast<size_t> (worker)]->renderer.render (job.input, job.output, &job.stats);
+
+        const std::lock_guard<std::mutex> guard (reportLock);
+
+        if (job.result.wasOk())
+            report << job.input.getFullPathName() << ": " << formatStats (job.stats) << std::endl;
+        else
+            report << job.input.getFullPathName() << ": FAILED: " << job.result.getErrorMessage() << std::endl;
+    });
+
+    workers.clear();
+
+    CrossfeedRenderStats total;
+    total.wallSeconds = (juce::Time::getMillisecondCounterHiRes() - startTime) / 1000.0;
+    int failures = 0;
+
+    for (const auto& job : jobs)
+    {
+        if (job.result.failed())
+        {
+            failures++;
+            continue;
+        }
+
+        total.audioSeconds += job.stats.audioSeconds;
+        total.bytesRead += job.stats.bytesRead;
+        total.bytesWritten += job.stats.bytesWritten;
+    }
+
+    report << static_cast<int> (jobs.size()) - failures << " of " << jobs.size() << " files on "
+           << pool.getNumWorkers() << " workers: " << formatStats (total) << std::endl;
+
+    if (failures > 0)
+        return juce::Result::fail (juce::String (failures) + " file(s) failed");
+
+    return juce::Result::ok();
+}
@@ -0,0 +1,54 @@
+/*
+  ==============================================================================
+
+    Renders many files in parallel, one processor per worker.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <iosfwd>
+#include "CrossfeedFileRenderer.h"
+
+//==============================================================================
+/** One file of a batch, and how its render went. */
+struct CrossfeedBatchJob
+{
+    juce::File input, output;
+    juce::int64 inputSize = 0;
+
+    juce::Result result = juce::Result::ok();
+    CrossfeedRenderStats stats;
+};
+
+//==============================================================================
+/**
+*/
+class CrossfeedBatchRenderer
+{
+public:
+    CrossfeedBatchRenderer (const CrossfeedRenderOptions&, int numWorkers);
+
+    /** Builds the job list from a directory (searched recursively for audio
+        files) or from a manifest with one "input[<tab>output]" per line.
+
+        Outputs without an explicit path go into outputDirectory, keeping the
+        path relative to the source directory (or the manifest's directory).
+        A non-empty extension replaces the input file's extension.
+    */
+    static juce::Result collectJobs (const juce::File& source,
+                                     const juce::File& outputDirectory,
+                                     const juce::String& extension,
+                                     std::vector<CrossfeedBatchJob>& jobs);
+
+    /** Renders all jobs, writing one report line per file and a summary to report. */
+    juce::Result run (std::vector<CrossfeedBatchJob>& jobs, std::ostream& report);
+
+private:
+    CrossfeedRenderOptions options;
+    int numWorkers;
+
+    JUCE_DECLARE_NON_COPYABLE (CrossfeedBatchRenderer)
+};
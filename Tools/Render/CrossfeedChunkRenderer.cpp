@@ -0,0 +1,301 @@
+/*
+  ==============================================================================
+
+    Renders a single long file on several cores.
+
+  ==============================================================================
+*/
+
+#include "CrossfeedChunkRenderer.h"
+#include <condition_variable>
+#include <mutex>
+#include <ostream>
+#include <thread>
+
+//==============================================================================
+namespace
+{
+    /** Reads length frames from position and processes them into destination (or a scratch buffer). */
+    bool processRange (juce::AudioFormatReader& reader, CrossfeedAudioProcessor& processor,
+                       juce::AudioBuffer<float>& destination, juce::int64 position, int length, int blockSize)
+    {
+        juce::MidiBuffer midi;
+        const auto reuseDestination = destination.getNumSamples() >= length;
+
+        for (int offset = 0; offset < length; offset += blockSize)
+        {
+            const auto numSamples = juce::jmin (blockSize, length - offset);
+            juce::AudioBuffer<float> block (destination.getArrayOfWritePointers(), 2,
+                                            reuseDestination ? offset : 0, numSamples);
+
+            if (! reader.read (&block, 0, numSamples, position + offset, true, true))
+                return false;
+
+            if (reader.numChannels == 1)
+                block.copyFrom (1, 0, block, 0, 0, numSamples);
+
+            processor.processBlock (block, midi);
+        }
+
+        return true;
+    }
+}
+
+//==============================================================================
+CrossfeedChunkRenderer::CrossfeedChunkRenderer (const CrossfeedRenderOptions& o, int workers,
+                                                double seconds, double toleranceDecibels)
+    : options (o),
+      numWorkers (juce::jmax (1, workers)),
+      segmentSeconds (seconds),
+      tolerance (juce::Decibels::decibelsToGain (toleranceDecibels, -400.0))
+{
+}
+
+int CrossfeedChunkRenderer::getPreRollSamples (CrossfeedAudioProcessor& processor, double sampleRate, double tolerance)
+{
+    const auto maxDelay = juce::jmax (processor.delayLow->range.end, processor.delayHigh->range.end) / 1000.0 / 1000.0;
+
+    // Settle at least as far as the tail the processor reports to hosts; a
+    // tighter --tolerance gets a longer pre-roll, a looser one only a looser check.
+    const auto settlingTolerance = juce::jmin (tolerance, CrossfeedAudioProcessor::tailTolerance);
+
+    // Filter settling, plus a full delay history and the interpolator's extra taps.
+    return CrossfeedCoefficients<double>::getSettlingSamples (sampleRate, *processor.crossoverFrequency, settlingTolerance)
+         + static_cast<int> (std::ceil (maxDelay * sampleRate)) + 4;
+}
+
+//==============================================================================
+juce::Result CrossfeedChunkRenderer::render (const juce::File& input, const juce::File& output,
+                                             bool verify, std::ostream& report)
+{
+    const auto startTime = juce::Time::getMillisecondCounterHiRes();
+
+    juce::AudioFormatManager formatManager;
+    formatManager.registerBasicFormats();
+
+    std::unique_ptr<juce::AudioFormatReader> info (formatManager.createReaderFor (input));
+
+    if (info == nullptr)
+        return juce::Result::fail ("Cannot read " + input.getFullPathName());
+
+    if (info->numChannels < 1 || info->numChannels > 2)
+        return juce::Result::fail (input.getFileName() + ": only mono and stereo files are supported");
+
+    const auto sampleRate = info->sampleRate;
+    const auto lengthInSamples = info->lengthInSamples;
+    const auto bits = options.bitsPerSample > 0 ? options.bitsPerSample : static_cast<int> (info->bitsPerSample);
+
+    juce::String error;
+    auto writer = CrossfeedFileRenderer::createWriter (formatManager, output, sampleRate, bits, error);
+
+    if (writer == nullptr)
+        return juce::Result::fail (error);
+
+    auto makeProcessor = [this, sampleRate]
+    {
+        auto processor = std::make_unique<CrossfeedAudioProcessor>();
+        processor->setNonRealtime (true);
+        processor->setPlayConfigDetails (2, 2, sampleRate, options.blockSize);
+        CrossfeedFileRenderer::applyOptions (*processor, options);
+        return processor;
+    };
+
+    auto probe = makeProcessor();
+
+    // Segments are stitched sample for sample, which a convolution's latency would break.
+    if (probe->getImpulseResponseFile() != juce::File())
+        return juce::Result::fail ("HRTF mode cannot be rendered with --parallel");
+
+    const auto preRoll = getPreRollSamples (*probe, sampleRate, tolerance);
+    const auto segmentLength = juce::jmax (preRoll, options.blockSize, juce::roundToInt (segmentSeconds * sampleRate));
+    const auto numSegments = static_cast<int> ((lengthInSamples + segmentLength - 1) / segmentLength);
+
+    // Everything below the lock is touched by the worker whose segment is next in line.
+    std::mutex lock;
+    std::condition_variable turn;
+    int nextToWrite = 0;
+    std::atomic<bool> failed { false };
+    juce::String firstError;
+
+    // Verify mode: a serial processor renders the whole file on its own thread,
+    // and the workers hand their segments over to it, in order, one at a time.
+    std::mutex verifyLock;
+    std::condition_variable verifyTurn;
+    juce::AudioBuffer<float> handedOver;
+    int nextToVerify = 0;
+    bool handedOverFull = false;
+    float maxError = 0.f;
+
+    if (verify)
+        handedOver.setSize (2, segmentLength);
+
+    auto fail = [&] (const juce::String& message)
+    {
+        {
+            const std::lock_guard<std::mutex> guard (lock);
+
+            if (! failed)
+                firstError = message;
+
+            failed = true;
+            turn.notify_all();
+        }
+
+        // Taking the lock makes sure no waiter misses the news between its check and its wait.
+        const std::lock_guard<std::mutex> guard (verifyLock);
+        verifyTurn.notify_all();
+    };
+
+    std::atomic<int> nextSegment { 0 };
+
+    auto work = [&]
+    {
+        juce::AudioFormatManager formats;
+        formats.registerBasicFormats();
+
+        std::unique_ptr<juce::AudioFormatReader> reader (formats.createReaderFor (input));
+        auto processor = makeProcessor();
+        juce::AudioBuffer<float> segment (2, segmentLength);
+        juce::AudioBuffer<float> scratch (2, options.blockSize);
+
+        if (reader == nullptr)
+            return fail ("Cannot read " + input.getFullPathName());
+
+        for (;;)
+        {
+            const auto index = nextSegment++;
+
+            if (index >= numSegments)
+                return;
+
+            const auto start = static_cast<juce::int64> (index) * segmentLength;
+            const auto length = static_cast<int> (juce::jmin (static_cast<juce::int64> (segmentLength), lengthInSamples - start));
+            const auto warmUpStart = juce::jmax (static_cast<juce::int64> (0), start - preRoll);
+
+            // prepareToPlay resets all processor state; the pre-roll then rebuilds it.
+            processor->prepareToPlay (sampleRate, options.blockSize);
+
+            if (! processRange (*reader, *processor, scratch, warmUpStart, static_cast<int> (start - warmUpStart), options.blockSize)
+                || ! processRange (*reader, *processor, segment, start, length, options.blockSize))
+                return fail ("Read error in " + input.getFullPathName());
+
+            std::unique_lock<std::mutex> guard (lock);
+            turn.wait (guard, [&] { return failed || nextToWrite == index; });
+
+            if (failed)
+                return;
+
+            if (! writer->writeFromAudioSampleBuffer (segment, 0, length))
+            {
+                guard.unlock();
+                return fail ("Write error in " + output.getFullPathName());
+            }
+
+            nextToWrite++;
+            turn.notify_all();
+            guard.unlock();
+
+            if (verify)
+            {
+                std::unique_lock<std::mutex> verifyGuard (verifyLock);
+                verifyTurn.wait (verifyGuard, [&] { return failed || (nextToVerify == index && ! handedOverFull); });
+
+                if (failed)
+                    return;
+
+                for (int channel = 0; channel < 2; channel++)
+                    handedOver.copyFrom (channel, 0, segment, channel, 0, length);
+
+                handedOverFull = true;
+                verifyTurn.notify_all();
+            }
+        }
+    };
+
+    auto verifySerial = [&]
+    {
+        juce::AudioFormatManager formats;
+        formats.registerBasicFormats();
+
+        std::unique_ptr<juce::AudioFormatReader> reader (formats.createReaderFor (input));
+        auto processor = makeProcessor();
+        juce::AudioBuffer<float> serial (2, segmentLength);
+
+        if (reader == nullptr)
+            return fail ("Cannot read " + input.getFullPathName());
+
+        processor->prepareToPlay (sampleRate, options.blockSize);
+
+        for (int index = 0; index < numSegments; index++)
+        {
+            const auto start = static_cast<juce::int64> (index) * segmentLength;
+            const auto length = static_cast<int> (juce::jmin (static_cast<juce::int64> (segmentLength), lengthInSamples - start));
+
+            if (! processRange (*reader, *processor, serial, start, length, options.blockSize))
+                return fail ("Read error in " + input.getFullPathName());
+
+            std::unique_lock<std::mutex> guard (verifyLock);
+            verifyTurn.wait (guard, [&] { return failed || handedOverFull; });
+
+            if (failed)
+                return;
+
+            for (int channel = 0; channel < 2; channel++)
+            {
+                const auto* a = handedOver.getReadPointer (channel);
+                const auto* b = serial.getReadPointer (channel);
+
+                for (int i = 0; i < length; i++)
+                    maxError = juce::jmax (maxError, std::abs (a[i] - b[i]));
+            }
+
+            handedOverFull = false;
+            nextToVerify++;
+            verifyTurn.notify_all();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    std::thread verifier;
+
+    if (verify)
+        verifier = std::thread (verifySerial);
+
+    for (int i = 0; i < juce::jmin (numWorkers, juce::jmax (1, numSegments)); i++)
+        threads.emplace_back (work);
+
+    for (auto& thread : threads)
+        thread.join();
+
+    if (verifier.joinable())
+        verifier.join();
+
+    writer.reset();
+
+    if (failed)
+        return juce::Result::fail (firstError);
+
+    CrossfeedRenderStats stats;
+    stats.audioSeconds = static_cast<double> (lengthInSamples) / sampleRate;
+    stats.wallSeconds = (juce::Time::getMillisecondCounterHiRes() - startTime) / 1000.0;
+    stats.bytesRead = input.getSize();
+    stats.bytesWritten = output.getSize();
+
+    report << input.getFullPathName() << ": " << numSegments << " segments of " << segmentLength
+           << " frames, " << preRoll << " frames pre-roll, " << static_cast<int> (threads.size()) << " workers, "
+           << juce::String (stats.getRealtimeFactor(), 1) << "x realtime, "
+           << juce::String (stats.getMegabytesPerSecond(), 1) << " MB/s" << std::endl;
+
+    if (verify)
+    {
+        const auto errorDecibels = juce::Decibels::gainToDecibels (maxError, -400.f);
+
+        report << "Largest difference to serial processing: " << juce::String (errorDecibels, 1) << " dBFS"
+               << " (tolerance " << juce::String (juce::Decibels::gainToDecibels (tolerance, -400.0), 1) << " dB)" << std::endl;
+
+        if (maxError > tolerance)
+            return juce::Result::fail ("Parallel output differs from serial processing beyond the tolerance");
+    }
+
+    return juce::Result::ok();
+}
@@ -0,0 +1,50 @@
+/*
+  ==============================================================================
+
+    Renders a single long file on several cores.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <iosfwd>
+#include "CrossfeedFileRenderer.h"
+
+//==============================================================================
+/**
+    Splits a file into segments that are processed in parallel and stitched
+    back together in order.
+
+    The crossfeed has short memory: two first-order filters and at most a
+    millisecond of delay. Each segment is therefore preceded by a pre-roll,
+    processed and discarded, that is long enough for the filter state to
+    settle to within the tolerance and to fill the delay history. Segments
+    are written in order, and each worker holds at most one segment, so
+    memory stays bounded.
+
+    In verify mode a serial processor runs over the whole file alongside, on
+    a thread of its own, and the largest difference to the stitched output is
+    reported. Workers hand each segment over once it is written, so they only
+    wait for the serial pass when they get a whole segment ahead of it.
+*/
+class CrossfeedChunkRenderer
+{
+public:
+    CrossfeedChunkRenderer (const CrossfeedRenderOptions&, int numWorkers,
+                            double segmentSeconds = 30.0, double toleranceDecibels = -120.0);
+
+    juce::Result render (const juce::File& input, const juce::File& output, bool verify, std::ostream& report);
+
+    /** Frames of pre-roll that bring a fresh processor within tolerance of one that saw all of the history. */
+    static int getPreRollSamples (CrossfeedAudioProcessor&, double sampleRate, double tolerance);
+
+private:
+    CrossfeedRenderOptions options;
+    int numWorkers;
+    double segmentSeconds;
+    double tolerance;
+
+    JUCE_DECLARE_NON_COPYABLE (CrossfeedChunkRenderer)
+};
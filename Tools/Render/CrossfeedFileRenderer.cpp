@@ -0,0 +1,213 @@
+/*
+  ==============================================================================
+
+    Streams audio files through CrossfeedAudioProcessor.
+
+  ==============================================================================
+*/
+
+#include "CrossfeedFileRenderer.h"
+
+//==============================================================================
+CrossfeedFileRenderer::CrossfeedFileRenderer (const CrossfeedRenderOptions& o)
+    : options (o)
+{
+    formatManager.registerBasicFormats();
+}
+
+//==============================================================================
+juce::Result CrossfeedFileRenderer::applyOptions (CrossfeedAudioProcessor& p, const CrossfeedRenderOptions& o)
+{
+    if (o.state.getSize() > 0)
+        p.setStateInformation (o.state.getData(), static_cast<int> (o.state.getSize()));
+
+    auto apply = [] (juce::AudioParameterFloat* parameter, const std::optional<float>& value)
+    {
+        if (value.has_value())
+            *parameter = *value;
+    };
+
+    apply (p.amplitudeLow, o.amplitudeLow);
+    apply (p.amplitudeHigh, o.amplitudeHigh);
+    apply (p.delayLow, o.delayLow);
+    apply (p.delayHigh, o.delayHigh);
+    apply (p.crossoverFrequency, o.crossoverFrequency);
+
+    if (o.impulseResponse != juce::File())
+        return p.loadImpulseResponse (o.impulseResponse);
+
+    return juce::Result::ok();
+}
+
+juce::Result CrossfeedFileRenderer::waitForImpulseResponse (CrossfeedAudioProcessor& p)
+{
+    while (p.isLoadingImpulseResponse())
+        juce::Thread::sleep (1);
+
+    const auto error = p.getImpulseResponseError();
+    return error.isEmpty() ? juce::Result::ok() : juce::Result::fail (error);
+}
+
+std::unique_ptr<juce::AudioFormatWriter> CrossfeedFileRenderer::createWriter (juce::AudioFormatManager& formats,
+                                                                              const juce::File& output,
+                                                                              double sampleRate,
+                                                                              int bitsPerSample,
+                                                                              juce::String& error)
+{
+    auto* format = formats.findFormatForFileExtension (output.getFileExtension());
+
+    if (format == nullptr)
+    {
+        error = "No audio format for " + output.getFileName();
+        return {};
+    }
+
+    if (! format->getPossibleBitDepths().contains (bitsPerSample))
+    {
+        error = format->getFormatName() + " cannot be written with " + juce::String (bitsPerSample) + " bits";
+        return {};
+    }
+
+    output.deleteFile();
+    std::unique_ptr<juce::OutputStream> stream (output.createOutputStream());
+
+    if (stream == nullptr)
+    {
+        error = "Cannot open " + output.getFullPathName() + " for writing";
+        return {};
+    }
+
+    std::unique_ptr<juce::AudioFormatWriter> writer (format->createWriterFor (stream.get(), sampleRate, 2,
+                                                                              bitsPerSample, {}, 0));
+
+    if (writer == nullptr)
+    {
+        error = "Cannot write " + format->getFormatName() + " at " + juce::String (sampleRate) + " Hz";
+        return {};
+    }
+
+    stream.release(); // now owned by the writer
+    return writer;
+}
+
+void CrossfeedFileRenderer::setIOThread (juce::TimeSliceThread* thread)
+{
+    ioThread = thread;
+}
+
+//==============================================================================
+juce::Result CrossfeedFileRenderer::render (const juce::File& input, const juce::File& output, CrossfeedRenderStats* stats)
+{
+    const auto startTime = juce::Time::getMillisecondCounterHiRes();
+
+    std::unique_ptr<juce::AudioFormatReader> reader (formatManager.createReaderFor (input));
+
+    if (reader == nullptr)
+        return juce::Result::fail ("Cannot read " + input.getFullPathName());
+
+    if (reader->numChannels < 1 || reader->numChannels > 2)
+        return juce::Result::fail (input.getFileName() + ": only mono and stereo files are supported");
+
+    const auto sampleRate = reader->sampleRate;
+    const auto numChannels = static_cast<int> (reader->numChannels);
+    const auto lengthInSamples = reader->lengthInSamples;
+    const auto bits = options.bitsPerSample > 0 ? options.bitsPerSample : static_cast<int> (reader->bitsPerSample);
+
+    juce::String error;
+    auto writer = createWriter (formatManager, output, sampleRate, bits, error);
+
+    if (writer == nullptr)
+        return juce::Result::fail (error);
+
+    // With an I/O thread, decoding runs ahead and encoding runs behind the
+    // processing, each through a FIFO of ioBufferSize frames.
+    const auto pipelined = ioThread != nullptr && options.ioBufferSize > 0;
+    std::unique_ptr<juce::AudioFormatWriter::ThreadedWriter> threadedWriter;
+
+    if (pipelined)
+    {
+        auto* buffering = new juce::BufferingAudioReader (reader.release(), *ioThread, options.ioBufferSize);
+        buffering->setReadTimeout (-1);
+        reader.reset (buffering);
+
+        threadedWriter = std::make_unique<juce::AudioFormatWriter::ThreadedWriter> (writer.release(), *ioThread,
+                                                                                   options.ioBufferSize);
+    }
+
+    processor.setNonRealtime (true);
+    processor.setPlayConfigDetails (2, 2, sampleRate, options.blockSize);
+
+    const auto applied = applyOptions (processor, options);
+
+    if (applied.failed())
+        return applied;
+
+    processor.prepareToPlay (sampleRate, options.blockSize);
+
+    const auto loaded = waitForImpulseResponse (processor);
+
+    if (loaded.failed())
+        return loaded;
+
+    // Latency is compensated: the first latency frames out are dropped, and as
+    // many frames of silence are pushed through at the end to get the rest out.
+    const auto latency = processor.getLatencySamples();
+    auto toSkip = latency;
+
+    juce::AudioBuffer<float> buffer (2, options.blockSize);
+    juce::MidiBuffer midi;
+    CrossfeedPerformanceStats performance;
+
+    for (juce::int64 position = 0; position < lengthInSamples + latency; position += options.blockSize)
+    {
+        const auto numSamples = static_cast<int> (juce::jmin (static_cast<juce::int64> (options.blockSize),
+                                                              lengthInSamples + latency - position));
+        buffer.setSize (2, numSamples, false, false, true);
+
+        if (! reader->read (&buffer, 0, numSamples, position, true, true))
+            return juce::Result::fail ("Read error in " + input.getFullPathName());
+
+        if (numChannels == 1)
+            buffer.copyFrom (1, 0, buffer, 0, 0, numSamples);
+
+        processor.processBlock (buffer, midi);
+        performance.addAll (processor.getPerformanceMonitor());
+
+        const auto skipped = juce::jmin (toSkip, numSamples);
+        const auto numToWrite = numSamples - skipped;
+        toSkip -= skipped;
+
+        if (numToWrite == 0)
+            continue;
+
+        if (threadedWriter != nullptr)
+        {
+            const float* channels[] = { buffer.getReadPointer (0, skipped), buffer.getReadPointer (1, skipped) };
+
+            // The write-behind FIFO is bounded; wait for the encoder to catch up.
+            while (! threadedWriter->write (channels, numToWrite))
+                juce::Thread::sleep (1);
+        }
+        else if (! writer->writeFromAudioSampleBuffer (buffer, skipped, numToWrite))
+        {
+            return juce::Result::fail ("Write error in " + output.getFullPathName());
+        }
+    }
+
+    // Flushes whatever the encoder still has queued.
+    threadedWriter.reset();
+    writer.reset();
+
+    processor.releaseResources();
+
+    if (stats != nullptr)
+    {
+        stats->audioSeconds = static_cast<double> (lengthInSamples) / sampleRate;
+        stats->wallSeconds = (juce::Time::getMillisecondCounterHiRes() - startTime) / 1000.0;
+        stats->bytesRead = input.getSize();
+        stats->bytesWritten = output.getSize();
+        stats->performance = performance;
+    }
+
+    return juce::Result::ok();
+}
@@ -0,0 +1,101 @@
+/*
+  ==============================================================================
+
+    Streams audio files through CrossfeedAudioProcessor.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "PluginProcessor.h"
+
+//==============================================================================
+/**
+    Settings for an offline render.
+
+    Parameters left unset keep the value from the state blob, or the plugin
+    default when there is no state.
+*/
+struct CrossfeedRenderOptions
+{
+    juce::MemoryBlock state;
+
+    std::optional<float> amplitudeLow;
+    std::optional<float> amplitudeHigh;
+    std::optional<float> delayLow;
+    std::optional<float> delayHigh;
+    std::optional<float> crossoverFrequency;
+
+    /** Measured responses for HRTF mode, see CrossfeedAudioProcessor::loadImpulseResponse(). */
+    juce::File impulseResponse;
+
+    /** Frames read, processed and written per chunk; this bounds memory use. */
+    int blockSize = 65536;
+
+    /** Bit depth of the output file, 0 keeps the bit depth of the input. */
+    int bitsPerSample = 0;
+
+    /** Frames of read-ahead and of write-behind buffered on the I/O thread, see
+        CrossfeedFileRenderer::setIOThread(). 0 does all I/O on the calling thread.
+    */
+    int ioBufferSize = 0;
+};
+
+//==============================================================================
+/** What a render cost, for throughput reports. */
+struct CrossfeedRenderStats
+{
+    double audioSeconds = 0.0;
+    double wallSeconds = 0.0;
+    juce::int64 bytesRead = 0;
+    juce::int64 bytesWritten = 0;
+
+    /** Block timings from the processor's instrumentation. */
+    CrossfeedPerformanceStats performance;
+
+    double getRealtimeFactor() const noexcept       { return wallSeconds > 0.0 ? audioSeconds / wallSeconds : 0.0; }
+    double getMegabytesPerSecond() const noexcept   { return wallSeconds > 0.0 ? static_cast<double> (bytesRead) / (1024.0 * 1024.0) / wallSeconds : 0.0; }
+};
+
+//==============================================================================
+/**
+*/
+class CrossfeedFileRenderer
+{
+public:
+    explicit CrossfeedFileRenderer (const CrossfeedRenderOptions&);
+
+    /** Decoding and encoding are pipelined on this thread when ioBufferSize is set.
+        The thread must be running and outlive any render() calls.
+    */
+    void setIOThread (juce::TimeSliceThread*);
+
+    /** Renders input to output; the output format follows the file extension. */
+    juce::Result render (const juce::File& input, const juce::File& output, CrossfeedRenderStats* stats = nullptr);
+
+    /** Applies the state blob and parameter overrides to a processor. Impulse
+        responses are loaded in the background; prepare the processor and use
+        waitForImpulseResponse() before rendering.
+    */
+    static juce::Result applyOptions (CrossfeedAudioProcessor&, const CrossfeedRenderOptions&);
+
+    /** Blocks until the processor's impulse responses are loaded. */
+    static juce::Result waitForImpulseResponse (CrossfeedAudioProcessor&);
+
+    /** Opens a writer for output, replacing any existing file. */
+    static std::unique_ptr<juce::AudioFormatWriter> createWriter (juce::AudioFormatManager&,
+                                                                  const juce::File& output,
+                                                                  double sampleRate,
+                                                                  int bitsPerSample,
+                                                                  juce::String& error);
+
+private:
+    CrossfeedRenderOptions options;
+    juce::AudioFormatManager formatManager;
+    CrossfeedAudioProcessor processor;
+    juce::TimeSliceThread* ioThread = nullptr;
+
+    JUCE_DECLARE_NON_COPYABLE (CrossfeedFileRenderer)
+};
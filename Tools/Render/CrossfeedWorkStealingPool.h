@@ -0,0 +1,123 @@
+/*
+  ==============================================================================
+
+    A small work-stealing scheduler for the batch renderer.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+//==============================================================================
+/**
+    Runs a fixed list of jobs on a set of worker threads.
+
+    Jobs are dealt round-robin into one deque per worker, in the order given,
+    so callers should put the most expensive jobs first. A worker takes jobs
+    from the front of its own deque; once that is empty it steals from the back
+    of the fullest other deque. Per-file jobs are coarse, so a mutex per deque
+    costs nothing measurable next to the work itself.
+*/
+template <typename Job>
+class CrossfeedWorkStealingPool
+{
+public:
+    explicit CrossfeedWorkStealingPool (int numWorkersToUse)
+        : queues (static_cast<size_t> (juce::jmax (1, numWorkersToUse)))
+    {
+    }
+
+    int getNumWorkers() const noexcept     { return static_cast<int> (queues.size()); }
+
+    /** Calls work (workerIndex, job) once for every job and returns when all are done. */
+    template <typename Function>
+    void run (std::vector<Job>& jobs, Function&& work)
+    {
+        for (size_t i = 0; i < jobs.size(); i++)
+            queues[i % queues.size()].jobs.push_back (&jobs[i]);
+
+        std::vector<std::thread> threads;
+
+        for (int worker = 0; worker < getNumWorkers(); worker++)
+        {
+            threads.emplace_back ([this, worker, &work]
+            {
+                while (auto* job = next (worker))
+                    work (worker, *job);
+            });
+        }
+
+        for (auto& thread : threads)
+            thread.join();
+    }
+
+private:
+    //==============================================================================
+    struct Queue
+    {
+        std::mutex lock;
+        std::deque<Job*> jobs;
+    };
+
+    Job* next (int worker)
+    {
+        {
+            auto& own = queues[static_cast<size_t> (worker)];
+            const std::lock_guard<std::mutex> guard (own.lock);
+
+            if (! own.jobs.empty())
+            {
+                auto* job = own.jobs.front();
+                own.jobs.pop_front();
+                return job;
+            }
+        }
+
+        return steal (worker);
+    }
+
+    Job* steal (int thief)
+    {
+        for (;;)
+        {
+            // Pick the fullest victim; it may have drained by the time we get back to it.
+            Queue* victim = nullptr;
+            size_t victimSize = 0;
+
+            for (size_t i = 0; i < queues.size(); i++)
+            {
+                if (static_cast<int> (i) == thief)
+                    continue;
+
+                const std::lock_guard<std::mutex> guard (queues[i].lock);
+
+                if (queues[i].jobs.size() > victimSize)
+                {
+                    victim = &queues[i];
+                    victimSize = queues[i].jobs.size();
+                }
+            }
+
+            if (victim == nullptr)
+                return nullptr;
+
+            const std::lock_guard<std::mutex> guard (victim->lock);
+
+            if (! victim->jobs.empty())
+            {
+                auto* job = victim->jobs.back();
+                victim->jobs.pop_back();
+                return job;
+            }
+        }
+    }
+
+    std::vector<Queue> queues;
+
+    JUCE_DECLARE_NON_COPYABLE (CrossfeedWorkStealingPool)
+};
@@ -0,0 +1,210 @@
+/*
+  ==============================================================================
+
+    crossfeed-render: applies the crossfeed to audio files without a host.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include <iostream>
+#include "CrossfeedBatchRenderer.h"
+#include "CrossfeedChunkRenderer.h"
+
+//==============================================================================
+static const char* const usage =
+    "Usage: crossfeed-render [options] <input> <output>\n"
+    "       crossfeed-render [options] --batch=<dir|manifest> --output-dir=<dir>\n"
+    "\n"
+    "Reads WAV, FLAC or AIFF; the output format follows the output file extension.\n"
+    "A batch manifest lists one input per line, optionally followed by a tab and\n"
+    "the output path.\n"
+    "\n"
+    "  --amplitude-low=<0..1>      crossfeed amount below the crossover\n"
+    "  --amplitude-high=<0..1>     crossfeed amount above the crossover\n"
+    "  --delay-low=<us>            cross delay below the crossover\n"
+    "  --delay-high=<us>           cross delay above the crossover\n"
+    "  --crossover=<Hz>            crossover frequency\n"
+    "  --hrir=<file>               HRTF mode with measured responses (2 or 4 channels)\n"
+    "  --state=<file>              load parameters from a saved plugin state\n"
+    "  --save-state=<file>         write the resulting parameters as a plugin state\n"
+    "  --block-size=<frames>       frames per streaming chunk (default 65536)\n"
+    "  --bits=<n>                  output bit depth (default: same as input)\n"
+    "  --jobs=<n>                  batch workers (default: number of cores)\n"
+    "  --format=<ext>              batch output extension (default: same as input)\n"
+    "  --parallel[=<n>]            split a single file across n workers (default: number of cores)\n"
+    "  --segment-seconds=<s>       segment length for --parallel (default 30)\n"
+    "  --verify                    with --parallel, compare against serial processing\n"
+    "  --tolerance=<dB>            pre-roll accuracy and --verify limit (default -120)\n"
+    "  --stats                     print processBlock timing statistics after rendering\n";
+
+static std::optional<float> getFloatOption (const juce::ArgumentList& args, juce::StringRef option)
+{
+    if (! args.containsOption (option))
+        return {};
+
+    const auto text = args.getValueForOption (option);
+
+    if (! text.containsOnly ("0123456789.-+eE") || text.isEmpty())
+        juce::ConsoleApplication::fail ("Invalid value for " + juce::String (option) + ": " + text);
+
+    return text.getFloatValue();
+}
+
+static juce::File getFileOption (const juce::ArgumentList& args, juce::StringRef option)
+{
+    return juce::File::getCurrentWorkingDirectory().getChildFile (args.getValueForOption (option).unquoted());
+}
+
+static CrossfeedRenderOptions parseOptions (const juce::ArgumentList& args)
+{
+    CrossfeedRenderOptions options;
+
+    if (args.containsOption ("--state"))
+    {
+        const auto file = getFileOption (args, "--state");
+
+        if (! file.loadFileAsData (options.state))
+            juce::ConsoleApplication::fail ("Cannot read state from " + file.getFullPathName());
+    }
+
+    options.amplitudeLow       = getFloatOption (args, "--amplitude-low");
+    options.amplitudeHigh      = getFloatOption (args, "--amplitude-high");
+    options.delayLow           = getFloatOption (args, "--delay-low");
+    options.delayHigh          = getFloatOption (args, "--delay-high");
+    options.crossoverFrequency = getFloatOption (args, "--crossover");
+
+    if (args.containsOption ("--hrir"))
+        options.impulseResponse = getFileOption (args, "--hrir");
+
+    if (args.containsOption ("--block-size"))
+        options.blockSize = args.getValueForOption ("--block-size").getIntValue();
+
+    if (args.containsOption ("--bits"))
+        options.bitsPerSample = args.getValueForOption ("--bits").getIntValue();
+
+    if (options.blockSize <= 0)
+        juce::ConsoleApplication::fail ("--block-size must be positive");
+
+    return options;
+}
+
+static juce::StringArray getPositionalArguments (const juce::ArgumentList& args)
+{
+    juce::StringArray positional;
+
+    // Option values are always given as --name=value, so anything else is positional.
+    for (int i = 0; i < args.size(); i++)
+        if (! args[i].isOption())
+            positional.add (args[i].text);
+
+    return positional;
+}
+
+static void saveState (const CrossfeedRenderOptions& options, const juce::File& file)
+{
+    CrossfeedAudioProcessor processor;
+    const auto applied = CrossfeedFileRenderer::applyOptions (processor, options);
+
+    if (applied.failed())
+        juce::ConsoleApplication::fail (applied.getErrorMessage());
+
+    juce::MemoryBlock state;
+    processor.getStateInformation (state);
+
+    if (! file.replaceWithData (state.getData(), state.getSize()))
+        juce::ConsoleApplication::fail ("Cannot write state to " + file.getFullPathName());
+}
+
+static int runBatch (const juce::ArgumentList& args, const CrossfeedRenderOptions& options)
+{
+    if (! args.containsOption ("--output-dir"))
+        juce::ConsoleApplication::fail ("--batch needs --output-dir");
+
+    const auto jobsOption = args.getValueForOption ("--jobs").getIntValue();
+    const auto numWorkers = jobsOption > 0 ? jobsOption : juce::SystemStats::getNumCpus();
+
+    std::vector<CrossfeedBatchJob> jobs;
+    const auto collected = CrossfeedBatchRenderer::collectJobs (getFileOption (args, "--batch"),
+                                                                getFileOption (args, "--output-dir"),
+                                                                args.getValueForOption ("--format").trimCharactersAtStart ("."),
+                                                                jobs);
+
+    if (collected.failed())
+        juce::ConsoleApplication::fail (collected.getErrorMessage());
+
+    CrossfeedBatchRenderer batch (options, numWorkers);
+    const auto result = batch.run (jobs, std::cout);
+
+    if (result.failed())
+        juce::ConsoleApplication::fail (result.getErrorMessage());
+
+    return 0;
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    juce::ArgumentList args (argc, argv);
+
+    return juce::ConsoleApplication::invokeCatchingFailures ([&args]
+    {
+        if (args.containsOption ("--help|-h"))
+        {
+            std::cout << usage;
+            return 0;
+        }
+
+        const auto options = parseOptions (args);
+
+        if (args.containsOption ("--save-state"))
+            saveState (options, getFileOption (args, "--save-state"));
+
+        if (args.containsOption ("--batch"))
+            return runBatch (args, options);
+
+        const auto files = getPositionalArguments (args);
+
+        if (files.isEmpty() && args.containsOption ("--save-state"))
+            return 0;
+
+        if (files.size() != 2)
+            juce::ConsoleApplication::fail (usage);
+
+        const auto cwd = juce::File::getCurrentWorkingDirectory();
+        const auto input = cwd.getChildFile (files[0]);
+        const auto output = cwd.getChildFile (files[1]);
+
+        if (args.containsOption ("--parallel"))
+        {
+            const auto workers = args.getValueForOption ("--parallel").getIntValue();
+            const auto seconds = getFloatOption (args, "--segment-seconds").value_or (30.f);
+            const auto tolerance = getFloatOption (args, "--tolerance").value_or (-120.f);
+
+            if (seconds <= 0.f)
+                juce::ConsoleApplication::fail ("--segment-seconds must be positive");
+
+            CrossfeedChunkRenderer renderer (options, workers > 0 ? workers : juce::SystemStats::getNumCpus(),
+                                             seconds, tolerance);
+            const auto result = renderer.render (input, output, args.containsOption ("--verify"), std::cout);
+
+            if (result.failed())
+                juce::ConsoleApplication::fail (result.getErrorMessage());
+
+            return 0;
+        }
+
+        CrossfeedFileRenderer renderer (options);
+        CrossfeedRenderStats stats;
+        const auto result = renderer.render (input, output, &stats);
+
+        if (result.failed())
+            juce::ConsoleApplication::fail (result.getErrorMessage());
+
+        if (args.containsOption ("--stats"))
+            std::cout << stats.performance.toString();
+
+        return 0;
+    });
+}